@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <charconv>
+#include <cfloat>
+#include <cmath>
 #include <cstring>
 #include <memory>
 #include <sstream>
@@ -20,6 +24,17 @@ class MqttValue {
 
         static constexpr int NO_PRECISION = -1;
 
+        /**
+         * Buffer size that fits any int value and most of doubles
+         * */
+        static constexpr size_t FORMAT_BUFFER_SIZE = 64;
+
+        /**
+         * Binary values up to this size are stored inside MqttValue
+         * without heap allocation
+         * */
+        static constexpr size_t INLINE_BINARY_SIZE = 16;
+
         static MqttValue fromInt(int32_t val) {
             return MqttValue(val);
         }
@@ -61,18 +76,11 @@ class MqttValue {
         }
 
         MqttValue(const void* ptr, size_t size){
-            mBinaryValue = std::shared_ptr<void>(malloc(size), free);
-            memcpy(mBinaryValue.get(), ptr, size);
-            mType = SourceType::BINARY;
-            mBinarySize = size;
+            setBinary(ptr, size);
         }
 
         void setString(const char* val) {
-            size_t len = strlen(val);
-            mBinaryValue = std::shared_ptr<void>(malloc(len), free);
-            memcpy(mBinaryValue.get(), val, len);
-            mBinarySize = len;
-            mType = SourceType::BINARY;
+            setBinary(val, strlen(val));
         }
 
         void setDouble(double val, int precision) {
@@ -92,23 +100,61 @@ class MqttValue {
         }
 
         void setBinary(const void* ptr, size_t size) {
-            mBinaryValue = std::shared_ptr<void>(malloc(size), free);
-            memcpy(mBinaryValue.get(), ptr, size);
+            // ptr may point to our own storage
+            if (size <= INLINE_BINARY_SIZE) {
+                memmove(mValue.v_inline, ptr, size);
+                mBinaryValue.reset();
+            } else {
+                std::shared_ptr<void> data(malloc(size), free);
+                memcpy(data.get(), ptr, size);
+                mBinaryValue = data;
+            }
             mType = SourceType::BINARY;
+            mBinarySize = size;
         }
 
         std::string getString() const {
             switch(mType) {
                 case SourceType::BINARY:
-                    return std::string(static_cast<const char*>(mBinaryValue.get()), mBinarySize);
+                    return std::string(static_cast<const char*>(getBinaryPtr()), mBinarySize);
+                default: {
+                    char buf[FORMAT_BUFFER_SIZE];
+                    char* end = toChars(buf, buf + sizeof(buf));
+                    if (end != nullptr)
+                        return std::string(buf, end);
+                    // fixed notation of a huge double: sign, digits, dot and fraction
+                    std::string ret(DBL_MAX_10_EXP + std::max(mDoublePrecision, 6) + 4, '\0');
+                    ret.resize(toChars(&ret[0], &ret[0] + ret.size()) - &ret[0]);
+                    return ret;
+                }
+            }
+            return std::string();
+        }
+
+        /**
+         * Writes text representation of a numeric value to [first, last)
+         * without allocations. Doubles are written in fixed notation
+         * with mDoublePrecision digits, or six digits if value has a fractional part.
+         *
+         * Returns pointer past the last written char or nullptr if
+         * buffer is too small or value is binary.
+         * */
+        char* toChars(char* first, char* last) const {
+            std::to_chars_result res;
+            switch(mType) {
                 case SourceType::INT:
-                    return std::to_string(mValue.v_int);
+                    res = std::to_chars(first, last, mValue.v_int);
+                    break;
                 case SourceType::INT64:
-                    return std::to_string(mValue.v_int64);
+                    res = std::to_chars(first, last, mValue.v_int64);
+                    break;
                 case SourceType::DOUBLE:
-                    return format(mValue.v_double);
+                    res = formatDouble(first, last, mValue.v_double);
+                    break;
+                default:
+                    return nullptr;
             }
-            return std::string();
+            return res.ec == std::errc() ? res.ptr : nullptr;
         }
 
         double getDouble() const {
@@ -184,7 +230,9 @@ class MqttValue {
         void* getBinaryPtr() const {
             switch(mType) {
                 case SourceType::BINARY:
-                    return mBinaryValue.get();
+                    if (mBinarySize > INLINE_BINARY_SIZE)
+                        return mBinaryValue.get();
+                    return (void*)mValue.v_inline;
                 default:
                     return (void*)&mValue;
             }
@@ -216,30 +264,26 @@ class MqttValue {
             int64_t v_int64;
             int32_t v_int;
             double v_double;
+            char v_inline[INLINE_BINARY_SIZE];
         } Variant;
 
         Variant mValue;
+        // only for binary values longer than INLINE_BINARY_SIZE
         std::shared_ptr<void> mBinaryValue;
-        size_t mBinarySize;
+        size_t mBinarySize = 0;
         int mDoublePrecision = -1;
         SourceType mType;
 
-        // https://stackoverflow.com/questions/33125779/format-double-value-in-c
-        std::string format(double value) const {
+        // the same output as std::fixed stream with default precision of 6
+        std::to_chars_result formatDouble(char* first, char* last, double value) const {
 
             double intpart;
             modf(value, &intpart);
 
             if (intpart == value && mDoublePrecision == NO_PRECISION)
-                return std::to_string(int64_t(intpart));
-
-            std::stringstream sstream;
-            sstream.setf(std::ios::fixed);
-
-            if (mDoublePrecision != -1)
-                sstream.precision(mDoublePrecision);
+                return std::to_chars(first, last, int64_t(intpart));
 
-            sstream << value;
-            return sstream.str();
+            int precision = mDoublePrecision == NO_PRECISION ? 6 : mDoublePrecision;
+            return std::to_chars(first, last, value, std::chars_format::fixed, precision);
         }
 };
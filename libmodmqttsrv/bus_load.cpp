@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+#include "bus_load.hpp"
+
+namespace modmqttd {
+
+// slave address, function code, start address, count, crc
+static constexpr int READ_REQUEST_SIZE = 8;
+// slave address, function code, byte count, crc
+static constexpr int READ_RESPONSE_HEADER_SIZE = 5;
+// 3.5 character silence before request and response frame
+static constexpr double FRAME_SILENCE_CHARS = 3.5 * 2;
+
+BusLoadEstimator::BusLoadEstimator(const ModbusNetworkConfig& config)
+    : mOverloadAction(config.mBusOverloadAction)
+{
+    if (config.mType == ModbusNetworkConfig::Type::RTU && config.mBaud > 0) {
+        mBaud = config.mBaud;
+        // start bit, data bits, parity bit and stop bits
+        int bits = 1 + config.mDataBit + (config.mParity == 'N' ? 0 : 1) + config.mStopBit;
+        mCharTime = std::chrono::duration<double>(double(bits) / config.mBaud);
+    }
+
+    if (config.hasDelayBeforeCommand())
+        mNetworkDelays.mDelayBeforeCommand = *config.getDelayBeforeCommand();
+    if (config.hasDelayBeforeFirstCommand())
+        mNetworkDelays.mDelayBeforeFirstCommand = *config.getDelayBeforeFirstCommand();
+}
+
+
+void
+BusLoadEstimator::setSlaveConfig(const ModbusSlaveConfig& config) {
+    Delays delays(mNetworkDelays);
+    if (config.hasDelayBeforeCommand())
+        delays.mDelayBeforeCommand = *config.getDelayBeforeCommand();
+    if (config.hasDelayBeforeFirstCommand())
+        delays.mDelayBeforeFirstCommand = *config.getDelayBeforeFirstCommand();
+    mSlaveDelays[config.mAddress] = delays;
+}
+
+
+const BusLoadEstimator::Delays&
+BusLoadEstimator::getDelays(int slaveId) const {
+    auto it = mSlaveDelays.find(slaveId);
+    if (it == mSlaveDelays.end())
+        return mNetworkDelays;
+    return it->second;
+}
+
+
+std::chrono::duration<double>
+BusLoadEstimator::getReadTime(const MsgRegisterPoll& poll) const {
+    int responseSize = READ_RESPONSE_HEADER_SIZE;
+    if (poll.mRegisterType == RegisterType::COIL || poll.mRegisterType == RegisterType::BIT)
+        responseSize += (poll.mCount + 7) / 8;
+    else
+        responseSize += poll.mCount * 2;
+
+    std::chrono::duration<double> ret(mCharTime * (READ_REQUEST_SIZE + responseSize + FRAME_SILENCE_CHARS));
+
+    // assume the worst case: every poll is a first command after slave switch
+    const Delays& delays(getDelays(poll.mSlaveId));
+    ret += std::max(delays.mDelayBeforeCommand, delays.mDelayBeforeFirstCommand);
+
+    return ret;
+}
+
+
+double
+BusLoadEstimator::getUtilisation(const MsgRegisterPoll& poll) const {
+    // polled only on change of other register
+    if (poll.mRefreshMsec <= std::chrono::milliseconds::zero())
+        return 0;
+    return getReadTime(poll) / poll.mRefreshMsec;
+}
+
+
+double
+BusLoadEstimator::getUtilisation(const MsgRegisterPollSpecification& spec) const {
+    double ret = 0;
+    for(const MsgRegisterPoll& poll: spec.mRegisters)
+        ret += getUtilisation(poll);
+    return ret;
+}
+
+
+std::string
+BusLoadEstimator::getReport(const MsgRegisterPollSpecification& spec, int maxEntries) const {
+    std::vector<const MsgRegisterPoll*> polls;
+    for(const MsgRegisterPoll& poll: spec.mRegisters)
+        polls.push_back(&poll);
+
+    std::sort(polls.begin(), polls.end(),
+        [this](const MsgRegisterPoll* a, const MsgRegisterPoll* b) -> bool { return getUtilisation(*a) > getUtilisation(*b); }
+    );
+
+    std::stringstream ret;
+    ret << std::fixed << std::setprecision(0)
+        << "estimated bus load " << getUtilisation(spec) * 100 << "% at " << mBaud << " baud";
+    for(int i = 0; i < maxEntries && i < int(polls.size()); i++) {
+        const MsgRegisterPoll& poll(*polls[i]);
+        ret << (i == 0 ? ", most demanding polls: " : ", ")
+            << poll.mSlaveId << "." << poll.mRegister
+            << " (count=" << poll.mCount
+            << ", refresh=" << poll.mRefreshMsec.count() << "ms"
+            << ", load=" << getUtilisation(poll) * 100 << "%)";
+    }
+    return ret.str();
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <chrono>
+
+#include "config.hpp"
+#include "modbus_slave.hpp"
+#include "modbus_messages.hpp"
+
+namespace modmqttd {
+
+/**
+ * Estimates RTU line occupancy needed to poll registers
+ * with configured refresh rates.
+ *
+ * Read transaction time is computed from frame sizes,
+ * character time for configured baud rate, parity and stop bits,
+ * 3.5 character inter-frame silence and configured delays.
+ * Device response time is unknown and not included.
+ */
+class BusLoadEstimator {
+    public:
+        BusLoadEstimator(const ModbusNetworkConfig& config);
+
+        void setSlaveConfig(const ModbusSlaveConfig& config);
+
+        // false for TCP networks
+        bool canEstimate() const { return mCharTime != std::chrono::duration<double>::zero(); }
+        ModbusNetworkConfig::BusOverloadAction getOverloadAction() const { return mOverloadAction; }
+
+        std::chrono::duration<double> getReadTime(const MsgRegisterPoll& poll) const;
+
+        /**
+         * Fraction of bus time needed to poll all registers
+         * from spec. 1.0 means that line is saturated.
+         */
+        double getUtilisation(const MsgRegisterPollSpecification& spec) const;
+
+        /**
+         * Human readable list of polls that use most of bus time
+         */
+        std::string getReport(const MsgRegisterPollSpecification& spec, int maxEntries = 3) const;
+    private:
+        struct Delays {
+            std::chrono::milliseconds mDelayBeforeCommand = std::chrono::milliseconds::zero();
+            std::chrono::milliseconds mDelayBeforeFirstCommand = std::chrono::milliseconds::zero();
+        };
+
+        std::chrono::duration<double> mCharTime = std::chrono::duration<double>::zero();
+        int mBaud = 0;
+        ModbusNetworkConfig::BusOverloadAction mOverloadAction;
+        Delays mNetworkDelays;
+        std::map<int, Delays> mSlaveDelays;
+
+        const Delays& getDelays(int slaveId) const;
+        double getUtilisation(const MsgRegisterPoll& poll) const;
+};
+
+}
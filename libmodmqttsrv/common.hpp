@@ -25,4 +25,10 @@ typedef enum {
     EVERY_POLL=2
 } PublishMode;
 
+typedef enum {
+    JSON=1,
+    CBOR=2,
+    MSGPACK=3
+} PayloadFormat;
+
 }
@@ -58,6 +58,23 @@ ModbusNetworkConfig::ModbusNetworkConfig(const YAML::Node& source) {
     ConfigTools::readOptionalValue<unsigned short>(mMaxWriteRetryCount, source, "write_retries");
     ConfigTools::readOptionalValue<unsigned short>(mMaxReadRetryCount, source, "read_retries");
 
+    YAML::Node rbNode(ConfigTools::setOptionalValueFromNode<std::chrono::milliseconds>(mRetryBackoff, source, "retry_backoff"));
+    if (rbNode.IsDefined()) {
+        if (mRetryBackoff < std::chrono::milliseconds::zero())
+            throw ConfigurationException(rbNode.Mark(), "retry_backoff must be a positive value");
+        mRequeueRetries = true;
+    }
+
+    YAML::Node satNode(ConfigTools::setOptionalValueFromNode<std::chrono::milliseconds>(mSlaveAffinityTolerance, source, "slave_affinity_tolerance"));
+    if (satNode.IsDefined() && mSlaveAffinityTolerance < std::chrono::milliseconds::zero())
+        throw ConfigurationException(satNode.Mark(), "slave_affinity_tolerance must be a positive value");
+
+    ConfigTools::readOptionalValue<bool>(mSpreadPolls, source, "spread_polls");
+
+    YAML::Node rrpNode(ConfigTools::setOptionalValueFromNode<std::chrono::milliseconds>(mReconnectResumePeriod, source, "reconnect_resume_period"));
+    if (rrpNode.IsDefined() && mReconnectResumePeriod < std::chrono::milliseconds::zero())
+        throw ConfigurationException(rrpNode.Mark(), "reconnect_resume_period must be a positive value");
+
 
     if (source["device"]) {
         mType = Type::RTU;
@@ -69,6 +86,7 @@ ModbusNetworkConfig::ModbusNetworkConfig(const YAML::Node& source) {
         ConfigTools::readOptionalValue<RtuSerialMode>(mRtuSerialMode, source, "rtu_serial_mode");
         ConfigTools::readOptionalValue<RtuRtsMode>(mRtsMode, source, "rtu_rts_mode");
         ConfigTools::readOptionalValue<int>(mRtsDelayUs, source, "rtu_rts_delay_us");
+        ConfigTools::readOptionalValue<BusOverloadAction>(mBusOverloadAction, source, "bus_overload");
 
         mWatchdogConfig.mDevicePath = mDevice;
     } else if (source["address"]) {
@@ -101,6 +119,49 @@ MqttBrokerConfig::MqttBrokerConfig(const YAML::Node& source) {
     ConfigTools::readOptionalValue<int>(mKeepalive, source, "keepalive");
     ConfigTools::readOptionalValue<std::string>(mUsername, source, "username");
     ConfigTools::readOptionalValue<std::string>(mPassword, source, "password");
+    if (ConfigTools::readOptionalValue<int>(mMaxInflight, source, "max_inflight")) {
+        if (mMaxInflight <= 0)
+            throw ConfigurationException(source["max_inflight"].Mark(), "max_inflight must be greater than zero");
+    }
+
+    std::string protocol;
+    if (ConfigTools::readOptionalValue<std::string>(protocol, source, "protocol_version")) {
+        if (protocol == "3.1.1")
+            mProtocol = Protocol::MQTT_311;
+        else if (protocol == "5")
+            mProtocol = Protocol::MQTT_5;
+        else
+            throw ConfigurationException(source["protocol_version"].Mark(), "Invalid protocol_version '" + protocol + "', valid values are: 3.1.1, 5");
+    }
+    if (ConfigTools::readOptionalValue<int>(mTopicAliasMaximum, source, "topic_alias_maximum")) {
+        if (mTopicAliasMaximum < 0 || mTopicAliasMaximum > 65535)
+            throw ConfigurationException(source["topic_alias_maximum"].Mark(), "topic_alias_maximum must be in range 0-65535");
+    }
+    if (ConfigTools::readOptionalValue<std::chrono::milliseconds>(mTopicAliasRefresh, source, "topic_alias_refresh")) {
+        if (mTopicAliasRefresh <= std::chrono::milliseconds::zero())
+            throw ConfigurationException(source["topic_alias_refresh"].Mark(), "topic_alias_refresh must be greater than zero");
+    }
+    if (ConfigTools::readOptionalValue<int>(mConnections, source, "connections")) {
+        if (mConnections <= 0)
+            throw ConfigurationException(source["connections"].Mark(), "connections must be greater than zero");
+    }
+}
+
+
+MqttBufferConfig::MqttBufferConfig(const YAML::Node& source) {
+    mPath = ConfigTools::readRequiredString(source, "path");
+
+    int maxSize = mMaxSize;
+    if (ConfigTools::readOptionalValue<int>(maxSize, source, "max_size")) {
+        if (maxSize <= 0)
+            throw ConfigurationException(source["max_size"].Mark(), "max_size must be greater than zero");
+        mMaxSize = maxSize;
+    }
+
+    if (ConfigTools::readOptionalValue<int>(mReplayRate, source, "replay_rate")) {
+        if (mReplayRate <= 0)
+            throw ConfigurationException(source["replay_rate"].Mark(), "replay_rate must be greater than zero");
+    }
 }
 
 
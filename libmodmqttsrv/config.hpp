@@ -105,6 +105,13 @@ class ModbusNetworkConfig {
             RS485
         } RtuSerialMode;
 
+        // what to do if estimated RTU bus load exceeds line capacity
+        typedef enum {
+            WARN,
+            FAIL,
+            STRETCH
+        } BusOverloadAction;
+
         ModbusNetworkConfig() {}
         ModbusNetworkConfig(const YAML::Node& source);
 
@@ -124,6 +131,14 @@ class ModbusNetworkConfig {
 
         unsigned short mMaxWriteRetryCount = 2;
         unsigned short mMaxReadRetryCount = 1;
+        // failed commands are retried from slave queue after backoff
+        bool mRequeueRetries = false;
+        std::chrono::milliseconds mRetryBackoff = std::chrono::milliseconds::zero();
+        std::chrono::milliseconds mSlaveAffinityTolerance = std::chrono::milliseconds::zero();
+        bool mSpreadPolls = false;
+        // reconnects shorter than this do not trigger initial poll
+        std::chrono::milliseconds mReconnectResumePeriod = std::chrono::milliseconds::zero();
+        BusOverloadAction mBusOverloadAction = BusOverloadAction::WARN;
 
 
         //RTU only
@@ -148,6 +163,11 @@ class ModbusNetworkConfig {
 
 class MqttBrokerConfig {
     public:
+        enum class Protocol {
+            MQTT_311,
+            MQTT_5
+        };
+
         MqttBrokerConfig() {};
         MqttBrokerConfig(const YAML::Node& source);
         bool isSameAs(const MqttBrokerConfig& other) {
@@ -157,7 +177,12 @@ class MqttBrokerConfig {
                     mUsername == other.mUsername &&
                     mPassword == other.mPassword &&
                     mTLS == other.mTLS &&
-                    mCafile == other.mCafile;
+                    mCafile == other.mCafile &&
+                    mMaxInflight == other.mMaxInflight &&
+                    mProtocol == other.mProtocol &&
+                    mTopicAliasMaximum == other.mTopicAliasMaximum &&
+                    mTopicAliasRefresh == other.mTopicAliasRefresh &&
+                    mConnections == other.mConnections;
         }
 
         //defaults are from mosquittopp.h
@@ -171,6 +196,28 @@ class MqttBrokerConfig {
 
         bool mTLS = false;
         std::string mCafile;
+
+        // QoS > 0 messages sent but not acknowledged by broker
+        int mMaxInflight = 20;
+
+        Protocol mProtocol = Protocol::MQTT_311;
+        // MQTT v5 only, limited by value received from broker
+        int mTopicAliasMaximum = 10;
+        std::chrono::milliseconds mTopicAliasRefresh = std::chrono::seconds(60);
+
+        // number of broker connections, topics are published
+        // on additional connections by topic hash
+        int mConnections = 1;
+};
+
+class MqttBufferConfig {
+    public:
+        MqttBufferConfig(const YAML::Node& source);
+
+        std::string mPath;
+        size_t mMaxSize = 1024 * 1024;
+        // messages per second published after broker reconnect
+        int mReplayRate = 100;
 };
 
 }
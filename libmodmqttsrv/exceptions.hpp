@@ -42,6 +42,11 @@ class ConvNameParserException : public ModMqttException {
         ConvNameParserException(const std::string& what) : ModMqttException(what) {}
 };
 
+class PublishBufferException : public ModMqttException {
+    public:
+        PublishBufferException(const std::string& what) : ModMqttException(what) {}
+};
+
 class ConvPluginNotFoundException : public ModMqttException {
     public:
         ConvPluginNotFoundException(const std::string& what) : ModMqttException(what) {}
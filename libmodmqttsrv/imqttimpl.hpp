@@ -11,14 +11,26 @@ class MqttClient;
 */
 class IMqttImpl {
     public:
-        virtual void init(MqttClient* owner, const char* clientId) = 0;
+        /**
+         * connection is passed back to MqttClient callbacks,
+         * 0 is the primary connection used for subscriptions
+        */
+        virtual void init(MqttClient* owner, const char* clientId, int connection) = 0;
         virtual void connect(const MqttBrokerConfig& config) = 0;
         virtual void reconnect() = 0;
         virtual void disconnect() = 0;
         virtual void stop() = 0;
 
-        virtual void subscribe(const char* topic) = 0;
-        virtual void publish(const char* topic, int len, const void* data, bool retain) = 0;
+        virtual void subscribe(const char* topic, int qos) = 0;
+        /**
+         * Returns message id passed to MqttClient::onPublish() when QoS > 0 message is acknowledged.
+         * topicAlias > 0 is an MQTT v5 topic alias, topic can be empty if alias is already known by broker
+        */
+        virtual int publish(const char* topic, int len, const void* data, bool retain, int qos, int topicAlias) = 0;
+        // number of topic aliases accepted by broker on the last connect
+        virtual int getTopicAliasMaximum() const = 0;
+        // session present flag of the last CONNACK
+        virtual bool isSessionPresent() const = 0;
 
         virtual void on_disconnect(int rc) = 0;
         virtual void on_connect(int rc)= 0;
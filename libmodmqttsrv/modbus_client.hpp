@@ -32,6 +32,7 @@ class ModbusClient {
                 reg_values,
                 cmd.getCommandId()
             );
+            val.mPriority = cmd.getPriority();
             // TODO add max queue size
             // here or at mqtt level - add configurable global limit for all queues
             // to i.e. 15Mb and cut the largest one after reaching this limit
@@ -44,6 +45,10 @@ class ModbusClient {
             mToModbusQueue.enqueue(QueueItem::create(MsgMqttNetworkState(up)));
         }
 
+        void sendRegisterPollSuspend(const ModbusSlaveAddressRange& range, bool suspend) {
+            mToModbusQueue.enqueue(QueueItem::create(MsgRegisterPollSuspend(range.mSlaveId, range.mRegisterType, range.mRegister, range.mCount, suspend)));
+        }
+
         std::string mNetworkName;
 
         void stop();
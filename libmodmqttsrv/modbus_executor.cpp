@@ -25,8 +25,6 @@ ModbusExecutor::ModbusExecutor(
     mLastCommandTime = std::chrono::steady_clock::now() - std::chrono::hours(100000);
     mCurrentSlaveQueue = mSlaveQueues.end();
     mInitialPoll = false;
-    mReadRetryCount = mMaxReadRetryCount;
-    mWriteRetryCount = mMaxWriteRetryCount;
 }
 
 void
@@ -44,7 +42,8 @@ ModbusExecutor::setupInitialPoll(const std::map<int, std::vector<std::shared_ptr
 void
 ModbusExecutor::addPollList(const std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>& pRegisters, bool initialPoll) {
 
-    bool setupQueues = allDone();
+    // commands waiting for retry backoff are not in queues
+    bool setupQueues = mWaitingCommand == nullptr && queuesEmpty();
 
     if (mInitialPoll) {
         if (!pollDone()) {
@@ -105,6 +104,9 @@ ModbusExecutor::addPollList(const std::map<int, std::vector<std::shared_ptr<Regi
         }
     }
 
+    // elected slave starts its turn
+    mCurrentSlaveQueue->second.addQuantum();
+
     //if there are no registers with delay set start from the first queue
     if (mWaitingCommand == nullptr) {
         mWaitingCommand = mCurrentSlaveQueue->second.popNext();
@@ -116,14 +118,15 @@ ModbusExecutor::addPollList(const std::map<int, std::vector<std::shared_ptr<Regi
 
 void
 ModbusExecutor::addWriteCommand(const std::shared_ptr<RegisterWrite>& pCommand) {
-    if (mWriteCommandsQueued == 0) {
+    // aged low priority poll is not preempted by a write with lower priority
+    if (mWriteCommandsQueued == 0 && (mWaitingCommand == nullptr || mWaitingCommand->getEffectivePriority(std::chrono::steady_clock::now()) <= pCommand->mPriority)) {
         // skip queuing for if there is no queued write commands.
         // This improves write latency in use case, where there is a lot of polling
         // and sporadic write. I belive this is main use case for this gateway.
 
         // TODO this could lead to poll queue starvation when write commands
-        // arive in sync with slave execution time. Maybe there should be a
-        // configuration switch to turn it off?
+        // arive in sync with slave execution time. Set lower priority
+        // for such commands, they will not preempt waiting polls
         if (mWaitingCommand != nullptr)
             mSlaveQueues[pCommand->mSlaveId].readdCommand(mWaitingCommand);
 
@@ -135,7 +138,7 @@ ModbusExecutor::addWriteCommand(const std::shared_ptr<RegisterWrite>& pCommand)
         queue.addWriteCommand(pCommand);
         if (mCurrentSlaveQueue == mSlaveQueues.end()) {
             mCurrentSlaveQueue = mSlaveQueues.find(pCommand->mSlaveId);
-            resetCommandsCounter();
+            startSlaveTurn();
         }
     }
     mWriteCommandsQueued++;
@@ -144,32 +147,35 @@ ModbusExecutor::addWriteCommand(const std::shared_ptr<RegisterWrite>& pCommand)
 
 void
 ModbusExecutor::pollRegisters(RegisterPoll& reg, bool forceSend) {
-    try {
-        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // initial poll reads all registers regardless of their deadlines
+    if (!mInitialPoll)
+        reg.updateDeadlineStats(start);
+
+    std::vector<std::shared_ptr<RegisterPoll>> coalesced(mSlaveQueues[reg.mSlaveId].popCoalescable(reg, start));
+    if (!coalesced.empty() && pollCoalesced(reg, coalesced, forceSend)) {
+        mLastCommandTime = std::chrono::steady_clock::now();
+        mBusyTime += mLastCommandTime - start;
+        return;
+    }
 
+    try {
         std::vector<uint16_t> newValues(mModbus->readModbusRegisters(reg.mSlaveId, reg));
-        reg.mLastReadOk = true;
 
         std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
         BOOST_LOG_SEV(log, Log::trace) << "Register " << reg.mSlaveId << "." << reg.mRegister << " (0x" << std::hex << reg.mSlaveId << ".0x" << std::hex << reg.mRegister << ")"
                         << " polled in "  << std::dec << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms";
 
-        if (reg.mPublishMode == PublishMode::EVERY_POLL)
-            forceSend = true;
-
-        if ((reg.getValues() != newValues) || forceSend || (reg.mReadErrors != 0)) {
-            MsgRegisterValues val(reg.mSlaveId, reg.mRegisterType, reg.mRegister, newValues);
-            sendMessage(QueueItem::create(val));
-            reg.update(newValues);
-            if (reg.mReadErrors != 0) {
-                BOOST_LOG_SEV(log, Log::debug) << "Register "
-                    << reg.mSlaveId << "." << reg.mRegister
-                    << " read ok after " << reg.mReadErrors << " error(s)";
+        // covering read failed, probably due to registers in gaps
+        if (!coalesced.empty()) {
+            reg.setCoalescedReadFailed(end);
+            if (!reg.canCoalesce(end)) {
+                BOOST_LOG_SEV(log, Log::warn) << "Register " << reg.mSlaveId << "." << reg.mRegister
+                    << " cannot be read together with adjacent registers, disabling coalescing for it";
             }
-            reg.mReadErrors = 0;
-            BOOST_LOG_SEV(log, Log::trace) << "Register " << reg.mSlaveId << "." << reg.mRegister
-                << " values sent, data=" << DebugTools::registersToStr(reg.getValues());
-        };
+        }
+
+        updatePolledValues(reg, newValues, forceSend);
     } catch (const ModbusReadException& ex) {
         handleRegisterReadError(reg, ex.what());
     }
@@ -178,8 +184,99 @@ ModbusExecutor::pollRegisters(RegisterPoll& reg, bool forceSend) {
     // This will cause endless readModbusRegisters if register always
     // returns read error
     mLastCommandTime = reg.mLastRead = std::chrono::steady_clock::now();
+    mBusyTime += mLastCommandTime - start;
 };
 
+bool
+ModbusExecutor::pollCoalesced(RegisterPoll& reg, const std::vector<std::shared_ptr<RegisterPoll>>& coalesced, bool forceSend) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int first = reg.firstRegister();
+    int last = reg.lastRegister();
+    for(const std::shared_ptr<RegisterPoll>& poll: coalesced) {
+        first = std::min(first, poll->firstRegister());
+        last = std::max(last, poll->lastRegister());
+    }
+
+    RegisterPoll range(reg.mSlaveId, first, reg.mRegisterType, last - first + 1, std::chrono::milliseconds::zero(), PublishMode::ON_CHANGE);
+    std::vector<uint16_t> values;
+    try {
+        values = mModbus->readModbusRegisters(reg.mSlaveId, range);
+    } catch (const ModbusReadException& ex) {
+        BOOST_LOG_SEV(log, Log::debug) << "Registers " << reg.mSlaveId << "." << first << "-" << last
+            << " read failed, polling " << reg.mRegister << " alone: " << ex.what();
+        // coalesced polls will be executed later on their own
+        mSlaveQueues[reg.mSlaveId].addPollList(coalesced);
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    BOOST_LOG_SEV(log, Log::trace) << "Registers " << reg.mSlaveId << "." << first << "-" << last
+        << " polled in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms"
+        << " for " << coalesced.size() + 1 << " polls";
+
+    reg.setCoalescedReadOk();
+    updatePolledValues(reg, std::vector<uint16_t>(values.begin() + (reg.firstRegister() - first), values.begin() + (reg.lastRegister() - first + 1)), forceSend);
+    reg.mLastRead = end;
+    for(const std::shared_ptr<RegisterPoll>& poll: coalesced) {
+        if (!mInitialPoll)
+            poll->updateDeadlineStats(start);
+        updatePolledValues(*poll, std::vector<uint16_t>(values.begin() + (poll->firstRegister() - first), values.begin() + (poll->lastRegister() - first + 1)), forceSend);
+        poll->mLastRead = end;
+    }
+    return true;
+}
+
+void
+ModbusExecutor::updatePolledValues(RegisterPoll& reg, const std::vector<uint16_t>& newValues, bool forceSend) {
+    reg.mLastReadOk = true;
+
+    if (reg.mPublishMode == PublishMode::EVERY_POLL || reg.popForceNextSend())
+        forceSend = true;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    // last values are updated only when sent, so changes
+    // within deadband accumulate until threshold is exceeded
+    bool valuesChanged = (reg.getValues() != newValues) && !reg.isWithinDeadband(newValues, now);
+    reg.adaptRefresh(valuesChanged);
+
+    // initial poll reads all registers anyway
+    if (valuesChanged && !mInitialPoll && reg.hasDependentPolls())
+        addTriggeredPolls(reg, newValues);
+
+    if (valuesChanged || forceSend || (reg.mReadErrors != 0)) {
+        MsgRegisterValues val(reg.mSlaveId, reg.mRegisterType, reg.mRegister, newValues);
+        sendMessage(QueueItem::create(val));
+        reg.update(newValues);
+        reg.mLastSendTime = now;
+        if (reg.mReadErrors != 0) {
+            BOOST_LOG_SEV(log, Log::debug) << "Register "
+                << reg.mSlaveId << "." << reg.mRegister
+                << " read ok after " << reg.mReadErrors << " error(s)";
+        }
+        reg.mReadErrors = 0;
+        BOOST_LOG_SEV(log, Log::trace) << "Register " << reg.mSlaveId << "." << reg.mRegister
+            << " values sent, data=" << DebugTools::registersToStr(reg.getValues());
+    };
+}
+
+void
+ModbusExecutor::addTriggeredPolls(const RegisterPoll& reg, const std::vector<uint16_t>& newValues) {
+    std::vector<std::shared_ptr<RegisterPoll>> triggered(reg.getTriggeredPolls(newValues));
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for(const std::shared_ptr<RegisterPoll>& poll: triggered) {
+        if (poll->isSuspended())
+            continue;
+        BOOST_LOG_SEV(log, Log::debug) << "Register " << reg.mSlaveId << "." << reg.mRegister
+            << " changed, adding poll for " << poll->mSlaveId << "." << poll->mRegister;
+        // queued in deadline order with periodic polls, so it is not
+        // starved when the bus is saturated with overdue polls
+        poll->setTriggered(now);
+        // std::map::operator[] does not invalidate mCurrentSlaveQueue
+        mSlaveQueues[poll->mSlaveId].addPollList(std::vector<std::shared_ptr<RegisterPoll>>(1, poll));
+    }
+}
+
 void
 ModbusExecutor::handleRegisterReadError(RegisterPoll& regPoll, const char* errorMessage) {
     // avoid flooding logs with register read error messages - log last error every 5 minutes
@@ -203,8 +300,8 @@ ModbusExecutor::handleRegisterReadError(RegisterPoll& regPoll, const char* error
 
 void
 ModbusExecutor::writeRegisters(RegisterWrite& cmd) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     try {
-        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
         mModbus->writeModbusRegisters(cmd.mSlaveId, cmd);
         cmd.mLastWriteOk = true;
 
@@ -225,34 +322,74 @@ ModbusExecutor::writeRegisters(RegisterWrite& cmd) {
         sendMessage(QueueItem::create(msg));
     }
     mLastCommandTime = std::chrono::steady_clock::now();
+    mBusyTime += mLastCommandTime - start;
 }
 
 
 std::chrono::steady_clock::duration
 ModbusExecutor::executeNext() {
     //assert(!allDone());
+    if (!mDelayedRetries.empty()) {
+        std::chrono::steady_clock::duration retryWait = requeueRetries(std::chrono::steady_clock::now());
+        if (mWaitingCommand == nullptr && queuesEmpty())
+            return retryWait;
+    }
+
     if (mWaitingCommand == nullptr) {
         // find next non empty queue and start sending requests from it
         if (mCurrentSlaveQueue != mSlaveQueues.end()) {
-            if (mCommandsLeft == 0 || mCurrentSlaveQueue->second.empty()) {
-                auto nextQueue = mCurrentSlaveQueue;
-                nextQueue++;
-                while(nextQueue != mCurrentSlaveQueue) {
-                    if (nextQueue == mSlaveQueues.end())
-                        nextQueue = mSlaveQueues.begin();
-
-                    if (!nextQueue->second.empty()) {
-                        break;
-                    }
-                    nextQueue++;
+            // find other slave with the highest priority,
+            // enough bus time credit and the earliest deadline
+            auto now = std::chrono::steady_clock::now();
+            auto nextQueue = mCurrentSlaveQueue;
+            auto nextDeadline = std::chrono::steady_clock::time_point::max();
+            CommandPriority nextPriority = CommandPriority::LOW;
+            bool nextAffordable = false;
+            for(auto it = mSlaveQueues.begin(); it != mSlaveQueues.end(); it++) {
+                if (it == mCurrentSlaveQueue || it->second.empty())
+                    continue;
+                CommandPriority priority = it->second.getNextPriority(now);
+                bool affordable = it->second.canAffordTurn();
+                auto deadline = it->second.getNextDeadline();
+                if (nextQueue == mCurrentSlaveQueue
+                    || priority > nextPriority
+                    || (priority == nextPriority && affordable && !nextAffordable)
+                    || (priority == nextPriority && affordable == nextAffordable && deadline < nextDeadline))
+                {
+                    nextQueue = it;
+                    nextDeadline = deadline;
+                    nextPriority = priority;
+                    nextAffordable = affordable;
                 }
+            }
+
+            // higher priority commands of other slave are executed
+            // without waiting for current slave batch to finish
+            bool preempt = nextQueue != mCurrentSlaveQueue && !mCurrentSlaveQueue->second.empty()
+                && nextPriority > mCurrentSlaveQueue->second.getNextPriority(now);
 
+            // do not leave slave without credit if there is nothing else to do
+            bool outOfCredit = !mCurrentSlaveQueue->second.hasCredit();
+            if (outOfCredit && nextQueue == mCurrentSlaveQueue) {
+                mCurrentSlaveQueue->second.addQuantum();
+                outOfCredit = false;
+            }
+
+            if (mCommandsLeft == 0 || mCurrentSlaveQueue->second.empty() || preempt || outOfCredit) {
+                if (mCurrentSlaveQueue->second.empty())
+                    mCurrentSlaveQueue->second.resetCredit();
                 // if mCurrentSlaveQueue was left due to mCommandsLeft==0
                 // nextQueue could point at it again after doing full circle
                 if (mCurrentSlaveQueue != nextQueue || !mCurrentSlaveQueue->second.empty()) {
+                    // slaves skipped due to lack of credit get their quantum
+                    // and will be able to execute commands in next turns
+                    for(auto it = mSlaveQueues.begin(); it != mSlaveQueues.end(); it++) {
+                        if (it != nextQueue && !it->second.empty() && !it->second.canAffordTurn())
+                            it->second.addQuantum();
+                    }
                     mCurrentSlaveQueue = nextQueue;
                     mWaitingCommand = mCurrentSlaveQueue->second.popNext();
-                    resetCommandsCounter();
+                    startSlaveTurn();
                 } else {
                     //nothing to do
                     return std::chrono::steady_clock::duration::max();
@@ -301,38 +438,39 @@ ModbusExecutor::executeNext() {
 void
 ModbusExecutor::sendCommand() {
     bool retry = false;
-    if (mWaitingCommand != mLastCommand) {
-        setMaxReadRetryCount(mWaitingCommand->mMaxReadRetryCount);
-        setMaxWriteRetryCount(mWaitingCommand->mMaxWriteRetryCount);
-    }
-
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
     if (typeid(*mWaitingCommand) == typeid(RegisterPoll)) {
         RegisterPoll& pollcmd(static_cast<RegisterPoll&>(*mWaitingCommand));
         pollRegisters(pollcmd, mInitialPoll);
-        if (!pollcmd.mLastReadOk) {
-            if (mReadRetryCount != 0) {
-                retry = true;
-                mReadRetryCount--;
-            }
-        } else {
-            mReadRetryCount = mMaxReadRetryCount;
-        }
+        retry = !pollcmd.mLastReadOk && pollcmd.mRetryCount < pollcmd.mMaxReadRetryCount;
     } else {
         RegisterWrite& writecmd(static_cast<RegisterWrite&>(*mWaitingCommand));
         writeRegisters(writecmd);
-        if (!writecmd.mLastWriteOk) {
-            if (mWriteRetryCount != 0) {
-                retry = true;
-                mWriteRetryCount--;
-            }
-        } else {
-            mWriteRetryCount = mMaxWriteRetryCount;
+        retry = !writecmd.mLastWriteOk && writecmd.mRetryCount < writecmd.mMaxWriteRetryCount;
+        if (!retry) {
             mWriteCommandsQueued--;
             assert(mWriteCommandsQueued >= 0);
         }
     }
+
+    if (retry)
+        mWaitingCommand->mRetryCount++;
+    else
+        mWaitingCommand->mRetryCount = 0;
+
     mLastCommand = mWaitingCommand;
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    mSlaveQueues[mWaitingCommand->mSlaveId].chargeTransaction(end - start);
+
+    if (retry && mRequeueRetries) {
+        BOOST_LOG_SEV(log, Log::debug) << "Command for " << mWaitingCommand->mSlaveId << "." << mWaitingCommand->getRegister()
+            << " failed, retry " << mWaitingCommand->mRetryCount << " in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(mRetryBackoff).count() << "ms";
+        mWaitingCommand->mRetryAfter = end + mRetryBackoff;
+        mDelayedRetries.push_back(mWaitingCommand);
+        retry = false;
+    }
 
     // to retry just leave mCurrentCommand
     // for next executeNext() call
@@ -344,11 +482,47 @@ ModbusExecutor::sendCommand() {
 }
 
 
+std::chrono::steady_clock::duration
+ModbusExecutor::requeueRetries(const std::chrono::steady_clock::time_point& pNow) {
+    while(!mDelayedRetries.empty() && mDelayedRetries.front()->mRetryAfter <= pNow) {
+        std::shared_ptr<RegisterCommand> cmd(mDelayedRetries.front());
+        mDelayedRetries.pop_front();
+
+        ModbusRequestsQueues& queue = mSlaveQueues[cmd->mSlaveId];
+        if (typeid(*cmd) == typeid(RegisterPoll)) {
+            std::shared_ptr<RegisterPoll> poll(std::static_pointer_cast<RegisterPoll>(cmd));
+            // scheduled poll was executed during backoff
+            if (poll->mLastReadOk) {
+                poll->mRetryCount = 0;
+                continue;
+            }
+            queue.addPollList(std::vector<std::shared_ptr<RegisterPoll>>(1, poll));
+        } else {
+            queue.addWriteCommand(std::static_pointer_cast<RegisterWrite>(cmd));
+        }
+
+        if (mCurrentSlaveQueue == mSlaveQueues.end()) {
+            mCurrentSlaveQueue = mSlaveQueues.find(cmd->mSlaveId);
+            startSlaveTurn();
+        }
+    }
+
+    if (mDelayedRetries.empty())
+        return std::chrono::steady_clock::duration::max();
+    return mDelayedRetries.front()->mRetryAfter - pNow;
+}
+
+
 bool
 ModbusExecutor::allDone() const {
-    if (mWaitingCommand != nullptr)
+    if (mWaitingCommand != nullptr || !mDelayedRetries.empty())
         return false;
 
+    return queuesEmpty();
+}
+
+bool
+ModbusExecutor::queuesEmpty() const {
     auto non_empty = std::find_if(mSlaveQueues.begin(), mSlaveQueues.end(),
         [](const auto& queue) -> bool { return !(queue.second.empty()); }
     );
@@ -361,6 +535,12 @@ ModbusExecutor::pollDone() const {
     if (mWaitingCommand != nullptr && typeid(*mWaitingCommand) == typeid(RegisterPoll))
         return false;
 
+    auto delayed_poll = std::find_if(mDelayedRetries.begin(), mDelayedRetries.end(),
+        [](const std::shared_ptr<RegisterCommand>& cmd) -> bool { return typeid(*cmd) == typeid(RegisterPoll); }
+    );
+    if (delayed_poll != mDelayedRetries.end())
+        return false;
+
     auto non_empty = std::find_if(mSlaveQueues.begin(), mSlaveQueues.end(),
         [](const auto& queue) -> bool { return !(queue.second.mPollQueue.empty()); }
     );
@@ -370,11 +550,24 @@ ModbusExecutor::pollDone() const {
 
 void
 ModbusExecutor::resetCommandsCounter() {
+    if (mCurrentSlaveQueue == mSlaveQueues.end())
+        return;
+
     if (mCurrentSlaveQueue->second.mPollQueue.empty())
         mCommandsLeft = WRITE_BATCH_SIZE;
-    else if (mCurrentSlaveQueue != mSlaveQueues.end())
+    else
+        // earliest deadline of other slaves is checked only
+        // when this batch ends, not after every command
         mCommandsLeft = mCurrentSlaveQueue->second.mPollQueue.size() * 2;
 }
 
 
+void
+ModbusExecutor::startSlaveTurn() {
+    resetCommandsCounter();
+    if (mCurrentSlaveQueue != mSlaveQueues.end())
+        mCurrentSlaveQueue->second.addQuantum();
+}
+
+
 }
@@ -41,6 +41,26 @@ class ModbusExecutor {
 
         int getCommandsLeft() const { return mCommandsLeft; }
 
+        /*
+            Put failed commands back to their slave queue and retry them
+            not earlier than after pBackoff. Commands of other slaves
+            are executed in the meantime.
+        */
+        void setRetryBackoff(const std::chrono::steady_clock::duration& pBackoff) {
+            mRequeueRetries = true;
+            mRetryBackoff = pBackoff;
+        }
+
+        // set share of bus time for slave compared to other slaves
+        void setSlaveWeight(int pSlaveId, unsigned short pWeight) { mSlaveQueues[pSlaveId].setWeight(pWeight); }
+        void setSlaveQuantum(int pSlaveId, const std::chrono::steady_clock::duration& pQuantum) { mSlaveQueues[pSlaveId].setQuantum(pQuantum); }
+        // allow reading due polls of slave with a single command, -1 disables it
+        void setSlaveMaxReadGap(int pSlaveId, int pMaxGap) { mSlaveQueues[pSlaveId].setMaxReadGap(pMaxGap); }
+        const ModbusRequestsQueues* getSlaveQueues(int pSlaveId) const {
+            auto it = mSlaveQueues.find(pSlaveId);
+            return it == mSlaveQueues.end() ? nullptr : &(it->second);
+        }
+
         const std::shared_ptr<RegisterCommand>& getWaitingCommand() const { return mWaitingCommand; }
         /*
             Returns last command executed by executeNext or nullptr if executeNext()
@@ -48,6 +68,16 @@ class ModbusExecutor {
         */
         const std::shared_ptr<RegisterCommand>& getLastCommand() const { return mLastCommand; }
 
+        /*
+            Returns time spent on executing modbus commands since
+            last call
+        */
+        std::chrono::steady_clock::duration popBusyTime() {
+            auto ret = mBusyTime;
+            mBusyTime = std::chrono::steady_clock::duration::zero();
+            return ret;
+        }
+
     private:
         static  boost::log::sources::severity_logger<Log::severity> log;
 
@@ -66,12 +96,15 @@ class ModbusExecutor {
 
         int mWriteCommandsQueued = 0;
 
-        short mMaxReadRetryCount = 0;
-        short mMaxWriteRetryCount = 0;
-        short mWriteRetryCount;
-        short mReadRetryCount;
+        // if true, failed commands are put back to slave queue
+        // instead of blocking the bus with immediate retries
+        bool mRequeueRetries = false;
+        std::chrono::steady_clock::duration mRetryBackoff = std::chrono::steady_clock::duration::zero();
+        // failed commands waiting for retry backoff, in retry time order
+        std::deque<std::shared_ptr<RegisterCommand>> mDelayedRetries;
 
         std::chrono::steady_clock::time_point mLastCommandTime;
+        std::chrono::steady_clock::duration mBusyTime = std::chrono::steady_clock::duration::zero();
 
         //used to determine if we have to respect delay of RegisterPoll::ReadDelayType::ON_SLAVE_CHANGE
         std::shared_ptr<RegisterCommand> mWaitingCommand;
@@ -82,13 +115,21 @@ class ModbusExecutor {
 
         void sendCommand();
         void pollRegisters(RegisterPoll& reg_ptr, bool forceSend);
+        // read reg and coalesced polls with a single command, false if read failed
+        bool pollCoalesced(RegisterPoll& reg, const std::vector<std::shared_ptr<RegisterPoll>>& coalesced, bool forceSend);
+        void updatePolledValues(RegisterPoll& reg, const std::vector<uint16_t>& newValues, bool forceSend);
+        void addTriggeredPolls(const RegisterPoll& reg, const std::vector<uint16_t>& newValues);
         void writeRegisters(RegisterWrite& cmd);
         void sendMessage(const QueueItem& item);
         void handleRegisterReadError(RegisterPoll& reg, const char* errorMessage);
         void resetCommandsCounter();
+        // mCurrentSlaveQueue starts its turn and gets its bus time quantum
+        void startSlaveTurn();
+        bool queuesEmpty() const;
 
-        void setMaxReadRetryCount(short val) { mMaxReadRetryCount = mReadRetryCount = val; }
-        void setMaxWriteRetryCount(short val) { mMaxWriteRetryCount = mWriteRetryCount = val; }
+        // move commands with expired backoff to slave queues
+        // returns time left to the next retry
+        std::chrono::steady_clock::duration requeueRetries(const std::chrono::steady_clock::time_point& pNow);
 };
 
 }
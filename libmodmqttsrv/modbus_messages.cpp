@@ -1,6 +1,7 @@
 #include "modbus_messages.hpp"
 
 #include <deque>
+#include <algorithm>
 
 namespace modmqttd {
 
@@ -17,10 +18,51 @@ MsgRegisterPoll::merge(const MsgRegisterPoll& other) {
     //set the shortest poll period
     if (mRefreshMsec == INVALID_REFRESH) {
         mRefreshMsec = other.mRefreshMsec;
-    } else if (other.mRefreshMsec != INVALID_REFRESH && mRefreshMsec > other.mRefreshMsec) {
-        mRefreshMsec = other.mRefreshMsec;
-        BOOST_LOG_SEV(log, Log::debug) << "Setting refresh " << mRefreshMsec.count() << "ms on existing register " << mRegister;
+        mMaxRefreshMsec = other.mMaxRefreshMsec;
+    } else if (other.mRefreshMsec != INVALID_REFRESH) {
+        // the longest period for adaptive refresh cannot
+        // exceed any fixed or adaptive period merged here
+        std::chrono::milliseconds maxRefresh = std::min(getMaxRefresh(), other.getMaxRefresh());
+        if (mRefreshMsec > other.mRefreshMsec) {
+            mRefreshMsec = other.mRefreshMsec;
+            BOOST_LOG_SEV(log, Log::debug) << "Setting refresh " << mRefreshMsec.count() << "ms on existing register " << mRegister;
+        }
+        mMaxRefreshMsec = maxRefresh > mRefreshMsec ? maxRefresh : INVALID_REFRESH;
+    }
+
+    // the highest priority wins
+    if (mPriority < other.mPriority)
+        mPriority = other.mPriority;
+
+    for(auto& trigger: other.mTriggers)
+        addTrigger(trigger);
+
+    mDeadbands.insert(mDeadbands.end(), other.mDeadbands.begin(), other.mDeadbands.end());
+    mUnfilteredRanges.insert(mUnfilteredRanges.end(), other.mUnfilteredRanges.begin(), other.mUnfilteredRanges.end());
+}
+
+void
+MsgRegisterPoll::addTrigger(const ModbusSlaveAddressRange& pTrigger) {
+    auto it = std::find_if(mTriggers.begin(), mTriggers.end(),
+        [&pTrigger](const ModbusSlaveAddressRange& t) -> bool { return t.mSlaveId == pTrigger.mSlaveId && t.isSameAs(pTrigger); }
+    );
+    if (it == mTriggers.end())
+        mTriggers.push_back(pTrigger);
+}
+
+bool
+MsgRegisterPoll::hasSameTriggers(const MsgRegisterPoll& other) const {
+    if (mTriggers.size() != other.mTriggers.size())
+        return false;
+
+    for(auto& trigger: other.mTriggers) {
+        auto it = std::find_if(mTriggers.begin(), mTriggers.end(),
+            [&trigger](const ModbusSlaveAddressRange& t) -> bool { return t.mSlaveId == trigger.mSlaveId && t.isSameAs(trigger); }
+        );
+        if (it == mTriggers.end())
+            return false;
     }
+    return true;
 }
 
 bool
@@ -73,7 +115,8 @@ MsgRegisterPollSpecification::group() {
             std::vector<MsgRegisterPoll> grouped(1, regs.front()); regs.pop_front();
             auto group_it = grouped.begin();
             while(!regs.empty()) {
-                if (group_it->isConsecutiveOf(regs.front()))  {
+                // do not join ranges polled on change of different registers
+                if (group_it->isConsecutiveOf(regs.front()) && group_it->hasSameTriggers(regs.front()))  {
                     group_it->merge(regs.front());
                 } else {
                     group_it = grouped.insert(grouped.end(), regs.front());
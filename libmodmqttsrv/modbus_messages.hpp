@@ -32,6 +32,8 @@ class MsgRegisterValues : public ModbusSlaveAddressRange {
         bool hasCommandId() const { return mCommandId != 0; }
 
         ModbusRegisters mRegisters;
+        // used for writes only
+        CommandPriority mPriority = CommandPriority::NORMAL;
     private:
         std::chrono::steady_clock::time_point mCreationTime;
         int mCommandId = 0;
@@ -69,8 +71,28 @@ class MsgRegisterPoll : public ModbusSlaveAddressRange {
         bool isSameAs(const MsgRegisterPoll& other) const;
         void merge(const MsgRegisterPoll& other);
 
+        // adaptive refresh: mRefreshMsec is the shortest
+        // and mMaxRefreshMsec the longest poll period
+        bool isAdaptive() const { return mMaxRefreshMsec != INVALID_REFRESH; }
+        std::chrono::milliseconds getMaxRefresh() const { return isAdaptive() ? mMaxRefreshMsec : mRefreshMsec; }
+
+        void addTrigger(const ModbusSlaveAddressRange& pTrigger);
+        bool hasSameTriggers(const MsgRegisterPoll& other) const;
+
         std::chrono::milliseconds mRefreshMsec = INVALID_REFRESH;
+        std::chrono::milliseconds mMaxRefreshMsec = INVALID_REFRESH;
         PublishMode mPublishMode = PublishMode::ON_CHANGE;
+        CommandPriority mPriority = CommandPriority::NORMAL;
+
+        // registers that force poll of this range when their value changes
+        // if mRefreshMsec is not set then this range is polled only on change
+        std::vector<ModbusSlaveAddressRange> mTriggers;
+
+        // registers published only when change exceeds deadband
+        std::vector<RegisterDeadband> mDeadbands;
+        // registers used without deadband. Deadbands overlapping
+        // any of them are not applied
+        std::vector<ModbusAddressRange> mUnfilteredRanges;
 };
 
 class MsgRegisterPollSpecification {
@@ -105,6 +127,20 @@ class MsgRegisterPollSpecification {
         std::vector<MsgRegisterPoll> mRegisters;
 };
 
+/*!
+    Sent from main thread to suspend or resume polling
+    of state registers when object availability register
+    reports that device is not available
+*/
+class MsgRegisterPollSuspend : public ModbusSlaveAddressRange {
+    public:
+        MsgRegisterPollSuspend(int slaveId, RegisterType regType, int registerNumber, int registerCount, bool suspend)
+            : ModbusSlaveAddressRange(slaveId, registerNumber, regType, registerCount),
+              mSuspend(suspend)
+        {}
+        bool mSuspend;
+};
+
 class MsgModbusNetworkState {
     public:
         MsgModbusNetworkState(const std::string& networkName, bool isUp)
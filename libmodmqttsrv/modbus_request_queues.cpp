@@ -1,7 +1,23 @@
+#include <algorithm>
+#include <modbus/modbus.h>
+
 #include "modbus_request_queues.hpp"
 
 namespace modmqttd {
 
+#if __cplusplus < 201703L
+constexpr std::chrono::milliseconds ModbusRequestsQueues::FAIR_QUANTUM;
+#endif
+
+void
+ModbusRequestsQueues::addQuantum() {
+    // slave that was not able to use its whole credit
+    // cannot collect more than a single quantum
+    mCredit += getQuantum();
+    if (mCredit > getQuantum())
+        mCredit = getQuantum();
+}
+
 void
 ModbusRequestsQueues::addPollList(const std::vector<std::shared_ptr<RegisterPoll>>& pollList) {
     for (auto& regPollPtr: pollList) {
@@ -10,25 +26,131 @@ ModbusRequestsQueues::addPollList(const std::vector<std::shared_ptr<RegisterPoll
             mPollQueue.begin(), mPollQueue.end(), regPollPtr
         );
 
-        if (it == mPollQueue.end()) {
-            mPollQueue.push_back(regPollPtr);
+        // keep FIFO order for registers with the same deadline
+        if (it == mPollQueue.end())
+            insertPoll(regPollPtr, false);
+    }
+}
+
+void
+ModbusRequestsQueues::insertPoll(const std::shared_ptr<RegisterPoll>& pPoll, bool pFirst) {
+    auto compare = [](const std::shared_ptr<RegisterPoll>& a, const std::shared_ptr<RegisterPoll>& b) -> bool {
+        return a->getDeadline() < b->getDeadline();
+    };
+    auto pos = pFirst
+        ? std::lower_bound(mPollQueue.begin(), mPollQueue.end(), pPoll, compare)
+        : std::upper_bound(mPollQueue.begin(), mPollQueue.end(), pPoll, compare);
+    mPollQueue.insert(pos, pPoll);
+}
+
+std::vector<std::shared_ptr<RegisterPoll>>
+ModbusRequestsQueues::popCoalescable(const RegisterPoll& pPoll, const std::chrono::steady_clock::time_point& pNow) {
+    std::vector<std::shared_ptr<RegisterPoll>> ret;
+    if (mMaxReadGap < 0 || !pPoll.canCoalesce(pNow))
+        return ret;
+
+    int maxCount = MODBUS_MAX_READ_REGISTERS;
+    if (pPoll.mRegisterType == RegisterType::COIL || pPoll.mRegisterType == RegisterType::BIT)
+        maxCount = MODBUS_MAX_READ_BITS;
+
+    int first = pPoll.firstRegister();
+    int last = pPoll.lastRegister();
+
+    // extend covering range until there is nothing more to add,
+    // every added poll can bring other polls within max gap
+    bool added;
+    do {
+        added = false;
+        for(auto it = mPollQueue.begin(); it != mPollQueue.end(); it++) {
+            const RegisterPoll& poll(**it);
+            if (poll.mRegisterType != pPoll.mRegisterType || !poll.canCoalesce(pNow)
+                || (!poll.isTriggeredOnly() && poll.getDeadline() > pNow))
+                continue;
+            if (poll.firstRegister() - last - 1 > mMaxReadGap || first - poll.lastRegister() - 1 > mMaxReadGap)
+                continue;
+
+            int newFirst = std::min(first, poll.firstRegister());
+            int newLast = std::max(last, poll.lastRegister());
+            if (newLast - newFirst + 1 > maxCount)
+                continue;
+
+            first = newFirst;
+            last = newLast;
+            ret.push_back(*it);
+            mPollQueue.erase(it);
+            added = true;
+            break;
+        }
+    } while (added);
+
+    return ret;
+}
+
+std::chrono::steady_clock::time_point
+ModbusRequestsQueues::getNextDeadline() const {
+    auto ret = std::chrono::steady_clock::time_point::max();
+    if (!mWriteQueue.empty())
+        ret = mWriteQueue.front()->mCreationTime;
+    if (!mPollQueue.empty() && mPollQueue.front()->getDeadline() < ret)
+        ret = mPollQueue.front()->getDeadline();
+    return ret;
+}
+
+std::deque<std::shared_ptr<RegisterPoll>>::iterator
+ModbusRequestsQueues::findNextPoll(const std::chrono::steady_clock::time_point& pNow) {
+    // queue is in deadline order, so the first poll
+    // with the highest priority has the earliest deadline
+    auto ret = mPollQueue.begin();
+    if (ret == mPollQueue.end())
+        return ret;
+
+    CommandPriority priority = (*ret)->getEffectivePriority(pNow);
+    for(auto it = std::next(ret); it != mPollQueue.end() && priority != CommandPriority::HIGH; it++) {
+        CommandPriority p = (*it)->getEffectivePriority(pNow);
+        if (p > priority) {
+            ret = it;
+            priority = p;
         }
     }
+    return ret;
+}
+
+CommandPriority
+ModbusRequestsQueues::getNextPriority(const std::chrono::steady_clock::time_point& pNow) {
+    CommandPriority ret = CommandPriority::LOW;
+    if (!mWriteQueue.empty())
+        ret = mWriteQueue.front()->mPriority;
+    auto poll = findNextPoll(pNow);
+    if (poll != mPollQueue.end() && (*poll)->getEffectivePriority(pNow) > ret)
+        ret = (*poll)->getEffectivePriority(pNow);
+    return ret;
 }
 
 std::shared_ptr<RegisterCommand>
 ModbusRequestsQueues::popNext() {
+    auto now = std::chrono::steady_clock::now();
+    auto poll = findNextPoll(now);
+
+    // alternate between polls and writes with the same priority
+    if (poll != mPollQueue.end() && !mWriteQueue.empty()) {
+        CommandPriority pollPriority = (*poll)->getEffectivePriority(now);
+        if (pollPriority != mWriteQueue.front()->mPriority)
+            mPopFromPoll = pollPriority > mWriteQueue.front()->mPriority;
+    }
+
     std::shared_ptr<RegisterCommand> ret;
     if (mPopFromPoll) {
         if (mPollQueue.empty()) {
             ret = popNext(mWriteQueue);
         } else {
             mPopFromPoll = false;
-            ret = popNext(mPollQueue);
+            ret = *poll;
+            mPollQueue.erase(poll);
         }
     } else {
         if (mWriteQueue.empty()) {
-            ret = popNext(mPollQueue);
+            ret = *poll;
+            mPollQueue.erase(poll);
         } else {
             mPopFromPoll = true;
             ret = popNext(mWriteQueue);
@@ -112,7 +234,9 @@ ModbusRequestsQueues::addWriteCommand(const std::shared_ptr<RegisterWrite>& pReq
 void
 ModbusRequestsQueues::readdCommand(const std::shared_ptr<RegisterCommand>& pCmd) {
     if (typeid(*pCmd) == typeid(RegisterPoll)) {
-        mPollQueue.push_front(std::static_pointer_cast<RegisterPoll>(pCmd));
+        // queue must stay in deadline order, readded poll
+        // goes before other polls with the same deadline
+        insertPoll(std::static_pointer_cast<RegisterPoll>(pCmd), true);
         mPopFromPoll = true;
     } else {
         mWriteQueue.push_front(std::static_pointer_cast<RegisterWrite>(pCmd));
@@ -10,6 +10,7 @@ namespace modmqttd {
 class ModbusRequestsQueues {
     public:
         // set a list of registers from next poll
+        // registers are queued in deadline order
         void addPollList(const std::vector<std::shared_ptr<RegisterPoll>>& pollList);
 
         // shared_ptr because RegisterWrite will be long-lived object
@@ -26,13 +27,61 @@ class ModbusRequestsQueues {
         // uses popNext() if pDelay is not found in queue
         std::shared_ptr<RegisterCommand> popFirstWithDelay(std::chrono::steady_clock::duration pPeriod, bool ignore_first_read);
 
-        // remove next RegisterPoll from queue and return it
-        // if mPollQueue is empty then move all registers from
-        // mNextPollQueue and return the first one
+        // remove next command from queue and return it
+        // commands with higher priority are returned first,
+        // polls and writes with the same priority are interleaved
         std::shared_ptr<RegisterCommand> popNext();
 
+        // the highest priority of commands that popNext() could return
+        CommandPriority getNextPriority(const std::chrono::steady_clock::time_point& pNow);
+
         bool empty() const { return mPollQueue.empty() && mWriteQueue.empty(); }
 
+        /*
+            Remove polls due at pNow that can be read together with pPoll
+            in a single command: the same register type, gaps between
+            register ranges not longer than max read gap and the covering
+            range within modbus PDU limit. Returns empty list if
+            coalescing is disabled.
+        */
+        std::vector<std::shared_ptr<RegisterPoll>> popCoalescable(const RegisterPoll& pPoll, const std::chrono::steady_clock::time_point& pNow);
+
+        void setMaxReadGap(int pGap) { mMaxReadGap = pGap; }
+        int getMaxReadGap() const { return mMaxReadGap; }
+
+        // the earliest deadline of queued commands
+        // write commands should be executed as soon as possible
+        std::chrono::steady_clock::time_point getNextDeadline() const;
+
+        /*
+            Deficit round robin accounting. Every time executor switches
+            to this slave it gets weight * quantum of bus time.
+            Commands are executed while credit is left, measured time
+            of the last command can overrun it. Overrun is paid back
+            in next turns.
+        */
+        static constexpr std::chrono::milliseconds FAIR_QUANTUM = std::chrono::milliseconds(200);
+
+        void setWeight(unsigned short pWeight) { mWeight = pWeight; }
+        unsigned short getWeight() const { return mWeight; }
+        // bus time for weight 1, FAIR_QUANTUM by default
+        void setQuantum(const std::chrono::steady_clock::duration& pQuantum) { mQuantum = pQuantum; }
+        std::chrono::steady_clock::duration getQuantum() const { return mQuantum * mWeight; }
+
+        // called when executor switches to this slave
+        void addQuantum();
+        // subtract measured command execution time from credit
+        void chargeTransaction(const std::chrono::steady_clock::duration& pTime) { mCredit -= pTime; }
+        // idle slave do not collect credit
+        void resetCredit() { mCredit = std::chrono::steady_clock::duration::zero(); }
+
+        // next command can be executed without switching to other slave
+        bool hasCredit() const { return mCredit > std::chrono::steady_clock::duration::zero(); }
+        // next command can be executed after addQuantum()
+        bool canAffordTurn() const { return mCredit + getQuantum() > std::chrono::steady_clock::duration::zero(); }
+
+        const std::chrono::steady_clock::duration& getCredit() const { return mCredit; }
+
         // registers to poll next
         std::deque<std::shared_ptr<RegisterPoll>> mPollQueue;
 
@@ -43,9 +92,21 @@ class ModbusRequestsQueues {
 
         template<typename T> std::shared_ptr<RegisterCommand> popNext(T& queue);
 
+        // insert pPoll at its deadline position, before or
+        // after polls with the same deadline
+        void insertPoll(const std::shared_ptr<RegisterPoll>& pPoll, bool pFirst);
+
+        // the first poll with the highest effective priority
+        std::deque<std::shared_ptr<RegisterPoll>>::iterator findNextPoll(const std::chrono::steady_clock::time_point& pNow);
+
         // if true then popNext will get element from mPollQueue,
         // otherwise from mWriteQueue
         bool mPopFromPoll = true;
+
+        unsigned short mWeight = 1;
+        std::chrono::steady_clock::duration mQuantum = FAIR_QUANTUM;
+        int mMaxReadGap = -1;
+        std::chrono::steady_clock::duration mCredit = std::chrono::steady_clock::duration::zero();
 };
 
 }
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "modbus_scheduler.hpp"
 #include "modbus_types.hpp"
 
@@ -5,6 +7,45 @@ namespace modmqttd {
 
 boost::log::sources::severity_logger<Log::severity> ModbusScheduler::log;
 
+void
+ModbusScheduler::setPollSpecification(const std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>& pRegisterMap) {
+    mRegisterMap = pRegisterMap;
+
+    // offsets depend only on poll specification order,
+    // so they are the same after every reconnect
+    std::map<std::chrono::steady_clock::duration, std::vector<std::shared_ptr<RegisterPoll>>> groups;
+    for(const auto& slave: mRegisterMap) {
+        for(const std::shared_ptr<RegisterPoll>& reg: slave.second) {
+            if (!reg->isTriggeredOnly())
+                groups[reg->getMinRefresh()].push_back(reg);
+        }
+    }
+
+    for(const auto& group: groups) {
+        const std::vector<std::shared_ptr<RegisterPoll>>& polls(group.second);
+        // the last poll is due one refresh period after
+        // initial poll, the same as without spreading
+        for(size_t i = 0; i < polls.size(); i++) {
+            polls[i]->setPhaseOffset(group.first * (i + 1) / polls.size());
+        }
+    }
+}
+
+void
+ModbusScheduler::applyPhaseOffsets(const std::chrono::steady_clock::time_point& pStart) {
+    if (!mPhaseSpreading)
+        return;
+
+    for(const auto& slave: mRegisterMap) {
+        for(const std::shared_ptr<RegisterPoll>& reg: slave.second) {
+            // first scheduled poll is due at pStart + offset
+            if (!reg->isTriggeredOnly())
+                reg->mLastRead = pStart + reg->getPhaseOffset() - reg->mRefresh;
+        }
+    }
+    BOOST_LOG_SEV(log, Log::debug) << "Polls spread over their refresh periods";
+}
+
 std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>
 ModbusScheduler::getRegistersToPoll(
     std::chrono::steady_clock::duration& outDuration,
@@ -15,14 +56,27 @@ ModbusScheduler::getRegistersToPoll(
     //BOOST_LOG_SEV(log, Log::trace) << "initial outduration " << std::chrono::duration_cast<std::chrono::milliseconds>(outDuration).count();
 
     outDuration = std::chrono::steady_clock::duration::max();
+    mLastSilenceSaved = std::chrono::steady_clock::duration::zero();
+    int pulledCount = 0;
+
     for(std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>::const_iterator slave = mRegisterMap.begin();
         slave != mRegisterMap.end(); slave++)
     {
+        // registers that are not due yet, but could be polled
+        // together with due registers from the same slave
+        std::vector<std::shared_ptr<RegisterPoll>> nearlyDue;
+        auto slaveDuration = std::chrono::steady_clock::duration::max();
+
         for(std::vector<std::shared_ptr<RegisterPoll>>::const_iterator reg_it = slave->second.begin();
             reg_it != slave->second.end(); reg_it++)
         {
             const RegisterPoll& reg = **reg_it;
 
+            // polled by executor when trigger register changes
+            // or suspended by main thread
+            if (reg.isTriggeredOnly() || reg.isSuspended())
+                continue;
+
             auto time_passed = timePoint - reg.mLastRead;
             auto time_to_poll = reg.mRefresh;
 
@@ -34,27 +88,59 @@ ModbusScheduler::getRegistersToPoll(
                 ret[slave->first].push_back(*reg_it);
             } else {
                 time_to_poll = reg.mRefresh - time_passed;
+                if (time_to_poll <= mSlaveAffinityTolerance) {
+                    nearlyDue.push_back(*reg_it);
+                    continue;
+                }
             }
 
-            if (outDuration > time_to_poll) {
-                outDuration = time_to_poll;
-                BOOST_LOG_SEV(log, Log::trace) << "Wait duration set to " << std::chrono::duration_cast<std::chrono::milliseconds>(time_to_poll).count()
-                                << "ms as next poll for register " << slave->first << "." << reg.mRegister << " (0x" << std::hex << slave->first << ".0x" << std::hex << reg.mRegister << ")";
+            if (slaveDuration > time_to_poll)
+                slaveDuration = time_to_poll;
+        }
+
+        std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>::iterator due = ret.find(slave->first);
+        // a single slave switch is saved for all pulled registers
+        auto slaveSilenceSaved = std::chrono::steady_clock::duration::zero();
+        for(const std::shared_ptr<RegisterPoll>& reg: nearlyDue) {
+            auto time_to_poll = reg->mRefresh - (timePoint - reg->mLastRead);
+            if (due != ret.end()) {
+                // poll it now to avoid another switch to this slave
+                // in a moment
+                BOOST_LOG_SEV(log, Log::trace) << "Register " << slave->first << "." << reg->mRegister
+                                << " pulled forward by " << std::chrono::duration_cast<std::chrono::milliseconds>(time_to_poll).count() << "ms";
+                due->second.push_back(reg);
+                slaveSilenceSaved = std::max(slaveSilenceSaved, reg->getDelayBeforeFirstCommand());
+                pulledCount++;
+                time_to_poll = reg->mRefresh;
             }
+            if (slaveDuration > time_to_poll)
+                slaveDuration = time_to_poll;
+        }
+        mLastSilenceSaved += slaveSilenceSaved;
+
+        if (outDuration > slaveDuration) {
+            outDuration = slaveDuration;
+            BOOST_LOG_SEV(log, Log::trace) << "Wait duration set to " << std::chrono::duration_cast<std::chrono::milliseconds>(slaveDuration).count()
+                            << "ms as next poll for slave " << slave->first;
         }
     }
 
+    if (pulledCount != 0) {
+        BOOST_LOG_SEV(log, Log::debug) << pulledCount << " register(s) polled ahead of schedule, "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(mLastSilenceSaved).count() << "ms of silence saved";
+    }
+
     return ret;
 }
 
 std::shared_ptr<RegisterPoll>
-ModbusScheduler::findRegisterPoll(const MsgRegisterValues& pValues) const {
+ModbusScheduler::findRegisterPoll(const ModbusSlaveAddressRange& pRange) const {
 
-    std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>::const_iterator slave = mRegisterMap.find(pValues.mSlaveId);
+    std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>::const_iterator slave = mRegisterMap.find(pRange.mSlaveId);
     if (slave != mRegisterMap.end()) {
         std::vector<std::shared_ptr<RegisterPoll>>::const_iterator reg_it = std::find_if(
             slave->second.begin(), slave->second.end(),
-            [&pValues](const std::shared_ptr<RegisterPoll>& item) -> bool { return item->overlaps(pValues); }
+            [&pRange](const std::shared_ptr<RegisterPoll>& item) -> bool { return item->overlaps(pRange); }
         );
         if (reg_it != slave->second.end()) {
             return *reg_it;
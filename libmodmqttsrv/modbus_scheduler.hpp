@@ -13,14 +13,42 @@ namespace modmqttd {
 
     class ModbusScheduler {
         public:
-            void setPollSpecification(const std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>& pRegisterMap) {
-                mRegisterMap = pRegisterMap;
-            }
+            /**
+             * Sets registers to poll and computes phase offsets
+             * for every group of polls with the same refresh period
+             * */
+            void setPollSpecification(const std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>& pRegisterMap);
             const std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>& getPollSpecification() const {
                 return mRegisterMap;
             }
 
-            std::shared_ptr<RegisterPoll> findRegisterPoll(const MsgRegisterValues& pValues) const;
+            /**
+             * Registers that should be polled within pTolerance are
+             * polled together with due registers of the same slave.
+             * This saves delay_before_first_command silence periods
+             * */
+            void setSlaveAffinityTolerance(const std::chrono::steady_clock::duration& pTolerance) {
+                mSlaveAffinityTolerance = pTolerance;
+            }
+            /**
+             * If enabled, then after initial poll polls with the same
+             * refresh period are not due at the same time, but spread
+             * evenly over their period.
+             * */
+            void setPhaseSpreading(bool pFlag) { mPhaseSpreading = pFlag; }
+            bool isPhaseSpreading() const { return mPhaseSpreading; }
+
+            /**
+             * Shifts first scheduled poll of every register
+             * by its phase offset counting from pStart.
+             * Called when initial poll is done.
+             * */
+            void applyPhaseOffsets(const std::chrono::steady_clock::time_point& pStart);
+
+            // silence time saved by the last getRegistersToPoll call
+            const std::chrono::steady_clock::duration& getLastSilenceSaved() const { return mLastSilenceSaved; }
+
+            std::shared_ptr<RegisterPoll> findRegisterPoll(const ModbusSlaveAddressRange& pRange) const;
             /**
              * Returns map of devices with list of registers, that
              * should be polled now.
@@ -35,6 +63,9 @@ namespace modmqttd {
             );
         private:
             std::map<int, std::vector<std::shared_ptr<RegisterPoll>>> mRegisterMap;
+            std::chrono::steady_clock::duration mSlaveAffinityTolerance = std::chrono::steady_clock::duration::zero();
+            std::chrono::steady_clock::duration mLastSilenceSaved = std::chrono::steady_clock::duration::zero();
+            bool mPhaseSpreading = false;
             static  boost::log::sources::severity_logger<Log::severity> log;
     };
 }
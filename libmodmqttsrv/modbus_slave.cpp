@@ -33,6 +33,14 @@ ModbusSlaveConfig::ModbusSlaveConfig(int pAddress, const YAML::Node& data)
 
     ConfigTools::readOptionalValue<unsigned short>(mMaxWriteRetryCount, data, "write_retries");
     ConfigTools::readOptionalValue<unsigned short>(mMaxReadRetryCount, data, "read_retries");
+
+    YAML::Node weightNode(ConfigTools::setOptionalValueFromNode<unsigned short>(mWeight, data, "weight"));
+    if (weightNode.IsDefined() && mWeight == 0)
+        throw ConfigurationException(weightNode.Mark(), "slave weight must be greater than zero");
+
+    YAML::Node gapNode(ConfigTools::setOptionalValueFromNode<int>(mMaxReadGap, data, "max_read_gap"));
+    if (gapNode.IsDefined() && mMaxReadGap < 0)
+        throw ConfigurationException(gapNode.Mark(), "max_read_gap cannot be negative");
 }
 
 }
@@ -28,6 +28,11 @@ class ModbusSlaveConfig {
 
         unsigned short mMaxWriteRetryCount = 0;
         unsigned short mMaxReadRetryCount = 0;
+        // share of bus time compared to other slaves
+        unsigned short mWeight = 1;
+        // max number of unused registers between polls read
+        // with a single command, -1 disables coalescing
+        int mMaxReadGap = -1;
     private:
         std::shared_ptr<std::chrono::milliseconds> mDelayBeforeCommand;
         std::shared_ptr<std::chrono::milliseconds> mDelayBeforeFirstCommand;
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+
 #include "modbus_thread.hpp"
 
 #include "debugtools.hpp"
@@ -8,6 +11,11 @@
 
 namespace modmqttd {
 
+#if __cplusplus < 201703L
+constexpr std::chrono::seconds ModbusThread::BUS_LOAD_LOG_PERIOD;
+constexpr double ModbusThread::BUS_LOAD_WARN_LEVEL;
+#endif
+
 void
 setCommandDelays(RegisterCommand& cmd, const std::shared_ptr<const std::chrono::milliseconds>& everyTime, const std::shared_ptr<const std::chrono::milliseconds>& onChange) {
     if (everyTime != nullptr)
@@ -56,18 +64,50 @@ ModbusThread::configure(const ModbusNetworkConfig& config) {
 
     mMaxReadRetryCount = config.mMaxReadRetryCount;
     mMaxWriteRetryCount = config.mMaxWriteRetryCount;
+
+    if (config.mRequeueRetries) {
+        mExecutor.setRetryBackoff(config.mRetryBackoff);
+        BOOST_LOG_SEV(log, Log::info) << "Failed commands will be retried after "
+            << config.mRetryBackoff.count() << "ms backoff";
+    }
+
+    mScheduler.setSlaveAffinityTolerance(config.mSlaveAffinityTolerance);
+    if (config.mSlaveAffinityTolerance != std::chrono::milliseconds::zero()) {
+        BOOST_LOG_SEV(log, Log::info) << "Registers due in "
+            << config.mSlaveAffinityTolerance.count() << "ms will be polled with current slave";
+    }
+
+    mScheduler.setPhaseSpreading(config.mSpreadPolls);
+
+    mReconnectResumePeriod = config.mReconnectResumePeriod;
 }
 
 void
 ModbusThread::setPollSpecification(const MsgRegisterPollSpecification& spec) {
     std::map<int, std::vector<std::shared_ptr<RegisterPoll>>> registerMap;
+    std::vector<std::pair<std::shared_ptr<RegisterPoll>, const MsgRegisterPoll*>> dependentPolls;
     for(std::vector<MsgRegisterPoll>::const_iterator it = spec.mRegisters.begin();
         it != spec.mRegisters.end(); it++)
     {
         // do not poll a poll group declared in modbus config section
         // that was not merged with any mqtt register declaration
-        if (it->mRefreshMsec != MsgRegisterPoll::INVALID_REFRESH) {
+        if (it->mRefreshMsec != MsgRegisterPoll::INVALID_REFRESH || !it->mTriggers.empty()) {
             std::shared_ptr<RegisterPoll> reg(new RegisterPoll(it->mSlaveId, it->mRegister, it->mRegisterType, it->mCount, it->mRefreshMsec, it->mPublishMode));
+            reg->mPriority = it->mPriority;
+            if (it->mRefreshMsec == MsgRegisterPoll::INVALID_REFRESH)
+                reg->setTriggeredOnly();
+            else if (it->isAdaptive())
+                reg->setRefreshRange(it->mRefreshMsec, it->mMaxRefreshMsec);
+            if (!it->mTriggers.empty())
+                dependentPolls.push_back(std::make_pair(reg, &(*it)));
+            // register used also without deadband must be always published
+            for(const RegisterDeadband& deadband: it->mDeadbands) {
+                if (std::none_of(it->mUnfilteredRanges.begin(), it->mUnfilteredRanges.end(),
+                    [&deadband](const ModbusAddressRange& r) -> bool { return r.overlaps(deadband); }))
+                {
+                    reg->addDeadband(deadband);
+                }
+            }
             std::map<int, ModbusSlaveConfig>::const_iterator slave_cfg = mSlaves.find(reg->mSlaveId);
 
             setCommandDelays(*reg, mDelayBeforeCommand, mDelayBeforeFirstCommand);
@@ -83,6 +123,19 @@ ModbusThread::setPollSpecification(const MsgRegisterPollSpecification& spec) {
     }
 
     mScheduler.setPollSpecification(registerMap);
+
+    for(auto& dep: dependentPolls) {
+        for(const ModbusSlaveAddressRange& trigger: dep.second->mTriggers) {
+            std::shared_ptr<RegisterPoll> triggerPoll(mScheduler.findRegisterPoll(trigger));
+            if (triggerPoll == nullptr) {
+                BOOST_LOG_SEV(log, Log::warn) << mNetworkName << ", register " << trigger.mSlaveId << "." << trigger.mRegister
+                    << " is not polled, cannot trigger poll of register " << dep.first->mSlaveId << "." << dep.first->mRegister;
+            } else if (triggerPoll != dep.first) {
+                triggerPoll->addDependentPoll(trigger, dep.first);
+            }
+        }
+    }
+
     BOOST_LOG_SEV(log, Log::debug) << "Poll specification set, got " << registerMap.size() << " slaves," << spec.mRegisters.size() << " registers to poll:";
     for (auto sit = registerMap.begin(); sit != registerMap.end(); sit++) {
         for (auto it = sit->second.begin(); it != sit->second.end(); it++) {
@@ -92,8 +145,10 @@ ModbusThread::setPollSpecification(const MsgRegisterPollSpecification& spec) {
             << ", slave " << sit->first
             << ", register " << (*it)->mRegister << ":" << (*it)->mRegisterType
             << ", count=" << (*it)->getCount()
-            << ", poll every " << std::chrono::duration_cast<std::chrono::milliseconds>((*it)->mRefresh).count() << "ms"
+            << ((*it)->isTriggeredOnly() ? ", poll on change only" : ", poll every " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>((*it)->mRefresh).count()) + "ms")
+            << ((*it)->isAdaptive() ? ", adaptive up to " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>((*it)->getMaxRefresh()).count()) + "ms" : "")
             << ", queue " << ((*it)->mPublishMode == PublishMode::ON_CHANGE ? "on change" : "always")
+            << ", priority " << (*it)->mPriority
             << ", min f_delay " << std::chrono::duration_cast<std::chrono::milliseconds>((*it)->getDelayBeforeFirstCommand()).count() << "ms"
             << ", min delay " << std::chrono::duration_cast<std::chrono::milliseconds>((*it)->getDelayBeforeCommand()).count() << "ms";
         }
@@ -121,6 +176,50 @@ ModbusThread::processWrite(const std::shared_ptr<MsgRegisterValues>& msg) {
     mExecutor.addWriteCommand(cmd);
 }
 
+void
+ModbusThread::suspendRegisterPoll(const MsgRegisterPollSuspend& msg) {
+    std::shared_ptr<RegisterPoll> reg(mScheduler.findRegisterPoll(msg));
+    if (reg == nullptr) {
+        BOOST_LOG_SEV(log, Log::error) << "Cannot find register " << msg.mSlaveId << "." << msg.mRegister << " to suspend";
+        return;
+    }
+    BOOST_LOG_SEV(log, Log::debug) << (msg.mSuspend ? "Suspending" : "Resuming") << " poll for register "
+        << reg->mSlaveId << "." << reg->mRegister << ", count=" << reg->getCount();
+    reg->setSuspended(msg.mSuspend);
+}
+
+void
+ModbusThread::logBusLoad(const std::chrono::steady_clock::time_point& now) {
+    auto busy = mExecutor.popBusyTime();
+    double load = std::chrono::duration<double>(busy) / (now - mBusLoadPeriodStart);
+    mBusLoadPeriodStart = now;
+
+    int percent = std::lround(load * 100);
+    if (load > BUS_LOAD_WARN_LEVEL) {
+        BOOST_LOG_SEV(log, Log::warn) << "Network " << mNetworkName << " bus utilisation " << percent << "%"
+            << ", consider increasing refresh times";
+    } else {
+        BOOST_LOG_SEV(log, Log::debug) << "Network " << mNetworkName << " bus utilisation " << percent << "%";
+    }
+}
+
+void
+ModbusThread::logDeadlineStats() {
+    for(const auto& slave: mScheduler.getPollSpecification()) {
+        for(const std::shared_ptr<RegisterPoll>& reg: slave.second) {
+            RegisterPoll::DeadlineStats stats(reg->popDeadlineStats());
+            if (stats.mMissedCount == 0)
+                continue;
+            BOOST_LOG_SEV(log, Log::warn) << "Register " << reg->mSlaveId << "." << reg->mRegister
+                << " (count=" << reg->getCount()
+                << ", refresh=" << std::chrono::duration_cast<std::chrono::milliseconds>(reg->getMinRefresh()).count() << "ms)"
+                << " missed " << stats.mMissedCount << " of " << stats.mPollCount << " deadlines"
+                << ", max lateness " << std::chrono::duration_cast<std::chrono::milliseconds>(stats.mMaxLateness).count() << "ms"
+                << ", avg lateness " << std::chrono::duration_cast<std::chrono::milliseconds>(stats.mTotalLateness / stats.mPollCount).count() << "ms";
+        }
+    }
+}
+
 void
 ModbusThread::dispatchMessages(const QueueItem& read) {
     QueueItem item(read);
@@ -139,6 +238,8 @@ ModbusThread::dispatchMessages(const QueueItem& read) {
         } else if (item.isSameAs(typeid(MsgMqttNetworkState))) {
             std::unique_ptr<MsgMqttNetworkState> netstate(item.getData<MsgMqttNetworkState>());
             mMqttConnected = netstate->mIsUp;
+        } else if (item.isSameAs(typeid(MsgRegisterPollSuspend))) {
+            suspendRegisterPoll(*item.getData<MsgRegisterPollSuspend>());
         } else if (item.isSameAs(typeid(ModbusSlaveConfig))) {
             //no per-slave config attributes defined yet
             updateFromSlaveConfig(*item.getData<ModbusSlaveConfig>());
@@ -161,6 +262,12 @@ ModbusThread::updateFromSlaveConfig(const ModbusSlaveConfig& pConfig) {
         result.first->second = pConfig;
     }
 
+    mExecutor.setSlaveWeight(pConfig.mAddress, pConfig.mWeight);
+    if (pConfig.mWeight != 1) {
+        BOOST_LOG_SEV(log, Log::info) << mNetworkName << ", slave " << pConfig.mAddress << " bus time weight set to " << pConfig.mWeight;
+    }
+    mExecutor.setSlaveMaxReadGap(pConfig.mAddress, pConfig.mMaxReadGap);
+
     auto& registers = mScheduler.getPollSpecification();
     std::map<int, std::vector<std::shared_ptr<RegisterPoll>>>::const_iterator slave_registers = registers.find(pConfig.mAddress);
     if (slave_registers != registers.end()) {
@@ -207,8 +314,16 @@ ModbusThread::run() {
                         sendMessage(QueueItem::create(MsgModbusNetworkState(mNetworkName, true)));
                         // if modbus network was disconnected
                         // we need to refresh everything
+                        // unless it was down for a short time, then registers
+                        // that became stale are polled according to their deadlines
                         if (!mExecutor.isInitialPollInProgress()) {
-                            mExecutor.setupInitialPoll(mScheduler.getPollSpecification());
+                            auto downtime = std::chrono::steady_clock::now() - mConnectionLostTime;
+                            if (downtime < mReconnectResumePeriod) {
+                                BOOST_LOG_SEV(log, Log::info) << "modbus: connection restored after "
+                                    << std::chrono::duration_cast<std::chrono::milliseconds>(downtime).count() << "ms, resuming polling";
+                            } else {
+                                mExecutor.setupInitialPoll(mScheduler.getPollSpecification());
+                            }
                         }
                     }
                 }
@@ -221,6 +336,11 @@ ModbusThread::run() {
                     if (mMqttConnected) {
 
                         auto now = std::chrono::steady_clock::now();
+                        if (now - mBusLoadPeriodStart >= BUS_LOAD_LOG_PERIOD) {
+                            logBusLoad(now);
+                            logDeadlineStats();
+                        }
+
                         if (!mExecutor.isInitialPollInProgress() && nextPollTimePoint < now) {
                             std::chrono::steady_clock::duration schedulerWaitDuration;
                             std::map<int, std::vector<std::shared_ptr<RegisterPoll>>> regsToPoll = mScheduler.getRegistersToPoll(schedulerWaitDuration, now);
@@ -233,10 +353,20 @@ ModbusThread::run() {
                         if (mExecutor.allDone()) {
                             idleWaitDuration = (nextPollTimePoint - now);
                         } else {
+                            bool initialPoll = mExecutor.isInitialPollInProgress();
                             idleWaitDuration = mExecutor.executeNext();
+                            if (initialPoll && !mExecutor.isInitialPollInProgress())
+                                mScheduler.applyPhaseOffsets(std::chrono::steady_clock::now());
                             if (idleWaitDuration == std::chrono::steady_clock::duration::zero()) {
                                 mWatchdog.inspectCommand(*mExecutor.getLastCommand());
                             }
+                            // executor can wait for delayed retries longer
+                            // than next scheduled poll, do not miss it
+                            if (!mExecutor.isInitialPollInProgress()) {
+                                auto nextPollWait = nextPollTimePoint - std::chrono::steady_clock::now();
+                                if (nextPollWait < idleWaitDuration)
+                                    idleWaitDuration = std::max(nextPollWait, std::chrono::steady_clock::duration::zero());
+                            }
                         }
                     } else {
                         if (!mMqttConnected)
@@ -265,6 +395,7 @@ ModbusThread::run() {
                             << std::chrono::duration_cast<std::chrono::seconds>(mWatchdog.getCurrentErrorPeriod()).count() << "s"
                             << ", reconnecting";
                     }
+                    mConnectionLostTime = mWatchdog.getLastSuccessfulCommandTime();
                     mWatchdog.reset();
                     mModbus->disconnect();
                     sendMessage(QueueItem::create(MsgModbusNetworkState(mNetworkName, false)));
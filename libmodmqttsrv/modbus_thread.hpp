@@ -22,6 +22,10 @@ class ModbusThread {
             moodycamel::BlockingReaderWriterQueue<QueueItem>& fromModbusQueue);
         void run();
     private:
+        // how often measured bus utilisation and missed deadlines are logged
+        static constexpr std::chrono::seconds BUS_LOAD_LOG_PERIOD = std::chrono::seconds(60);
+        static constexpr double BUS_LOAD_WARN_LEVEL = 0.9;
+
         boost::log::sources::severity_logger<Log::severity> log;
         moodycamel::BlockingReaderWriterQueue<QueueItem>& mToModbusQueue;
         moodycamel::BlockingReaderWriterQueue<QueueItem>& mFromModbusQueue;
@@ -46,6 +50,14 @@ class ModbusThread {
         ModbusExecutor mExecutor;
         ModbusWatchdog mWatchdog;
 
+        std::chrono::steady_clock::time_point mBusLoadPeriodStart = std::chrono::steady_clock::now();
+
+        // if connection is restored within this period
+        // polling is resumed without initial poll
+        std::chrono::steady_clock::duration mReconnectResumePeriod = std::chrono::steady_clock::duration::zero();
+        // some random past value, not using steady_clock:min() due to overflow
+        std::chrono::steady_clock::time_point mConnectionLostTime = std::chrono::steady_clock::now() - std::chrono::hours(100000);
+
         void configure(const ModbusNetworkConfig& config);
         void setPollSpecification(const MsgRegisterPollSpecification& spec);
         void updateFromSlaveConfig(const ModbusSlaveConfig& pSlaveConfig);
@@ -54,6 +66,9 @@ class ModbusThread {
         void sendMessage(const QueueItem& item);
 
         void processWrite(const std::shared_ptr<MsgRegisterValues>& msg);
+        void suspendRegisterPoll(const MsgRegisterPollSuspend& msg);
+        void logBusLoad(const std::chrono::steady_clock::time_point& now);
+        void logDeadlineStats();
 
         void processCommands();
 };
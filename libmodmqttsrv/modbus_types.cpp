@@ -1,10 +1,22 @@
 
 #include "modbus_types.hpp"
 
+#include <cstdlib>
+
 namespace modmqttd {
 
 boost::log::sources::severity_logger<Log::severity> ModbusAddressRange::log;
 
+std::ostream&
+operator<<(std::ostream& os, CommandPriority pPriority) {
+    switch(pPriority) {
+        case CommandPriority::LOW: os << "low"; break;
+        case CommandPriority::NORMAL: os << "normal"; break;
+        case CommandPriority::HIGH: os << "high"; break;
+    }
+    return os;
+}
+
 bool
 ModbusAddressRange::overlaps(const ModbusAddressRange& poll) const {
     if (mRegisterType != poll.mRegisterType)
@@ -41,4 +53,13 @@ ModbusAddressRange::isSameAs(const ModbusAddressRange& other) const {
     return mRegister == other.mRegister && mCount == other.mCount;
 }
 
+bool
+RegisterDeadband::isWithin(uint16_t pOld, uint16_t pNew) const {
+    // deadband is used only for unconverted registers,
+    // published as unsigned values
+    int diff = std::abs(int(pNew) - int(pOld));
+    double threshold = mPercent ? mThreshold * pOld / 100.0 : mThreshold;
+    return diff <= threshold;
+}
+
 }
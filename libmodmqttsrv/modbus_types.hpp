@@ -1,6 +1,8 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include <ostream>
 
 #include "logging.hpp"
 
@@ -13,6 +15,19 @@ enum RegisterType {
     INPUT = 4
 };
 
+/**
+ * Commands with higher priority are executed first.
+ * Low priority polls waiting longer than their refresh period
+ * are promoted to avoid starvation.
+ */
+enum class CommandPriority {
+    LOW = 0,
+    NORMAL = 1,
+    HIGH = 2
+};
+
+std::ostream& operator<<(std::ostream& os, CommandPriority pPriority);
+
 class ModbusAddressRange {
     protected:
         static boost::log::sources::severity_logger<Log::severity> log;
@@ -44,4 +59,25 @@ class ModbusSlaveAddressRange : public ModbusAddressRange {
         int mSlaveId;
 };
 
+/**
+ * Changes of register values in range not greater than mThreshold
+ * (or mThreshold percent of the last sent value) are not sent
+ * to main thread, unless mKeepalive passed since last send.
+ */
+class RegisterDeadband : public ModbusAddressRange {
+    public:
+        RegisterDeadband(const ModbusAddressRange& pRange, double pThreshold, bool pPercent)
+            : ModbusAddressRange(pRange),
+              mThreshold(pThreshold),
+              mPercent(pPercent)
+        {}
+
+        bool isWithin(uint16_t pOld, uint16_t pNew) const;
+
+        double mThreshold;
+        bool mPercent;
+        // zero disables keepalive
+        std::chrono::milliseconds mKeepalive = std::chrono::milliseconds::zero();
+};
+
 }
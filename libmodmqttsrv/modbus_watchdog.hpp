@@ -17,7 +17,7 @@ class ModbusWatchdog {
         bool isReconnectRequired() const;
         bool isDeviceRemoved() const { return mDeviceRemoved; }
         const std::string& getDevicePath() const { return mConfig.mDevicePath; }
-        std::chrono::steady_clock::time_point getLastSuccessfulCommandTime() const;
+        const std::chrono::steady_clock::time_point& getLastSuccessfulCommandTime() const { return mLastSuccessfulCommandTime; }
         std::chrono::steady_clock::duration getCurrentErrorPeriod() const {
             return std::chrono::steady_clock::now() - mLastSuccessfulCommandTime;
         }
@@ -1,5 +1,9 @@
 #include <string>
 #include <regex>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
 #include <yaml-cpp/yaml.h>
 #include <boost/dll/import.hpp>
 #include <boost/algorithm/string.hpp>
@@ -119,6 +123,231 @@ parsePublishMode(const YAML::Node& data, PublishMode pDefault = PublishMode::ON_
     throw ConfigurationException(data.Mark(), std::string("Invalid publish mode '") + pmode + "', valid values are: on_change, every_poll");
 }
 
+PayloadFormat
+parsePayloadFormat(const YAML::Node& data, PayloadFormat pDefault = PayloadFormat::JSON) {
+    std::string format;
+    if (!ConfigTools::readOptionalValue<std::string>(format, data, "payload_format"))
+        return pDefault;
+
+    if (format == "json") {
+        return PayloadFormat::JSON;
+    } else if (format == "cbor") {
+        return PayloadFormat::CBOR;
+    } else if (format == "msgpack") {
+        return PayloadFormat::MSGPACK;
+    }
+
+    throw ConfigurationException(data["payload_format"].Mark(), std::string("Invalid payload format '") + format + "', valid values are: json, cbor, msgpack");
+}
+
+CommandPriority
+parsePriority(const YAML::Node& data, CommandPriority pDefault = CommandPriority::NORMAL) {
+    std::string priority;
+    if (!ConfigTools::readOptionalValue<std::string>(priority, data, "priority"))
+        return pDefault;
+
+    if (priority == "low") {
+        return CommandPriority::LOW;
+    } else if (priority == "normal") {
+        return CommandPriority::NORMAL;
+    } else if (priority == "high") {
+        return CommandPriority::HIGH;
+    }
+
+    throw ConfigurationException(data["priority"].Mark(), std::string("Invalid priority '") + priority + "', valid values are: low, normal, high");
+}
+
+int
+parseQos(const YAML::Node& data) {
+    int qos = 0;
+    if (ConfigTools::readOptionalValue<int>(qos, data, "qos") && (qos < 0 || qos > 2))
+        throw ConfigurationException(data["qos"].Mark(), "Invalid qos " + std::to_string(qos) + ", valid values are: 0, 1, 2");
+    return qos;
+}
+
+/*!
+    Parse aggregate: {window: timespan, functions: [min, max, avg, last]}
+*/
+std::shared_ptr<MqttAggregate>
+parseAggregate(const YAML::Node& node) {
+    if (!node.IsMap())
+        throw ConfigurationException(node.Mark(), "aggregate must be a map with window and functions");
+
+    std::chrono::milliseconds window(ConfigTools::readRequiredValue<std::chrono::milliseconds>(node, "window"));
+    if (window <= std::chrono::milliseconds::zero())
+        throw ConfigurationException(node["window"].Mark(), "aggregate window must be greater than zero");
+
+    std::vector<MqttAggregate::Function> functions;
+    const YAML::Node& yFunctions = node["functions"];
+    if (!yFunctions.IsDefined()) {
+        functions = { MqttAggregate::Function::MIN, MqttAggregate::Function::MAX, MqttAggregate::Function::AVG };
+    } else {
+        if (!yFunctions.IsSequence() || yFunctions.size() == 0)
+            throw ConfigurationException(yFunctions.Mark(), "aggregate functions must be a non empty list");
+        for(size_t i = 0; i < yFunctions.size(); i++) {
+            std::string name(ConfigTools::readRequiredValue<std::string>(yFunctions[i]));
+            if (name == "min") {
+                functions.push_back(MqttAggregate::Function::MIN);
+            } else if (name == "max") {
+                functions.push_back(MqttAggregate::Function::MAX);
+            } else if (name == "avg") {
+                functions.push_back(MqttAggregate::Function::AVG);
+            } else if (name == "last") {
+                functions.push_back(MqttAggregate::Function::LAST);
+            } else {
+                throw ConfigurationException(yFunctions[i].Mark(), std::string("Invalid aggregate function '") + name + "', valid values are: min, max, avg, last");
+            }
+        }
+    }
+
+    return std::shared_ptr<MqttAggregate>(new MqttAggregate(window, functions));
+}
+
+/*!
+    Parse deadband value, a number or
+    a percent of the last published value like "2%"
+*/
+void
+parseDeadbandThreshold(const YAML::Node& node, double& pThreshold, bool& pPercent) {
+    if (!node.IsScalar())
+        throw ConfigurationException(node.Mark(), "deadband must be a number or a percent value");
+
+    std::string str(node.as<std::string>());
+    bool percent = !str.empty() && str.back() == '%';
+    if (percent)
+        str.pop_back();
+
+    double threshold;
+    try {
+        size_t pos;
+        threshold = std::stod(str, &pos);
+        if (pos != str.size())
+            throw std::invalid_argument(str);
+    } catch (const std::logic_error&) {
+        throw ConfigurationException(node.Mark(), std::string("Invalid deadband '") + node.as<std::string>() + "', use a number or a percent value like 2%");
+    }
+
+    if (threshold < 0)
+        throw ConfigurationException(node.Mark(), "deadband cannot be negative");
+
+    pThreshold = threshold;
+    pPercent = percent;
+}
+
+RegisterDeadband
+parseDeadband(const YAML::Node& node, const ModbusAddressRange& pRange) {
+    double threshold;
+    bool percent;
+    parseDeadbandThreshold(node, threshold, percent);
+    return RegisterDeadband(pRange, threshold, percent);
+}
+
+/*!
+    Parse deadband of a converted value
+    with optional deadband_keepalive
+*/
+std::shared_ptr<MqttValueDeadband>
+parseValueDeadband(const YAML::Node& data) {
+    double threshold;
+    bool percent;
+    parseDeadbandThreshold(data["deadband"], threshold, percent);
+    std::shared_ptr<MqttValueDeadband> ret(new MqttValueDeadband(threshold, percent));
+    ConfigTools::readOptionalValue<std::chrono::milliseconds>(ret->mKeepalive, data, "deadband_keepalive");
+    return ret;
+}
+
+/*!
+    Deadband of converted value is evaluated by MqttObject
+    only for values published at the top level of state
+*/
+bool
+hasNestedDeadband(const MqttObjectDataNode& pNode) {
+    for(const MqttObjectDataNode& child: pNode.getChildNodes()) {
+        if (child.getDeadband() != nullptr || hasNestedDeadband(child))
+            return true;
+    }
+    return false;
+}
+
+/*!
+    Read refresh value, either a single timespan or a {min, max}
+    map for adaptive refresh. pMaxRefresh is set to INVALID_REFRESH
+    for fixed refresh.
+*/
+bool
+parseRefresh(std::chrono::milliseconds& pRefresh, std::chrono::milliseconds& pMaxRefresh, const YAML::Node& data) {
+    const YAML::Node& refresh = data["refresh"];
+    if (!refresh.IsDefined())
+        return false;
+
+    if (!refresh.IsMap()) {
+        pRefresh = ConfigTools::readRequiredValue<std::chrono::milliseconds>(refresh);
+        pMaxRefresh = MsgRegisterPoll::INVALID_REFRESH;
+        return true;
+    }
+
+    std::chrono::milliseconds minRefresh = ConfigTools::readRequiredValue<std::chrono::milliseconds>(refresh, "min");
+    std::chrono::milliseconds maxRefresh = ConfigTools::readRequiredValue<std::chrono::milliseconds>(refresh, "max");
+
+    if (minRefresh <= std::chrono::milliseconds::zero())
+        throw ConfigurationException(refresh.Mark(), "refresh min must be greater than zero");
+    if (maxRefresh < minRefresh)
+        throw ConfigurationException(refresh.Mark(), "refresh max cannot be lower than min");
+
+    pRefresh = minRefresh;
+    pMaxRefresh = maxRefresh == minRefresh ? MsgRegisterPoll::INVALID_REFRESH : maxRefresh;
+    return true;
+}
+
+/*!
+    Read default refresh for all registers from mqtt section
+*/
+void
+parseDefaultRefresh(std::chrono::milliseconds& pRefresh, std::chrono::milliseconds& pMaxRefresh, const YAML::Node& config) {
+    pRefresh = std::chrono::milliseconds(5000);
+    pMaxRefresh = MsgRegisterPoll::INVALID_REFRESH;
+
+    const YAML::Node& mqtt = config["mqtt"];
+    if (mqtt.IsDefined())
+        parseRefresh(pRefresh, pMaxRefresh, mqtt);
+}
+
+/*!
+    Parse poll_on_change_of node and return poll for trigger register.
+    Trigger register must be on the same network as dependent register,
+    slave id defaults to dependent register slave.
+*/
+MsgRegisterPoll
+parseTriggerPoll(
+    const YAML::Node& pNode,
+    const std::string& pNetwork,
+    int pSlaveId,
+    std::chrono::milliseconds pRefresh,
+    std::chrono::milliseconds pMaxRefresh
+) {
+    YAML::Node trigger;
+    if (pNode.IsScalar()) {
+        trigger["register"] = pNode;
+    } else if (pNode.IsMap()) {
+        trigger = pNode;
+    } else {
+        throw ConfigurationException(pNode.Mark(), "poll_on_change_of must be a register name or a map with register definition");
+    }
+
+    RegisterConfigName name(trigger, pNetwork, pSlaveId);
+    if (name.mNetworkName != pNetwork)
+        throw ConfigurationException(pNode.Mark(), "poll_on_change_of register must be on the same network as polled register");
+
+    int count = 1;
+    ConfigTools::readOptionalValue<int>(count, trigger, "count");
+    parseRefresh(pRefresh, pMaxRefresh, trigger);
+
+    MsgRegisterPoll ret(name.mSlaveId, name.mRegisterNumber, parseRegisterType(trigger), count);
+    ret.mRefreshMsec = pRefresh;
+    ret.mMaxRefreshMsec = pMaxRefresh;
+    return ret;
+}
+
 MqttObjectCommand::PayloadType
 parsePayloadType(const YAML::Node& data) {
     //for future support for int and float mqtt command payload types
@@ -184,6 +413,8 @@ ModMqtt::init(const YAML::Node& config) {
             }
         }
 
+        checkBusLoad(*sit, modbusData);
+
         std::vector<std::shared_ptr<ModbusClient>>::iterator client = std::find_if(
             mModbusClients.begin(), mModbusClients.end(),
             [&netname](const std::shared_ptr<ModbusClient>& client) -> bool { return client->mNetworkName == netname; }
@@ -200,6 +431,13 @@ ModMqtt::init(const YAML::Node& config) {
     MqttClient::MqttPollObjMap mappedPollObjects;
     MqttClient::MqttCmdObjMap mappedCommandObjects;
 
+    // registers polled only as poll_on_change_of triggers
+    // are not used by any object
+    for(const MsgRegisterPollSpecification& spec: modbusData.mPollSpecification) {
+        for(const MsgRegisterPoll& poll: spec.mRegisters)
+            mappedPollObjects[MqttObjectRegisterIdent(spec.mNetworkName, poll)];
+    }
+
     for(const MqttObject& obj : objects) {
         auto optr = std::shared_ptr<MqttObject>(new MqttObject(obj));
         for(std::vector<MsgRegisterPollSpecification>::const_iterator sit = modbusData.mPollSpecification.begin();
@@ -222,10 +460,64 @@ ModMqtt::init(const YAML::Node& config) {
         }
     }
 
+    // state polls that could be suspended when all objects using them
+    // are not available. Poll group with availability register
+    // must be polled all the time.
+    for(const MsgRegisterPollSpecification& spec: modbusData.mPollSpecification) {
+        for(const MsgRegisterPoll& poll: spec.mRegisters) {
+            const std::vector<std::shared_ptr<MqttObject>>& pollObjects(mappedPollObjects[MqttObjectRegisterIdent(spec.mNetworkName, poll)]);
+            if (pollObjects.empty())
+                continue;
+            bool gated = std::all_of(
+                pollObjects.begin(), pollObjects.end(),
+                [&spec, &poll](const std::shared_ptr<MqttObject>& obj) -> bool {
+                    return obj->getSkipStatePoll() && !obj->hasAvailabilityRegisterIn(spec.mNetworkName, poll);
+                }
+            );
+            if (gated)
+                mMqtt->addGatedPoll(spec.mNetworkName, poll, pollObjects);
+        }
+    }
+
     mMqtt->setObjects(mappedPollObjects);
     mMqtt->setCommandObjects(mappedCommandObjects);
 }
 
+void
+ModMqtt::checkBusLoad(MsgRegisterPollSpecification& spec, const ModbusInitData& modbusData) const {
+    auto bit = modbusData.mBusLoad.find(spec.mNetworkName);
+    if (bit == modbusData.mBusLoad.end())
+        return;
+
+    const BusLoadEstimator& busLoad(bit->second);
+    double load = busLoad.getUtilisation(spec);
+    BOOST_LOG_SEV(log, Log::info) << "Network " << spec.mNetworkName << ": "
+        << "estimated bus load " << std::lround(load * 100) << "%";
+
+    if (load <= 1.0)
+        return;
+
+    switch(busLoad.getOverloadAction()) {
+        case ModbusNetworkConfig::BusOverloadAction::FAIL:
+            throw ConfigurationException(modbusData.mNetworkMarks.at(spec.mNetworkName),
+                "Network " + spec.mNetworkName + " cannot poll registers with configured refresh rates: " + busLoad.getReport(spec));
+        case ModbusNetworkConfig::BusOverloadAction::STRETCH:
+            // scale all refresh times to fit in line capacity
+            for(MsgRegisterPoll& poll: spec.mRegisters) {
+                if (poll.mRefreshMsec > std::chrono::milliseconds::zero())
+                    poll.mRefreshMsec = std::chrono::milliseconds(std::lround(std::ceil(poll.mRefreshMsec.count() * load)));
+                if (poll.isAdaptive())
+                    poll.mMaxRefreshMsec = std::chrono::milliseconds(std::lround(std::ceil(poll.mMaxRefreshMsec.count() * load)));
+            }
+            BOOST_LOG_SEV(log, Log::warn) << "Network " << spec.mNetworkName << ": " << busLoad.getReport(spec)
+                << " after all refresh times were stretched " << std::setprecision(2) << load << " times";
+            break;
+        default:
+            BOOST_LOG_SEV(log, Log::warn) << "Network " << spec.mNetworkName << " cannot poll registers with configured refresh rates: "
+                << busLoad.getReport(spec);
+    }
+}
+
 void
 ModMqtt::initServer(const YAML::Node& config) {
     const YAML::Node& server = config["modmqttd"];
@@ -322,10 +614,88 @@ void ModMqtt::initBroker(const YAML::Node& config) {
 
     mMqtt->setBrokerConfig(brokerConfig);
     BOOST_LOG_SEV(log, Log::debug) << "Broker configuration initialized";
+
+    int republishRate = MqttClient::DEFAULT_REPUBLISH_RATE;
+    if (ConfigTools::readOptionalValue<int>(republishRate, mqtt, "republish_rate") && republishRate <= 0)
+        throw ConfigurationException(mqtt["republish_rate"].Mark(), "republish_rate must be greater than zero");
+    int republishBurst = MqttClient::DEFAULT_REPUBLISH_BURST;
+    if (ConfigTools::readOptionalValue<int>(republishBurst, mqtt, "republish_burst") && republishBurst <= 0)
+        throw ConfigurationException(mqtt["republish_burst"].Mark(), "republish_burst must be greater than zero");
+    mMqtt->setRepublishRate(republishRate, republishBurst);
+
+    bool publishThread = false;
+    ConfigTools::readOptionalValue<bool>(publishThread, mqtt, "publish_thread");
+    if (publishThread) {
+        mMqtt->enablePublishThread();
+        BOOST_LOG_SEV(log, Log::debug) << "Publish thread started";
+    }
+
+    const YAML::Node& buffer = mqtt["buffer"];
+    if (buffer.IsDefined()) {
+        MqttBufferConfig bufferConfig(buffer);
+        try {
+            mMqtt->setPublishBuffer(std::shared_ptr<PublishBuffer>(new PublishBuffer(bufferConfig.mPath, bufferConfig.mMaxSize)), bufferConfig.mReplayRate);
+        } catch (const PublishBufferException& ex) {
+            throw ConfigurationException(buffer.Mark(), ex.what());
+        }
+        BOOST_LOG_SEV(log, Log::debug) << "Publish buffer " << bufferConfig.mPath << " initialized";
+    }
+}
+
+void
+ModMqtt::parseBulkTopic(
+    const YAML::Node& pData,
+    const std::string& pNetworkName,
+    int pSlaveId,
+    const std::string& pSlaveName,
+    std::chrono::milliseconds pDefaultPeriod
+) {
+    std::string topic;
+    if (!ConfigTools::readOptionalValue<std::string>(topic, pData, "bulk_topic"))
+        return;
+
+    std::chrono::milliseconds period = pDefaultPeriod;
+    if (ConfigTools::readOptionalValue<std::chrono::milliseconds>(period, pData, "bulk_period") && period <= std::chrono::milliseconds::zero())
+        throw ConfigurationException(pData["bulk_period"].Mark(), "bulk_period must be greater than zero");
+
+    const std::string netPhVar("${network}");
+    size_t phPos = topic.find(netPhVar);
+    if (phPos != std::string::npos)
+        topic.replace(phPos, netPhVar.length(), pNetworkName);
+
+    const std::string saPhVar("${slave_address}");
+    phPos = topic.find(saPhVar);
+    if (phPos != std::string::npos) {
+        if (pSlaveId == -1)
+            throw ConfigurationException(pData["bulk_topic"].Mark(), "slave address placeholder cannot be used in network bulk topic " + topic);
+        topic.replace(phPos, saPhVar.length(), std::to_string(pSlaveId));
+    }
+
+    const std::string snPhVar("${slave_name}");
+    phPos = topic.find(snPhVar);
+    if (phPos != std::string::npos) {
+        if (pSlaveName.empty())
+            throw ConfigurationException(pData["bulk_topic"].Mark(), "missing slave name needed for placeholder in bulk topic " + topic);
+        topic.replace(phPos, snPhVar.length(), pSlaveName);
+    }
+
+    for(const std::shared_ptr<MqttBulkTopic>& bulk: mMqtt->getBulkTopics()) {
+        if (bulk->getTopic() == topic)
+            throw ConfigurationException(pData["bulk_topic"].Mark(), "Bulk topic " + topic + " already defined. Missing slave placeholder?");
+    }
+
+    mMqtt->addBulkTopic(std::shared_ptr<MqttBulkTopic>(new MqttBulkTopic(topic, pNetworkName, pSlaveId, period)));
+    BOOST_LOG_SEV(log, Log::debug) << "Bulk topic " << topic << " published every " << period.count() << "ms";
 }
 
 std::vector<modmqttd::MsgRegisterPoll>
-ModMqtt::readModbusPollGroups(const std::string& modbus_network, int default_slave, const YAML::Node& groups) {
+ModMqtt::readModbusPollGroups(
+    const std::string& modbus_network,
+    int default_slave,
+    const YAML::Node& groups,
+    std::chrono::milliseconds pDefaultRefresh,
+    std::chrono::milliseconds pDefaultMaxRefresh)
+{
     std::vector<modmqttd::MsgRegisterPoll> ret;
 
     if (!groups.IsDefined())
@@ -340,9 +710,18 @@ ModMqtt::readModbusPollGroups(const std::string& modbus_network, int default_sla
         int count = ConfigTools::readRequiredValue<int>(group, "count");
 
         MsgRegisterPoll poll(reg.mSlaveId, reg.mRegisterNumber, parseRegisterType(group), count);
+        poll.mPriority = parsePriority(group);
         // we do not set mRefreshMsec here, it should be merged
         // from mqtt overlapping groups
         // if no mqtt groups overlap, then modbus client will drop this poll group
+        // unless it is polled on change of another register
+        const YAML::Node& trigger = group["poll_on_change_of"];
+        if (trigger.IsDefined()) {
+            MsgRegisterPoll triggerPoll(parseTriggerPoll(trigger, modbus_network, reg.mSlaveId, pDefaultRefresh, pDefaultMaxRefresh));
+            triggerPoll.mPriority = poll.mPriority;
+            poll.addTrigger(triggerPoll);
+            ret.push_back(triggerPoll);
+        }
         ret.push_back(poll);
     }
 
@@ -367,6 +746,10 @@ ModMqtt::initModbusClients(const YAML::Node& config) {
 
     ModbusInitData ret;
 
+    // used for poll group trigger registers
+    std::chrono::milliseconds defaultRefresh, defaultMaxRefresh;
+    parseDefaultRefresh(defaultRefresh, defaultMaxRefresh, config);
+
     for(std::size_t i = 0; i < networks.size(); i++) {
         const YAML::Node& network(networks[i]);
         ModbusNetworkConfig modbus_config(network);
@@ -376,6 +759,8 @@ ModMqtt::initModbusClients(const YAML::Node& config) {
         modbus->init(modbus_config);
         mModbusClients.push_back(modbus);
 
+        BusLoadEstimator busLoad(modbus_config);
+
         MsgRegisterPollSpecification spec(modbus_config.mName);
         // send modbus slave configurations
         // for defined slaves
@@ -396,21 +781,30 @@ ModMqtt::initModbusClients(const YAML::Node& config) {
                     for(int addr = addr_range.first; addr <= addr_range.second; addr++) {
                         ModbusSlaveConfig slave_config(addr, ySlave);
                         modbus->mToModbusQueue.enqueue(QueueItem::create(slave_config));
-                        spec.merge(readModbusPollGroups(modbus_config.mName, slave_config.mAddress, ySlave["poll_groups"]));
+                        busLoad.setSlaveConfig(slave_config);
+                        spec.merge(readModbusPollGroups(modbus_config.mName, slave_config.mAddress, ySlave["poll_groups"], defaultRefresh, defaultMaxRefresh));
 
                         if (!slave_config.mSlaveName.empty())
                             ret.mSlaveNames[modbus->mNetworkName][slave_config.mAddress] = slave_config.mSlaveName;
+
+                        parseBulkTopic(ySlave, modbus_config.mName, slave_config.mAddress, slave_config.mSlaveName, defaultRefresh);
                     }
                 }
             }
         }
 
+        parseBulkTopic(network, modbus_config.mName, -1, std::string(), defaultRefresh);
+
         const YAML::Node& old_groups(network["poll_groups"]);
         if (old_groups.IsDefined()) {
             BOOST_LOG_SEV(log, Log::warn) << "'network.poll_groups' are deprecated and will be removed in future releases. Please use 'slaves' section and define per-slave poll_groups instead";
-            spec.merge(readModbusPollGroups(modbus_config.mName, -1, old_groups));
+            spec.merge(readModbusPollGroups(modbus_config.mName, -1, old_groups, defaultRefresh, defaultMaxRefresh));
         }
         ret.mPollSpecification.push_back(spec);
+        if (busLoad.canEstimate()) {
+            ret.mBusLoad.insert(std::make_pair(modbus_config.mName, busLoad));
+            ret.mNetworkMarks[modbus_config.mName] = network.Mark();
+        }
     }
     mMqtt->setModbusClients(mModbusClients);
     BOOST_LOG_SEV(log, Log::debug) << mModbusClients.size() << " modbus client(s) initialized";
@@ -424,7 +818,9 @@ ModMqtt::parseObject(
     int pDefaultSlaveId,
     const std::string& pSlaveName,
     std::chrono::milliseconds pDefaultRefresh,
+    std::chrono::milliseconds pDefaultMaxRefresh,
     PublishMode pDefaultPublishMode,
+    PayloadFormat pDefaultPayloadFormat,
     std::vector<MsgRegisterPollSpecification>& pSpecsOut)
 {
     std::string topic(ConfigTools::readRequiredString(pData, "topic"));
@@ -475,14 +871,33 @@ ModMqtt::parseObject(
     if (ConfigTools::readOptionalValue<bool>(retain, pData, "retain"))
         ret.setRetain(retain);
 
+    ret.setQos(parseQos(pData));
+    ret.setPayloadFormat(parsePayloadFormat(pData, pDefaultPayloadFormat));
+
+    std::chrono::milliseconds minPublishInterval = std::chrono::milliseconds::zero();
+    if (ConfigTools::readOptionalValue<std::chrono::milliseconds>(minPublishInterval, pData, "min_publish_interval")) {
+        if (minPublishInterval < std::chrono::milliseconds::zero())
+            throw ConfigurationException(pData["min_publish_interval"].Mark(), "min_publish_interval cannot be negative");
+        ret.setMinPublishInterval(minPublishInterval);
+    }
+
     std::chrono::milliseconds everyPollRefresh = pDefaultRefresh;
     const YAML::Node& yState = pData["state"];
 
     PublishMode pmode = parsePublishMode(pData, pDefaultPublishMode);
+    CommandPriority priority = parsePriority(pData);
+    ret.setPriority(priority);
+
+    std::shared_ptr<MqttAggregate> aggregate;
 
     if (yState.IsDefined()) {
         if (yState.IsMap()) {
-            MqttObjectDataNode node(parseObjectDataNode(yState, pDefaultNetwork, pDefaultSlaveId, pDefaultRefresh, pmode, everyPollRefresh, pSpecsOut));
+            const YAML::Node& yAggregate = yState["aggregate"];
+            if (yAggregate.IsDefined())
+                aggregate = parseAggregate(yAggregate);
+            // every read is an aggregate sample
+            PublishMode regMode = aggregate == nullptr ? pmode : PublishMode::EVERY_POLL;
+            MqttObjectDataNode node(parseObjectDataNode(yState, pDefaultNetwork, pDefaultSlaveId, pDefaultRefresh, pDefaultMaxRefresh, regMode, priority, everyPollRefresh, pSpecsOut));
             // a map that contains register with optional count
             // should output a list or a scalar value
             // in this case we do not need parsed parent level
@@ -496,7 +911,7 @@ ModMqtt::parseObject(
             bool isUnnamed = false;
             for(size_t i = 0; i < yState.size(); i++) {
                 const YAML::Node& yData = yState[i];
-                MqttObjectDataNode node(parseObjectDataNode(yData, pDefaultNetwork, pDefaultSlaveId, pDefaultRefresh, pmode, everyPollRefresh, pSpecsOut));
+                MqttObjectDataNode node(parseObjectDataNode(yData, pDefaultNetwork, pDefaultSlaveId, pDefaultRefresh, pDefaultMaxRefresh, pmode, priority, everyPollRefresh, pSpecsOut));
                 //the first element defines if we have named or unnamed list
                 if (i == 0)
                     isUnnamed = node.isUnnamed();
@@ -509,6 +924,20 @@ ModMqtt::parseObject(
         } else {
             throw ConfigurationException(yState.Mark(), "state must be a list or a single register data");
         }
+        for(const MqttObjectDataNode& node: ret.mState.getNodes()) {
+            if (hasNestedDeadband(node))
+                throw ConfigurationException(yState.Mark(), "deadband of converted value can be used only for top level state values");
+        }
+    }
+
+    if (aggregate != nullptr) {
+        for(const MqttObjectDataNode& node: ret.mState.getNodes()) {
+            if (!node.isScalar() && !node.hasConverter())
+                throw ConfigurationException(yState["aggregate"].Mark(), "aggregated state values must be single numbers, use converter for multiple registers");
+            if (node.getDeadband() != nullptr)
+                throw ConfigurationException(yState["aggregate"].Mark(), "deadband cannot be used for aggregated state");
+        }
+        ret.setAggregate(aggregate);
     }
 
     const YAML::Node& yAvail = pData["availability"];
@@ -529,10 +958,16 @@ ModMqtt::parseObject(
 
     if (yAvail.IsMap()) {
         std::chrono::milliseconds unused = std::chrono::milliseconds::zero();
-        MqttObjectDataNode node(parseObjectDataNode(yAvail, pDefaultNetwork, pDefaultSlaveId, pDefaultRefresh, ret.getPublishMode(), unused, pSpecsOut));
+        MqttObjectDataNode node(parseObjectDataNode(yAvail, pDefaultNetwork, pDefaultSlaveId, pDefaultRefresh, pDefaultMaxRefresh, ret.getPublishMode(), priority, unused, pSpecsOut));
         if (!node.isScalar() && !node.hasConverter())
             throw ConfigurationException(yAvail.Mark(), "multiple registers availability must use a converter");
+        if (node.getDeadband() != nullptr || hasNestedDeadband(node))
+            throw ConfigurationException(yAvail.Mark(), "deadband of converted value cannot be used for availability");
         ret.addAvailabilityDataNode(node);
+
+        bool skipStatePoll = false;
+        if (ConfigTools::readOptionalValue<bool>(skipStatePoll, yAvail, "skip_state_poll"))
+            ret.setSkipStatePoll(skipStatePoll);
     } else {
         throw ConfigurationException(yState.Mark(), "availability must be a single register or a list with converter");
     }
@@ -546,7 +981,9 @@ ModMqtt::parseObjectDataNode(
     const std::string& pDefaultNetwork,
     int pDefaultSlaveId,
     std::chrono::milliseconds pRefresh,
+    std::chrono::milliseconds pMaxRefresh,
     PublishMode pMode,
+    CommandPriority pPriority,
     std::chrono::milliseconds& pEveryPollRefreshOut,
     std::vector<MsgRegisterPollSpecification>& pSpecsOut
     )
@@ -558,14 +995,19 @@ ModMqtt::parseObjectDataNode(
     if (ConfigTools::readOptionalValue<std::string>(name, pNode, "name"))
         node.setName(name);
 
-    if (ConfigTools::readOptionalValue<std::chrono::milliseconds>(pRefresh, pNode, "refresh")) {
+    if (parseRefresh(pRefresh, pMaxRefresh, pNode)) {
         if (pRefresh < pEveryPollRefreshOut)
             pEveryPollRefreshOut = pRefresh;
     }
 
+    pPriority = parsePriority(pNode, pPriority);
+
     const YAML::Node& converter = pNode["converter"];
     if (converter.IsDefined()) {
         node.setConverter(createConverter(converter));
+        // converted value is compared with the last published one in main thread
+        if (pNode["deadband"].IsDefined())
+            node.setDeadband(parseValueDeadband(pNode));
     }
 
     const YAML::Node& yRegisters = pNode["registers"];
@@ -575,7 +1017,10 @@ ModMqtt::parseObjectDataNode(
             throw ConfigurationException(yRegisters.Mark(), "'registers' must be a list");
         for(size_t i = 0; i < yRegisters.size(); i++) {
             const YAML::Node& yData = yRegisters[i];
-            MqttObjectDataNode childNode(parseObjectDataNode(yData, pDefaultNetwork, pDefaultSlaveId, pRefresh, pMode, pEveryPollRefreshOut, pSpecsOut));
+            // deadband is applied to the converted value
+            if (converter.IsDefined() && yData["deadband"].IsDefined())
+                throw ConfigurationException(yData["deadband"].Mark(), "deadband of registers with converter must be set next to converter");
+            MqttObjectDataNode childNode(parseObjectDataNode(yData, pDefaultNetwork, pDefaultSlaveId, pRefresh, pMaxRefresh, pMode, pPriority, pEveryPollRefreshOut, pSpecsOut));
             //the first element defines if we have named or unnamed list
             if (i == 0)
                 isUnnamed = node.isUnnamed();
@@ -589,7 +1034,12 @@ ModMqtt::parseObjectDataNode(
         int count = 1;
         ConfigTools::readOptionalValue<int>(count, pNode, "count");
 
-        MqttObjectRegisterIdent first_ident = updateSpecification(pNode, count, pRefresh, pDefaultNetwork, pDefaultSlaveId, pMode, pSpecsOut);
+        // without converter deadband is applied to the raw register value
+        const YAML::Node& deadband = pNode["deadband"];
+        if (deadband.IsDefined() && count != 1 && !converter.IsDefined())
+            throw ConfigurationException(deadband.Mark(), "deadband can be used only for a single register or a value with converter");
+
+        MqttObjectRegisterIdent first_ident = updateSpecification(pNode, count, pRefresh, pMaxRefresh, pDefaultNetwork, pDefaultSlaveId, pMode, pPriority, pSpecsOut);
         if (count == 1) {
             node.setScalarNode(first_ident);
         } else {
@@ -613,7 +1063,8 @@ ModMqtt::parseObjectCommand(
     int nextCommandId,
     const YAML::Node& node,
     const std::string& default_network,
-    int default_slave)
+    int default_slave,
+    CommandPriority default_priority)
 {
     std::string name = ConfigTools::readRequiredString(node, "name");
     std::string topic = pTopicPrefix + "/" + name;
@@ -639,6 +1090,8 @@ ModMqtt::parseObjectCommand(
         cmd.setConverter(createConverter(converter));
     }
 
+    cmd.setPriority(parsePriority(node, default_priority));
+
     return cmd;
 }
 
@@ -691,15 +1144,21 @@ ModMqtt::parseObjectCommands(
     int nextCommandId,
     const YAML::Node& commands,
     const std::string& default_network,
-    int default_slave
+    int default_slave,
+    CommandPriority default_priority,
+    int default_qos
 ) {
     if (commands.IsDefined()) {
         if (commands.IsMap()) {
-            mMqtt->addCommand(parseObjectCommand(pTopicPrefix, nextCommandId++, commands, default_network, default_slave));
+            MqttObjectCommand cmd(parseObjectCommand(pTopicPrefix, nextCommandId++, commands, default_network, default_slave, default_priority));
+            cmd.setQos(default_qos);
+            mMqtt->addCommand(cmd);
         } else if (commands.IsSequence()) {
             for(size_t i = 0; i < commands.size(); i++) {
                 const YAML::Node& cmddata = commands[i];
-                mMqtt->addCommand(parseObjectCommand(pTopicPrefix, nextCommandId++, cmddata, default_network, default_slave));
+                MqttObjectCommand cmd(parseObjectCommand(pTopicPrefix, nextCommandId++, cmddata, default_network, default_slave, default_priority));
+                cmd.setQos(default_qos);
+                mMqtt->addCommand(cmd);
             }
         }
     }
@@ -718,10 +1177,11 @@ ModMqtt::initObjects(const YAML::Node& config, const ModMqtt::ModbusInitData& mo
     if (!mqtt.IsDefined())
         throw ConfigurationException(config.Mark(), "mqtt section is missing");
 
-    auto defaultRefresh = std::chrono::milliseconds(5000);
-    ConfigTools::readOptionalValue<std::chrono::milliseconds>(defaultRefresh, mqtt, "refresh");
+    std::chrono::milliseconds defaultRefresh, defaultMaxRefresh;
+    parseDefaultRefresh(defaultRefresh, defaultMaxRefresh, config);
 
     PublishMode defaultPublishMode = parsePublishMode(mqtt);
+    PayloadFormat defaultPayloadFormat = parsePayloadFormat(mqtt);
 
     const YAML::Node& config_objects = mqtt["objects"];
     if (!config_objects.IsDefined())
@@ -773,7 +1233,9 @@ ModMqtt::initObjects(const YAML::Node& config, const ModMqtt::ModbusInitData& mo
                         defaultSlaveId,
                         modbusData.getSlaveName(defaultNetwork, defaultSlaveId),
                         defaultRefresh,
+                        defaultMaxRefresh,
                         defaultPublishMode,
+                        defaultPayloadFormat,
                         pSpecsOut)
                     );
                     const std::string& baseTopic(object.getTopic());
@@ -787,7 +1249,7 @@ ModMqtt::initObjects(const YAML::Node& config, const ModMqtt::ModbusInitData& mo
 
 
                     objects.push_back(object);
-                    nextCommandId = parseObjectCommands(object.getTopic(), nextCommandId, objdata["commands"], defaultNetwork, defaultSlaveId);
+                    nextCommandId = parseObjectCommands(object.getTopic(), nextCommandId, objdata["commands"], defaultNetwork, defaultSlaveId, parsePriority(objdata), object.getQos());
                     BOOST_LOG_SEV(log, Log::debug) << "object for topic " << object.getTopic() << " created";
                     created.insert(defaultSlaveId);
                 }
@@ -803,16 +1265,41 @@ ModMqtt::updateSpecification(
     const YAML::Node& data,
     int pRegisterCount,
     const std::chrono::milliseconds& pCurrentRefresh,
+    const std::chrono::milliseconds& pCurrentMaxRefresh,
     const std::string& pDefaultNetwork,
     int pDefaultSlaveId,
     PublishMode pCurrentMode,
+    CommandPriority pCurrentPriority,
     std::vector<MsgRegisterPollSpecification>& specs)
 {
     const RegisterConfigName rname(data, pDefaultNetwork, pDefaultSlaveId);
 
     MsgRegisterPoll poll(rname.mSlaveId, rname.mRegisterNumber, parseRegisterType(data), pRegisterCount);
-    poll.mRefreshMsec = pCurrentRefresh;
     poll.mPublishMode = pCurrentMode;
+    poll.mPriority = pCurrentPriority;
+
+    // registers with trigger are polled only when trigger register changes
+    // trigger register is polled with current refresh
+    std::vector<MsgRegisterPoll> polls;
+    const YAML::Node& trigger = data["poll_on_change_of"];
+    if (trigger.IsDefined()) {
+        polls.push_back(parseTriggerPoll(trigger, rname.mNetworkName, rname.mSlaveId, pCurrentRefresh, pCurrentMaxRefresh));
+        polls.back().mPriority = pCurrentPriority;
+        poll.addTrigger(polls.back());
+    } else {
+        poll.mRefreshMsec = pCurrentRefresh;
+        poll.mMaxRefreshMsec = pCurrentMaxRefresh;
+    }
+
+    // deadband of converted value is evaluated by MqttObject
+    const YAML::Node& deadband = data["deadband"];
+    if (deadband.IsDefined() && !data["converter"].IsDefined()) {
+        poll.mDeadbands.push_back(parseDeadband(deadband, poll));
+        ConfigTools::readOptionalValue<std::chrono::milliseconds>(poll.mDeadbands.back().mKeepalive, data, "deadband_keepalive");
+    } else {
+        poll.mUnfilteredRanges.push_back(poll);
+    }
+    polls.push_back(poll);
 
     // find network poll specification or create one
     std::vector<MsgRegisterPollSpecification>::iterator spec_it = std::find_if(
@@ -825,7 +1312,7 @@ ModMqtt::updateSpecification(
         spec_it = specs.begin();
     }
 
-    spec_it->merge(poll);
+    spec_it->merge(polls);
 
     return MqttObjectRegisterIdent(rname.mNetworkName, rname.mSlaveId, poll.mRegisterType, poll.mRegister);
 }
@@ -850,10 +1337,12 @@ void ModMqtt::start() {
         waitForSignal();
     } while(gSignalStatus == -1);
 
+    std::chrono::steady_clock::time_point nextTimer = std::chrono::steady_clock::time_point::max();
     while(mMqtt->isStarted()) {
         if (gSignalStatus == -1) {
-            waitForQueues();
+            waitForQueues(nextTimer);
             processModbusMessages();
+            nextTimer = mMqtt->processTimers();
         } else if (gSignalStatus > 0) {
             int currentSignal = gSignalStatus;
             gSignalStatus = -1;
@@ -896,7 +1385,8 @@ void ModMqtt::start() {
     // After disconnection mMqtt will notify global queue mutex
     // Otherwise we are already stopped.
     mMqtt->shutdown();
-    if (mMqtt->isStarted()) {
+    // every broker connection reports its disconnection
+    while (mMqtt->isStarted()) {
         BOOST_LOG_SEV(log, Log::debug) << "Waiting for disconnection event";
         waitForQueues();
     }
@@ -967,11 +1457,27 @@ ModMqtt::waitForQueues() {
     gHasMessages = false;
 }
 
+void
+ModMqtt::waitForQueues(const std::chrono::steady_clock::time_point& pUntil) {
+    if (pUntil == std::chrono::steady_clock::time_point::max()) {
+        waitForQueues();
+        return;
+    }
+    std::unique_lock<std::mutex> lock(gQueueMutex);
+    gHasMessagesCondition.wait_until(lock, pUntil, []{ return gHasMessages;});
+    gHasMessages = false;
+}
+
 void
 ModMqtt::setMqttImplementation(const std::shared_ptr<IMqttImpl>& impl) {
     mMqtt->setMqttImplementation(impl);
 }
 
+void
+ModMqtt::addMqttImplementation(const std::shared_ptr<IMqttImpl>& impl) {
+    mMqtt->addMqttImplementation(impl);
+}
+
 void
 ModMqtt::setModbusContextFactory(const std::shared_ptr<IModbusFactory>& factory) {
     mModbusFactory = factory;
@@ -12,6 +12,7 @@
 #include "modbus_messages.hpp"
 #include "mqttobject.hpp"
 #include "imodbuscontext.hpp"
+#include "bus_load.hpp"
 
 
 namespace modmqttd {
@@ -40,9 +41,12 @@ class ModMqtt {
         */
         void stop();
         void waitForQueues();
+        // wait for queues or until pUntil time point
+        void waitForQueues(const std::chrono::steady_clock::time_point& pUntil);
         void setMqttFinished() { mMqttFinished = true; }
 
         void setMqttImplementation(const std::shared_ptr<IMqttImpl>& impl);
+        void addMqttImplementation(const std::shared_ptr<IMqttImpl>& impl);
         ~ModMqtt();
     private:
         struct ModbusInitData {
@@ -51,6 +55,11 @@ class ModMqtt {
             //network -> map(slave_id, slave_name)
             std::map<std::string, std::map<int, std::string>> mSlaveNames;
 
+            //network -> RTU line load estimator
+            std::map<std::string, BusLoadEstimator> mBusLoad;
+            //network -> config node position for error reporting
+            std::map<std::string, YAML::Mark> mNetworkMarks;
+
             std::string getSlaveName(const std::string& pNetwork, int pSlaveId) const {
                 auto nit = mSlaveNames.find(pNetwork);
                 if (nit == mSlaveNames.end())
@@ -76,14 +85,17 @@ class ModMqtt {
         ModbusInitData initModbusClients(const YAML::Node& config);
         std::vector<MqttObject> initObjects(const YAML::Node& config, const ModbusInitData& modbusData, std::vector<MsgRegisterPollSpecification>& pSpecsOut);
         void waitForSignal();
+        void checkBusLoad(MsgRegisterPollSpecification& spec, const ModbusInitData& modbusData) const;
 
         MqttObjectRegisterIdent updateSpecification(
             const YAML::Node& pData,
             int pRegisterCount,
             const std::chrono::milliseconds& pCurrentRefresh,
+            const std::chrono::milliseconds& pCurrentMaxRefresh,
             const std::string& pDefaultNetwork,
             int pDefaultSlave,
             PublishMode pCurrentMode,
+            CommandPriority pCurrentPriority,
             std::vector<MsgRegisterPollSpecification>& specs
         );
 
@@ -95,7 +107,9 @@ class ModMqtt {
             int pDefaultSlave,
             const std::string& pSlaveName,
             std::chrono::milliseconds pDefaultRefresh,
+            std::chrono::milliseconds pDefaultMaxRefresh,
             PublishMode pDefaultPublishMode,
+            PayloadFormat pDefaultPayloadFormat,
             std::vector<MsgRegisterPollSpecification>& pSpecsOut
         );
 
@@ -104,7 +118,9 @@ class ModMqtt {
             const std::string& pDefaultNetwork,
             int pDefaultSlave,
             std::chrono::milliseconds refresh,
+            std::chrono::milliseconds maxRefresh,
             PublishMode pMode,
+            CommandPriority pPriority,
             std::chrono::milliseconds& pEveryPollRefreshOut,
             std::vector<MsgRegisterPollSpecification>& pSpecs
         );
@@ -122,13 +138,30 @@ class ModMqtt {
             int nextCommandId,
             const YAML::Node& pCommands,
             const std::string& pDefaultNetwork,
-            int pDefaultSlave
+            int pDefaultSlave,
+            CommandPriority pDefaultPriority,
+            int pDefaultQos
+        );
+
+        // add bulk_topic defined for network or slave (pSlaveId != -1)
+        void parseBulkTopic(
+            const YAML::Node& pData,
+            const std::string& pNetworkName,
+            int pSlaveId,
+            const std::string& pSlaveName,
+            std::chrono::milliseconds pDefaultPeriod
         );
 
-        std::vector<modmqttd::MsgRegisterPoll> readModbusPollGroups(const std::string& modbus_network, int default_slave, const YAML::Node& groups);
+        std::vector<modmqttd::MsgRegisterPoll> readModbusPollGroups(
+            const std::string& modbus_network,
+            int default_slave,
+            const YAML::Node& groups,
+            std::chrono::milliseconds pDefaultRefresh,
+            std::chrono::milliseconds pDefaultMaxRefresh
+        );
         void processModbusMessages();
 
-        MqttObjectCommand parseObjectCommand(const std::string& pTopicPrefix, int nextCommandId, const YAML::Node& node, const std::string& default_network, int default_slave);
+        MqttObjectCommand parseObjectCommand(const std::string& pTopicPrefix, int nextCommandId, const YAML::Node& node, const std::string& default_network, int default_slave, CommandPriority default_priority);
 
         bool hasConverterPlugin(const std::string& name) const;
         boost::shared_ptr<ConverterPlugin> initConverterPlugin(const std::string& name);
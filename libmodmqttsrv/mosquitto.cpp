@@ -6,17 +6,17 @@
 
 namespace modmqttd {
 
-static void on_connect_wrapper(struct mosquitto *mosq, void *userdata, int rc)
+static void on_connect_v5_wrapper(struct mosquitto *mosq, void *userdata, int rc, int flags, const mosquitto_property *props)
 {
 	class Mosquitto *m = (class Mosquitto *)userdata;
-	m->on_connect(rc);
+	m->on_connect_v5(rc, flags, props);
 }
 
 
 static void on_connect_with_flags_wrapper(struct mosquitto *mosq, void *userdata, int rc, int flags)
 {
 	class Mosquitto *m = (class Mosquitto *)userdata;
-//	m->on_connect_with_flags(rc, flags);
+	m->on_connect_with_flags(rc, flags);
 }
 
 
@@ -26,13 +26,11 @@ static void on_disconnect_wrapper(struct mosquitto *mosq, void *userdata, int rc
 	m->on_disconnect(rc);
 }
 
-/*
 static void on_publish_wrapper(struct mosquitto *mosq, void *userdata, int mid)
 {
 	class Mosquitto *m = (class Mosquitto *)userdata;
 	m->on_publish(mid);
 }
-*/
 
 static void on_message_wrapper(struct mosquitto *mosq, void *userdata, const struct mosquitto_message *message)
 {
@@ -115,6 +113,14 @@ Mosquitto::connect(const MqttBrokerConfig& config) {
       throwOnCriticalError(rc);
     }
 
+    rc = mosquitto_max_inflight_messages_set(mMosq, config.mMaxInflight);
+    throwOnCriticalError(rc);
+
+    if (config.mProtocol == MqttBrokerConfig::Protocol::MQTT_5) {
+        rc = mosquitto_int_option(mMosq, MOSQ_OPT_PROTOCOL_VERSION, MQTT_PROTOCOL_V5);
+        throwOnCriticalError(rc);
+    }
+
     rc = mosquitto_connect_async(
         mMosq, config.mHost.c_str(),
         config.mPort,
@@ -130,10 +136,13 @@ Mosquitto::connect(const MqttBrokerConfig& config) {
         BOOST_LOG_SEV(log, Log::error) << "Error connecting to mqtt broker: " << returnCodeToStr(rc);
     } else {
         mosquitto_reconnect_delay_set(mMosq, 3,60, true);
-        mosquitto_connect_callback_set(mMosq, on_connect_wrapper);
-        mosquitto_connect_with_flags_callback_set(mMosq, on_connect_with_flags_wrapper);
+        // both callbacks read CONNACK flags and properties before MqttClient::onConnect() is called
+        if (config.mProtocol == MqttBrokerConfig::Protocol::MQTT_5)
+            mosquitto_connect_v5_callback_set(mMosq, on_connect_v5_wrapper);
+        else
+            mosquitto_connect_with_flags_callback_set(mMosq, on_connect_with_flags_wrapper);
         mosquitto_disconnect_callback_set(mMosq, on_disconnect_wrapper);
-        //mosquitto_publish_callback_set(mMosq, on_publish_wrapper);
+        mosquitto_publish_callback_set(mMosq, on_publish_wrapper);
         mosquitto_message_callback_set(mMosq, on_message_wrapper);
         //mosquitto_subscribe_callback_set(mMosq, on_subscribe_wrapper);
         //mosquitto_unsubscribe_callback_set(mMosq, on_unsubscribe_wrapper);
@@ -163,35 +172,72 @@ Mosquitto::stop() {
     mosquitto_loop_stop(mMosq, false);
 }
 
-void Mosquitto::init(MqttClient* owner, const char* clientId) {
+void Mosquitto::init(MqttClient* owner, const char* clientId, int connection) {
     mOwner = owner;
+    mConnection = connection;
     //TODO check return code?
 	mosquitto_reinitialise(mMosq, clientId, true, this);
 }
 
 void
-Mosquitto::subscribe(const char* topic) {
+Mosquitto::subscribe(const char* topic, int qos) {
     int msgId;
-    mosquitto_subscribe(mMosq, &msgId, topic, 0);
+    mosquitto_subscribe(mMosq, &msgId, topic, qos);
 }
 
-void
-Mosquitto::publish(const char* topic, int len, const void* data, bool retain) {
-    int msgId;
-    mosquitto_publish(mMosq, &msgId, topic, len, data, 0, retain);
+int
+Mosquitto::publish(const char* topic, int len, const void* data, bool retain, int qos, int topicAlias) {
+    int msgId = 0;
+    int rc;
+    if (topicAlias > 0) {
+        mosquitto_property* props = NULL;
+        mosquitto_property_add_int16(&props, MQTT_PROP_TOPIC_ALIAS, topicAlias);
+        rc = mosquitto_publish_v5(mMosq, &msgId, topic, len, data, qos, retain, props);
+        mosquitto_property_free_all(&props);
+    } else {
+        rc = mosquitto_publish(mMosq, &msgId, topic, len, data, qos, retain);
+    }
+    if (rc != MOSQ_ERR_SUCCESS) {
+        BOOST_LOG_SEV(log, Log::debug) << "Publish on topic " << topic << " failed: " << returnCodeToStr(rc);
+        return -1;
+    }
+    return msgId;
 }
 
 
 void
 Mosquitto::on_disconnect(int rc) {
     BOOST_LOG_SEV(log, Log::info) << "Disconnected from mqtt broker, code:" << returnCodeToStr(rc);
-    mOwner->onDisconnect();
+    mOwner->onDisconnect(mConnection);
 }
 
 void
 Mosquitto::on_connect(int rc) {
     BOOST_LOG_SEV(log, Log::info) << "Connection established";
-    mOwner->onConnect();
+    mOwner->onConnect(mConnection);
+}
+
+void
+Mosquitto::on_publish(int mid) {
+    mOwner->onPublish(mid, mConnection);
+}
+
+void
+Mosquitto::on_connect_with_flags(int rc, int flags) {
+    // bit 0 of CONNACK flags is session present
+    mSessionPresent = (flags & 1) != 0;
+    on_connect(rc);
+}
+
+void
+Mosquitto::on_connect_v5(int rc, int flags, const mosquitto_property* props) {
+    mSessionPresent = (flags & 1) != 0;
+    // broker does not accept aliases if property is missing
+    uint16_t aliasMaximum = 0;
+    mosquitto_property_read_int16(props, MQTT_PROP_TOPIC_ALIAS_MAXIMUM, &aliasMaximum, false);
+    mTopicAliasMaximum = aliasMaximum;
+    BOOST_LOG_SEV(log, Log::debug) << "Broker accepts " << aliasMaximum << " topic aliases";
+    on_connect(rc);
 }
 
 void
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <mosquitto.h>
 #include "config.hpp"
 #include "common.hpp"
@@ -17,24 +18,32 @@ class Mosquitto : public IMqttImpl {
         static void libCleanup();
 
         Mosquitto();
-        virtual void init(MqttClient* owner, const char* clientId);
+        virtual void init(MqttClient* owner, const char* clientId, int connection);
         virtual void connect(const MqttBrokerConfig& config);
         virtual void stop();
 
         virtual void reconnect();
         virtual void disconnect();
 
-        virtual void subscribe(const char* topic);
-        virtual void publish(const char* topic, int len, const void* data, bool retain);
+        virtual void subscribe(const char* topic, int qos);
+        virtual int publish(const char* topic, int len, const void* data, bool retain, int qos, int topicAlias);
+        virtual int getTopicAliasMaximum() const { return mTopicAliasMaximum; }
+        virtual bool isSessionPresent() const { return mSessionPresent; }
 
         virtual void on_disconnect(int rc);
         virtual void on_connect(int rc);
+        virtual void on_connect_with_flags(int rc, int flags);
+        virtual void on_connect_v5(int rc, int flags, const mosquitto_property* props);
         virtual void on_log(int level, const char* message);
+        virtual void on_publish(int mid);
         virtual void on_message(const struct mosquitto_message *message);
         virtual ~Mosquitto();
     private:
         mosquitto *mMosq = NULL;
         MqttClient* mOwner;
+        int mConnection = 0;
+        std::atomic<int> mTopicAliasMaximum{0};
+        std::atomic<bool> mSessionPresent{false};
         static boost::log::sources::severity_logger<Log::severity> log;
 
         const char* returnCodeToStr(int code);
@@ -0,0 +1,75 @@
+#include "mqttaggregate.hpp"
+
+#include <algorithm>
+
+namespace modmqttd {
+
+const char*
+MqttAggregate::getFunctionName(Function pFunction) {
+    switch(pFunction) {
+        case Function::MIN: return "min";
+        case Function::MAX: return "max";
+        case Function::AVG: return "avg";
+        case Function::LAST: return "last";
+    }
+    return "";
+}
+
+
+void
+MqttAggregate::Accumulator::add(const MqttValue& pValue) {
+    double val = pValue.getDouble();
+    if (mCount == 0) {
+        mMin = mMax = mSum = val;
+        mIsInteger = true;
+        mPrecision = MqttValue::NO_PRECISION;
+    } else {
+        mMin = std::min(mMin, val);
+        mMax = std::max(mMax, val);
+        mSum += val;
+    }
+    mLast = val;
+    mCount++;
+
+    if (pValue.getSourceType() != MqttValue::SourceType::INT && pValue.getSourceType() != MqttValue::SourceType::INT64)
+        mIsInteger = false;
+    if (pValue.getDoublePrecision() != MqttValue::NO_PRECISION)
+        mPrecision = std::max(mPrecision, pValue.getDoublePrecision());
+}
+
+
+void
+MqttAggregate::addSample(int pIdx, const MqttValue& pValue, const std::chrono::steady_clock::time_point& pNow) {
+    if (mWindowEnd == std::chrono::steady_clock::time_point::max())
+        mWindowEnd = pNow + mWindow;
+    mAccumulators[pIdx].add(pValue);
+}
+
+
+bool
+MqttAggregate::hasSamples() const {
+    return std::any_of(mAccumulators.begin(), mAccumulators.end(),
+        [](const Accumulator& acc) -> bool { return acc.mCount != 0; }
+    );
+}
+
+
+void
+MqttAggregate::finishWindow(const std::chrono::steady_clock::time_point& pNow) {
+    if (!hasSamples()) {
+        // wait for the next sample to start a new window
+        mWindowEnd = std::chrono::steady_clock::time_point::max();
+        return;
+    }
+
+    for(Accumulator& acc: mAccumulators)
+        acc.clear();
+
+    // keep window boundaries stable unless main loop was late
+    // for more than whole window
+    mWindowEnd += mWindow;
+    if (mWindowEnd <= pNow)
+        mWindowEnd = pNow + mWindow;
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "libmodmqttconv/converter.hpp"
+
+namespace modmqttd {
+
+/**
+ * Accumulates state values received between publications
+ * of aggregated state. Every top level state data node
+ * has its own accumulator, so memory used does not depend
+ * on the number of samples in window.
+ */
+class MqttAggregate {
+    public:
+        enum class Function {
+            MIN,
+            MAX,
+            AVG,
+            LAST
+        };
+
+        struct Accumulator {
+            void add(const MqttValue& pValue);
+            void clear() { mCount = 0; }
+
+            int mCount = 0;
+            double mMin = 0;
+            double mMax = 0;
+            double mSum = 0;
+            double mLast = 0;
+            // min, max and last are integers if all samples were integers
+            bool mIsInteger = true;
+            int mPrecision = MqttValue::NO_PRECISION;
+        };
+
+        static const char* getFunctionName(Function pFunction);
+
+        MqttAggregate(const std::chrono::milliseconds& pWindow, const std::vector<Function>& pFunctions)
+            : mWindow(pWindow), mFunctions(pFunctions)
+        {}
+
+        void setValueCount(int pCount) { mAccumulators.resize(pCount); }
+        /**
+         * Add sample for value pIdx. The first sample
+         * after an empty window starts a new window
+         */
+        void addSample(int pIdx, const MqttValue& pValue, const std::chrono::steady_clock::time_point& pNow);
+        bool hasSamples() const;
+
+        const std::chrono::steady_clock::time_point& getWindowEnd() const { return mWindowEnd; }
+        bool isWindowFinished(const std::chrono::steady_clock::time_point& pNow) const { return mWindowEnd <= pNow; }
+        /**
+         * Clear accumulators and schedule the next window
+         * right after the finished one
+         */
+        void finishWindow(const std::chrono::steady_clock::time_point& pNow);
+
+        const std::vector<Function>& getFunctions() const { return mFunctions; }
+        const Accumulator& getAccumulator(int pIdx) const { return mAccumulators[pIdx]; }
+    private:
+        std::chrono::milliseconds mWindow;
+        std::vector<Function> mFunctions;
+        std::vector<Accumulator> mAccumulators;
+        std::chrono::steady_clock::time_point mWindowEnd = std::chrono::steady_clock::time_point::max();
+};
+
+}
@@ -0,0 +1,54 @@
+#include <algorithm>
+
+#include "mqttbulktopic.hpp"
+#include "mqttpayload.hpp"
+
+namespace modmqttd {
+
+void
+MqttBulkTopic::addObject(const std::shared_ptr<MqttObject>& pObject) {
+    if (std::find(mObjects.begin(), mObjects.end(), pObject) == mObjects.end())
+        mObjects.push_back(pObject);
+}
+
+
+bool
+MqttBulkTopic::hasAvailableObjects() const {
+    return std::any_of(mObjects.begin(), mObjects.end(),
+        [](const std::shared_ptr<MqttObject>& obj) -> bool { return obj->getAvailableFlag() == AvailableFlag::True; }
+    );
+}
+
+
+bool
+MqttBulkTopic::isPublishDue(const std::chrono::steady_clock::time_point& pNow) {
+    // first snapshot after one period
+    if (mNextPublish == std::chrono::steady_clock::time_point()) {
+        mNextPublish = pNow + mPeriod;
+        return false;
+    }
+    if (pNow < mNextPublish)
+        return false;
+
+    mNextPublish += mPeriod;
+    // do not publish missed snapshots if main loop was blocked
+    if (mNextPublish <= pNow)
+        mNextPublish = pNow + mPeriod;
+    return true;
+}
+
+
+const char*
+MqttBulkTopic::generate() {
+    mBuffer.Clear();
+    mWriter.Reset(mBuffer);
+    mWriter.StartObject();
+    for(const std::shared_ptr<MqttObject>& obj: mObjects) {
+        mWriter.Key(obj->getTopic().c_str());
+        MqttPayload::generateState(mWriter, *obj);
+    }
+    mWriter.EndObject();
+    return mBuffer.GetString();
+}
+
+}
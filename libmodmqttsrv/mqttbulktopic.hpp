@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "mqttobject.hpp"
+
+namespace modmqttd {
+
+/**
+ * Periodic snapshot of all objects polled from a modbus
+ * network or a single slave, published as one JSON document
+ * keyed by object topic.
+ */
+class MqttBulkTopic {
+    public:
+        // pSlaveId = -1 for all slaves in network
+        MqttBulkTopic(const std::string& pTopic, const std::string& pNetworkName, int pSlaveId, std::chrono::milliseconds pPeriod)
+            : mTopic(pTopic), mNetworkName(pNetworkName), mSlaveId(pSlaveId), mPeriod(pPeriod)
+        {}
+
+        const std::string& getTopic() const { return mTopic; }
+        bool matches(const std::string& pNetworkName, int pSlaveId) const {
+            return mNetworkName == pNetworkName && (mSlaveId == -1 || mSlaveId == pSlaveId);
+        }
+
+        void addObject(const std::shared_ptr<MqttObject>& pObject);
+        const std::vector<std::shared_ptr<MqttObject>>& getObjects() const { return mObjects; }
+        bool hasAvailableObjects() const;
+
+        /**
+         * Returns true and schedules the next publish if period is elapsed
+        */
+        bool isPublishDue(const std::chrono::steady_clock::time_point& pNow);
+        const std::chrono::steady_clock::time_point& getNextPublishTime() const { return mNextPublish; }
+
+        // valid until the next call
+        const char* generate();
+    private:
+        std::string mTopic;
+        std::string mNetworkName;
+        int mSlaveId;
+        std::chrono::milliseconds mPeriod;
+        std::chrono::steady_clock::time_point mNextPublish;
+
+        std::vector<std::shared_ptr<MqttObject>> mObjects;
+
+        // reused for every snapshot
+        rapidjson::StringBuffer mBuffer;
+        rapidjson::Writer<rapidjson::StringBuffer> mWriter;
+};
+
+}
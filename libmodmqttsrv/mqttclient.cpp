@@ -1,6 +1,9 @@
+#include <climits>
 #include <cstring>
 #include <cassert>
 #include <map>
+#include <set>
+#include <algorithm>
 
 #include "common.hpp"
 #include "mqttclient.hpp"
@@ -13,8 +16,12 @@ namespace modmqttd {
 
 boost::log::sources::severity_logger<Log::severity> MqttClient::log;
 
+constexpr std::chrono::seconds MqttClient::PUBLISH_QUEUE_LOG_PERIOD;
+
 MqttClient::MqttClient(ModMqtt& modmqttd) : mOwner(modmqttd) {
     mMqttImpl.reset(new Mosquitto());
+    mQueuedQosCounts.resize(1);
+    setRepublishRate(DEFAULT_REPUBLISH_RATE, DEFAULT_REPUBLISH_BURST);
 };
 
 void
@@ -22,14 +29,44 @@ MqttClient::setBrokerConfig(const MqttBrokerConfig& config) {
     if (!mBrokerConfig.isSameAs(config)) {
 		//TODO reconnect
         mBrokerConfig = config;
+
+        // implementations added for unit tests are used first
+        size_t count = mBrokerConfig.mConnections - 1;
+        mPublishConnections.resize(std::min(mPublishConnections.size(), count));
+        while(mPublishConnections.size() < count)
+            addMqttImplementation(std::shared_ptr<IMqttImpl>(new Mosquitto()));
+        for(size_t i = 0; i < mPublishConnections.size(); i++) {
+            int connection = i + 1;
+            std::string clientId(mClientId + "-" + std::to_string(connection));
+            mPublishConnections[i]->mImpl->init(this, clientId.c_str(), connection);
+        }
+        mQueuedQosCounts.assign(mPublishConnections.size() + 1, 0);
     }
 };
 
+void
+MqttClient::addMqttImplementation(const std::shared_ptr<IMqttImpl>& impl) {
+    std::unique_ptr<PublishConnection> conn(new PublishConnection());
+    conn->mImpl = impl;
+    mPublishConnections.push_back(std::move(conn));
+}
+
+void
+MqttClient::enablePublishThread() {
+    mPublishThread.reset(new PublishThread(
+        [this](const PublishThread::Message& msg) -> void {
+            sendNow(msg.mTopic.c_str(), msg.mPayload.length(), msg.mPayload.c_str(), msg.mRetain, msg.mQos, true);
+        }
+    ));
+    mNextQueueStatsLog = std::chrono::steady_clock::now() + PUBLISH_QUEUE_LOG_PERIOD;
+}
+
 void
 MqttClient::setClientId(const std::string& clientId) {
     if (isStarted())
         throw MosquittoException("Cannot change client id when started");
-    mMqttImpl->init(this, clientId.c_str());
+    mClientId = clientId;
+    mMqttImpl->init(this, clientId.c_str(), 0);
 }
 
 void
@@ -42,6 +79,18 @@ MqttClient::start() /*throw(MosquittoException)*/ {
     mIsStarted = true;
     mConnectionState = State::CONNECTING;
     mMqttImpl->connect(mBrokerConfig);
+    for(std::unique_ptr<PublishConnection>& conn: mPublishConnections) {
+        conn->mStarted = true;
+        conn->mImpl->connect(mBrokerConfig);
+    }
+}
+
+bool
+MqttClient::isStarted() const {
+    return mIsStarted || std::any_of(
+        mPublishConnections.begin(), mPublishConnections.end(),
+        [](const std::unique_ptr<PublishConnection>& conn) -> bool { return conn->mStarted; }
+    );
 }
 
 void
@@ -50,6 +99,10 @@ MqttClient::shutdown() {
     //are already stopped
     mModbusClients.clear();
 
+    // send queued messages before disconnect, publish
+    // directly from now on
+    mPublishThread.reset();
+
     switch(mConnectionState) {
         case State::CONNECTED:
             BOOST_LOG_SEV(log, Log::info) << "Disconnecting from mqtt broker";
@@ -68,15 +121,45 @@ MqttClient::shutdown() {
             mIsStarted = false;
             mConnectionState = State::DISCONNECTED;
     }
+
+    // main loop waits until isStarted() is false, so mosquitto
+    // threads of publish connections do not outlive this object
+    for(std::unique_ptr<PublishConnection>& conn: mPublishConnections) {
+        if (!conn->mStarted)
+            continue;
+        // message loop is stopped by onPublishConnectionDisconnect()
+        bool connected = conn->mConnected;
+        conn->mImpl->disconnect();
+        if (!connected) {
+            // stop reconnecting, there is no disconnect callback
+            conn->mImpl->stop();
+            conn->mStarted = false;
+        }
+    }
 }
 
 void
-MqttClient::onDisconnect() {
-    for(std::vector<std::shared_ptr<ModbusClient>>::iterator it = mModbusClients.begin(); it != mModbusClients.end(); it++) {
-        (*it)->sendMqttNetworkIsUp(false);
+MqttClient::setPublishBuffer(const std::shared_ptr<PublishBuffer>& pBuffer, int pReplayRate) {
+    mPublishBuffer = pBuffer;
+    mReplayPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / pReplayRate;
+}
+
+void
+MqttClient::onDisconnect(int connection) {
+    if (connection > 0) {
+        onPublishConnectionDisconnect(connection);
+        return;
+    }
+    // with publish buffer modbus data is stored until broker is back
+    if (mPublishBuffer == nullptr) {
+        for(std::vector<std::shared_ptr<ModbusClient>>::iterator it = mModbusClients.begin(); it != mModbusClients.end(); it++) {
+            (*it)->sendMqttNetworkIsUp(false);
+        }
     }
     switch(mConnectionState) {
         case State::CONNECTED:
+            mConnectionState = State::CONNECTING;
+            // fall through
         case State::CONNECTING:
             BOOST_LOG_SEV(log, Log::info) << "reconnecting to mqtt broker";
             mMqttImpl->reconnect();
@@ -96,13 +179,23 @@ MqttClient::onDisconnect() {
 }
 
 void
-MqttClient::onConnect() {
+MqttClient::onConnect(int connection) {
+    if (connection > 0) {
+        onPublishConnectionConnect(connection);
+        return;
+    }
 	BOOST_LOG_SEV(log, Log::info) << "Mqtt connected, sending subscriptions…";
 
     for(auto cmd: mCommands) {
-        mMqttImpl->subscribe(cmd.second.mTopic.c_str());
+        mMqttImpl->subscribe(cmd.second.mTopic.c_str(), cmd.second.getQos());
     }
 
+    clearInflightIfNoSession(0, *mMqttImpl);
+
+    if (mBrokerConfig.mProtocol == MqttBrokerConfig::Protocol::MQTT_5)
+        mTopicAliases.setMaximum(std::min(mBrokerConfig.mTopicAliasMaximum, mMqttImpl->getTopicAliasMaximum()));
+    mTopicAliases.reset();
+
     mConnectionState = State::CONNECTED;
 
     // if broker was restarted
@@ -110,18 +203,25 @@ MqttClient::onConnect() {
     // modbus register data is changed
     // republish current object state and availability to
     // all subscribed clients
-    publishAll();
+    startRepublish();
 
     for(std::vector<std::shared_ptr<ModbusClient>>::iterator it = mModbusClients.begin(); it != mModbusClients.end(); it++) {
         (*it)->sendMqttNetworkIsUp(true);
     }
 
+    if (mPublishBuffer != nullptr && !mPublishBuffer->empty()) {
+        BOOST_LOG_SEV(log, Log::info) << "Replaying " << mPublishBuffer->getCount() << " buffered messages"
+            << ", " << mPublishBuffer->getDroppedCount() << " dropped due to buffer size limit";
+        // wake up main loop to start replay
+        modmqttd::notifyQueues();
+    }
+
 	BOOST_LOG_SEV(log, Log::info) << "Mqtt ready to process messages";
 }
 
 void
 MqttClient::processRegisterValues(const std::string& pModbusNetworkName, const MsgRegisterValues& pSlaveData) {
-    if (!isConnected()) {
+    if (!canPublish()) {
         // we drop changes when there is no connection
         // retain flag is set so
         // broker will send last known value for us.
@@ -164,7 +264,7 @@ MqttClient::processRegisterValues(const std::string& pModbusNetworkName, const M
                 } else {
                     // delete retained message
                     if (oldAvail == AvailableFlag::NotSet) {
-                        mMqttImpl->publish(obj->getStateTopic().c_str(), 0, NULL, true);
+                        publish(obj->getStateTopic().c_str(), 0, NULL, true, obj->getQos());
                         // remember initial payload for comparsion with subsequent modbus data updates
                         if (!obj->getRetain())
                             obj->setLastPublishedPayload(MqttPayload::generate(*obj));
@@ -179,18 +279,467 @@ MqttClient::processRegisterValues(const std::string& pModbusNetworkName, const M
             publishState(*obj, obj->needStateRepublish());
         }
     }
+
+    if (!mGatedPolls.empty())
+        updateGatedPolls(pModbusNetworkName);
+}
+
+
+void
+MqttClient::addGatedPoll(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange, const std::vector<std::shared_ptr<MqttObject>>& pObjects) {
+    mGatedPolls.push_back(GatedPoll(pNetworkName, pRange, pObjects));
+}
+
+
+void
+MqttClient::updateGatedPolls(const std::string& pNetworkName) {
+    for(GatedPoll& poll: mGatedPolls) {
+        if (poll.mNetworkName != pNetworkName)
+            continue;
+
+        bool suspend = std::all_of(
+            poll.mObjects.begin(), poll.mObjects.end(),
+            [](const std::shared_ptr<MqttObject>& obj) -> bool { return obj->getAvailabilityRegistersFlag() == AvailableFlag::False; }
+        );
+        if (suspend == poll.mSuspended)
+            continue;
+
+        auto it = std::find_if(
+            mModbusClients.begin(), mModbusClients.end(),
+            [&pNetworkName](const std::shared_ptr<ModbusClient>& client) -> bool { return client->mNetworkName == pNetworkName; }
+        );
+        if (it == mModbusClients.end())
+            return;
+
+        poll.mSuspended = suspend;
+        // stale state values must not be published
+        // after polling is resumed
+        if (suspend) {
+            for(std::shared_ptr<MqttObject>& obj: poll.mObjects)
+                obj->clearStateValues(pNetworkName, poll.mRange);
+        }
+
+        BOOST_LOG_SEV(log, Log::debug) << (suspend ? "Suspending" : "Resuming") << " state poll "
+            << pNetworkName << "." << poll.mRange.mSlaveId << "." << poll.mRange.mRegister << ", count=" << poll.mRange.mCount;
+        (*it)->sendRegisterPollSuspend(poll.mRange, suspend);
+    }
+}
+
+void
+MqttClient::setObjects(const MqttPollObjMap& pObjects) {
+    mObjects = pObjects;
+    mAggregatedObjects.clear();
+    mThrottledObjects.clear();
+    mQosObjects.clear();
+    mDeadbandObjects.clear();
+    for(const auto& entry: mObjects) {
+        for(const std::shared_ptr<MqttObject>& obj: entry.second) {
+            if (obj->getQos() > 0 && std::find(mQosObjects.begin(), mQosObjects.end(), obj) == mQosObjects.end())
+                mQosObjects.push_back(obj);
+            for(std::shared_ptr<MqttBulkTopic>& bulk: mBulkTopics) {
+                if (bulk->matches(entry.first.mNetworkName, entry.first.mSlaveId))
+                    bulk->addObject(obj);
+            }
+            if (obj->isAggregated() && std::find(mAggregatedObjects.begin(), mAggregatedObjects.end(), obj) == mAggregatedObjects.end())
+                mAggregatedObjects.push_back(obj);
+            if (obj->isThrottled() && std::find(mThrottledObjects.begin(), mThrottledObjects.end(), obj) == mThrottledObjects.end())
+                mThrottledObjects.push_back(obj);
+            if (obj->hasDeadbandKeepalive() && std::find(mDeadbandObjects.begin(), mDeadbandObjects.end(), obj) == mDeadbandObjects.end())
+                mDeadbandObjects.push_back(obj);
+        }
+    }
 }
 
 void
 MqttClient::publishState(MqttObject& obj, bool force) {
     if (obj.getAvailableFlag() != AvailableFlag::True)
         return;
+    // published by publishAggregatedStates() when window is finished
+    if (obj.isAggregated())
+        return;
     std::string messageData(MqttPayload::generate(obj));
     if (messageData != obj.getLastPublishedPayload() || force) {
+        // changes of converted values are accumulated until they exceed deadband
+        if (!force && obj.isWithinDeadband(std::chrono::steady_clock::now())) {
+            obj.setDeadbandSuppressed(true);
+            return;
+        }
+        // the latest state will be published by publishThrottledStates()
+        if (obj.isThrottled() && std::chrono::steady_clock::now() < obj.getNextPublishTime()) {
+            obj.setPendingPublish(true, force || obj.isPendingPublishForced());
+            return;
+        }
+        // the latest state will be published by publishDeferredStates()
+        // after broker acknowledges messages in flight or connection
+        // used for this topic is restored, publish buffer keeps all states
+        if (obj.getQos() > 0 && isConnected()) {
+            int connection = getConnection(obj.getStateTopic().c_str());
+            if ((!isConnectionUp(connection) && mPublishBuffer == nullptr) || isInflightWindowFull(connection)) {
+                obj.setPendingPublish(true, force || obj.isPendingPublishForced());
+                return;
+            }
+        }
+        obj.setPendingPublish(false);
         BOOST_LOG_SEV(log, Log::debug) << "Publish on topic " << obj.getStateTopic() << ": " << messageData;
-        mMqttImpl->publish(obj.getStateTopic().c_str(), messageData.length(), messageData.c_str(), obj.getRetain());
         obj.setLastPublishedPayload(messageData);
+        publish(obj.getStateTopic(), std::move(messageData), obj.getRetain(), obj.getQos());
+    }
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::processTimers() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point ret = std::min(publishAggregatedStates(now), publishThrottledStates(now));
+    ret = std::min(ret, publishDeadbandKeepalives(now));
+    if (mPublishThread != nullptr)
+        ret = std::min(ret, logPublishQueueStats(now));
+    ret = std::min(ret, publishDeferredStates(now));
+    ret = std::min(ret, rankTopicAliases(now));
+    ret = std::min(ret, publishBulkTopics(now));
+    if (mPublishBuffer != nullptr)
+        ret = std::min(ret, replayBuffer(now));
+    ret = std::min(ret, republishNext(now));
+    return ret;
+}
+
+void
+MqttClient::publish(const char* topic, int len, const void* data, bool retain, int qos) {
+    if (needBuffer(topic)) {
+        mPublishBuffer->append(topic, data, len, retain, qos);
+        return;
     }
+    send(topic, len, data, retain, qos);
+}
+
+void
+MqttClient::publish(const std::string& topic, std::string&& payload, bool retain, int qos) {
+    if (needBuffer(topic.c_str())) {
+        mPublishBuffer->append(topic, payload.c_str(), payload.length(), retain, qos);
+        return;
+    }
+    send(topic, std::move(payload), retain, qos);
+}
+
+bool
+MqttClient::needBuffer(const char* topic) const {
+    if (mPublishBuffer == nullptr)
+        return false;
+    // keep order of messages until buffer is replayed
+    return !mPublishBuffer->empty() || !isConnectionUp(getConnection(topic));
+}
+
+void
+MqttClient::send(const char* topic, int len, const void* data, bool retain, int qos) {
+    if (mPublishThread != nullptr) {
+        std::string payload;
+        if (len > 0)
+            payload.assign(static_cast<const char*>(data), len);
+        enqueue(PublishThread::Message(topic, std::move(payload), retain, qos));
+        return;
+    }
+    sendNow(topic, len, data, retain, qos);
+}
+
+void
+MqttClient::send(const std::string& topic, std::string&& payload, bool retain, int qos) {
+    if (mPublishThread != nullptr) {
+        enqueue(PublishThread::Message(topic, std::move(payload), retain, qos));
+        return;
+    }
+    sendNow(topic.c_str(), payload.length(), payload.c_str(), retain, qos);
+}
+
+void
+MqttClient::enqueue(PublishThread::Message&& msg) {
+    if (msg.mQos > 0) {
+        std::unique_lock<std::mutex> lock(mInflightMutex);
+        mQueuedQosCounts[getConnection(msg.mTopic.c_str())]++;
+    }
+    mPublishThread->enqueue(std::move(msg));
+}
+
+void
+MqttClient::sendNow(const char* topic, int len, const void* data, bool retain, int qos, bool queued) {
+    int connection = getConnection(topic);
+    IMqttImpl& impl(connection == 0 ? *mMqttImpl : *mPublishConnections[connection - 1]->mImpl);
+    // other connection cannot be used without breaking order of messages,
+    // topics of this connection are republished after reconnect
+    if (connection > 0 && !mPublishConnections[connection - 1]->mConnected) {
+        if (queued && qos > 0) {
+            std::unique_lock<std::mutex> lock(mInflightMutex);
+            mQueuedQosCounts[connection]--;
+        }
+        if (mPublishBuffer != nullptr) {
+            BOOST_LOG_SEV(log, Log::trace) << "Publish connection " << connection << " is down, buffering message on topic " << topic;
+            mPublishBuffer->append(topic, data, len, retain, qos);
+        } else {
+            BOOST_LOG_SEV(log, Log::trace) << "Publish connection " << connection << " is down, dropping message on topic " << topic;
+        }
+        return;
+    }
+    if (qos == 0) {
+        TopicAliases& aliases(connection == 0 ? mTopicAliases : mPublishConnections[connection - 1]->mTopicAliases);
+        bool sendTopic = true;
+        int alias = aliases.get(topic, sendTopic);
+        int msgId = impl.publish(sendTopic ? topic : "", len, data, retain, qos, alias);
+        if (alias != 0 && sendTopic && msgId >= 0)
+            aliases.confirmSent(topic, alias);
+        return;
+    }
+    // hold the lock until message id is stored, ack can
+    // arrive on mosquitto thread before publish() returns
+    std::unique_lock<std::mutex> lock(mInflightMutex);
+    if (queued)
+        mQueuedQosCounts[connection]--;
+    int msgId = impl.publish(topic, len, data, retain, qos, 0);
+    if (msgId >= 0)
+        mInflightIds.insert(std::make_pair(connection, msgId));
+}
+
+int
+MqttClient::getConnection(const char* topic) const {
+    if (mPublishConnections.empty())
+        return 0;
+    // FNV-1a, std::hash could differ between builds
+    uint32_t hash = 2166136261u;
+    for(const char* c = topic; *c != '\0'; c++) {
+        hash ^= uint8_t(*c);
+        hash *= 16777619u;
+    }
+    return hash % (mPublishConnections.size() + 1);
+}
+
+void
+MqttClient::onPublishConnectionConnect(int connection) {
+    PublishConnection& conn(*mPublishConnections[connection - 1]);
+    BOOST_LOG_SEV(log, Log::info) << "Mqtt publish connection " << connection << " ready";
+    if (mBrokerConfig.mProtocol == MqttBrokerConfig::Protocol::MQTT_5)
+        conn.mTopicAliases.setMaximum(std::min(mBrokerConfig.mTopicAliasMaximum, conn.mImpl->getTopicAliasMaximum()));
+    conn.mTopicAliases.reset();
+    clearInflightIfNoSession(connection, *conn.mImpl);
+    conn.mConnected = true;
+
+    // messages dropped while connection was down
+    startRepublish(connection);
+}
+
+void
+MqttClient::onPublishConnectionDisconnect(int connection) {
+    PublishConnection& conn(*mPublishConnections[connection - 1]);
+    // QoS > 0 states are deferred and other messages are
+    // dropped until connection is restored
+    conn.mConnected = false;
+    if (mConnectionState == State::DISCONNECTING || !mIsStarted) {
+        BOOST_LOG_SEV(log, Log::info) << "Stopping mosquitto message loop for publish connection " << connection;
+#ifndef __MUSL__
+        conn.mImpl->stop();
+#endif
+        conn.mStarted = false;
+        // signal modmqttd that is waiting on queues mutex
+        // for all connections to disconnect
+        modmqttd::notifyQueues();
+    } else {
+        BOOST_LOG_SEV(log, Log::info) << "Reconnecting publish connection " << connection << " to mqtt broker";
+        conn.mImpl->reconnect();
+    }
+}
+
+void
+MqttClient::onPublish(int msgId, int connection) {
+    std::unique_lock<std::mutex> lock(mInflightMutex);
+    // the same count as in isInflightWindowFull()
+    bool wasFull = countInflight(connection) >= mBrokerConfig.mMaxInflight;
+    // QoS 0 messages are also reported after they are sent
+    if (mInflightIds.erase(std::make_pair(connection, msgId)) == 0)
+        return;
+    lock.unlock();
+    // wake up main loop to publish deferred states
+    if (wasFull)
+        modmqttd::notifyQueues();
+}
+
+void
+MqttClient::clearInflightIfNoSession(int connection, const IMqttImpl& impl) {
+    // with a session libmosquitto resends QoS > 0 messages that were not
+    // acknowledged with their original ids, so they stay in flight.
+    // Without it acks for them may never arrive.
+    if (impl.isSessionPresent())
+        return;
+    std::unique_lock<std::mutex> lock(mInflightMutex);
+    auto first = mInflightIds.lower_bound(std::make_pair(connection, INT_MIN));
+    auto last = mInflightIds.lower_bound(std::make_pair(connection + 1, INT_MIN));
+    if (first != last)
+        BOOST_LOG_SEV(log, Log::debug) << "No session on broker, dropping " << std::distance(first, last) << " in-flight ids of connection " << connection;
+    mInflightIds.erase(first, last);
+}
+
+int
+MqttClient::getInflightCount(int connection) const {
+    std::unique_lock<std::mutex> lock(mInflightMutex);
+    return countInflight(connection);
+}
+
+int
+MqttClient::countInflight(int connection) const {
+    auto first = mInflightIds.lower_bound(std::make_pair(connection, INT_MIN));
+    auto last = mInflightIds.lower_bound(std::make_pair(connection + 1, INT_MIN));
+    return std::distance(first, last) + mQueuedQosCounts[connection];
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::publishBulkTopics(const std::chrono::steady_clock::time_point& pNow) {
+    std::chrono::steady_clock::time_point ret = std::chrono::steady_clock::time_point::max();
+    for(std::shared_ptr<MqttBulkTopic>& bulk: mBulkTopics) {
+        if (bulk->isPublishDue(pNow) && canPublish() && bulk->hasAvailableObjects()) {
+            const char* messageData = bulk->generate();
+            BOOST_LOG_SEV(log, Log::debug) << "Publish bulk topic " << bulk->getTopic() << " with " << bulk->getObjects().size() << " objects";
+            publish(bulk->getTopic().c_str(), strlen(messageData), messageData, true, 0);
+        }
+        ret = std::min(ret, bulk->getNextPublishTime());
+    }
+    return ret;
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::rankTopicAliases(const std::chrono::steady_clock::time_point& pNow) {
+    if (mBrokerConfig.mProtocol != MqttBrokerConfig::Protocol::MQTT_5 || mBrokerConfig.mTopicAliasMaximum == 0)
+        return std::chrono::steady_clock::time_point::max();
+
+    if (pNow >= mNextAliasRanking) {
+        // wait for publish statistics after start
+        if (mNextAliasRanking != std::chrono::steady_clock::time_point()) {
+            mTopicAliases.rank();
+            BOOST_LOG_SEV(log, Log::debug) << "Topic aliases assigned to " << mTopicAliases.getAliasCount() << " topics";
+            for(std::unique_ptr<PublishConnection>& conn: mPublishConnections)
+                conn->mTopicAliases.rank();
+        }
+        mNextAliasRanking = pNow + mBrokerConfig.mTopicAliasRefresh;
+    }
+    return mNextAliasRanking;
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::publishDeferredStates(const std::chrono::steady_clock::time_point& pNow) {
+    if (!isConnected())
+        return std::chrono::steady_clock::time_point::max();
+
+    for(std::shared_ptr<MqttObject>& obj: mQosObjects) {
+        // throttled objects wait for publishThrottledStates()
+        if (!obj->hasPendingPublish() || (obj->isThrottled() && pNow < obj->getNextPublishTime()))
+            continue;
+        int connection = getConnection(obj->getStateTopic().c_str());
+        if (!isConnectionUp(connection) || isInflightWindowFull(connection))
+            continue;
+        bool force = obj->isPendingPublishForced();
+        obj->setPendingPublish(false);
+        publishState(*obj, force);
+    }
+    // woken up by onPublish() or publish connection reconnect
+    return std::chrono::steady_clock::time_point::max();
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::replayBuffer(const std::chrono::steady_clock::time_point& pNow) {
+    if (!isConnected() || mPublishBuffer->empty())
+        return std::chrono::steady_clock::time_point::max();
+
+    if (pNow < mNextReplayTime)
+        return mNextReplayTime;
+
+    // catch up if main loop was woken up late
+    int count = 1;
+    if (mNextReplayTime != std::chrono::steady_clock::time_point())
+        count = std::max<int>(1, std::min<int64_t>(100, (pNow - mNextReplayTime) / mReplayPeriod));
+
+    PublishBuffer::Entry entry;
+    for(int i = 0; i < count && mPublishBuffer->front(entry); i++) {
+        // continue after connection used for this topic is restored
+        // and broker acknowledges messages in flight
+        int connection = getConnection(entry.mTopic.c_str());
+        if (!isConnectionUp(connection) || (entry.mQos > 0 && isInflightWindowFull(connection)))
+            return std::chrono::steady_clock::time_point::max();
+        BOOST_LOG_SEV(log, Log::trace) << "Replaying buffered message on topic " << entry.mTopic;
+        send(entry.mTopic.c_str(), entry.mPayload.length(), entry.mPayload.c_str(), entry.mRetain, entry.mQos);
+        mPublishBuffer->pop();
+    }
+
+    if (mPublishBuffer->empty()) {
+        BOOST_LOG_SEV(log, Log::info) << "All buffered messages replayed";
+        mNextReplayTime = std::chrono::steady_clock::time_point();
+        return std::chrono::steady_clock::time_point::max();
+    }
+    mNextReplayTime = pNow + mReplayPeriod;
+    return mNextReplayTime;
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::publishThrottledStates(const std::chrono::steady_clock::time_point& pNow) {
+    std::chrono::steady_clock::time_point ret = std::chrono::steady_clock::time_point::max();
+    for(std::shared_ptr<MqttObject>& obj: mThrottledObjects) {
+        if (!obj->hasPendingPublish())
+            continue;
+
+        if (obj->getNextPublishTime() <= pNow) {
+            bool force = obj->isPendingPublishForced();
+            obj->setPendingPublish(false);
+            // state could change back to the last published one
+            // or become unavailable in the meantime
+            if (canPublish())
+                publishState(*obj, force);
+        } else {
+            ret = std::min(ret, obj->getNextPublishTime());
+        }
+    }
+    return ret;
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::logPublishQueueStats(const std::chrono::steady_clock::time_point& pNow) {
+    if (pNow < mNextQueueStatsLog)
+        return mNextQueueStatsLog;
+
+    mNextQueueStatsLog = pNow + PUBLISH_QUEUE_LOG_PERIOD;
+    BOOST_LOG_SEV(log, Log::debug) << "Publish thread queue depth " << mPublishThread->getQueueDepth()
+        << ", max " << mPublishThread->popMaxQueueDepth() << " in the last " << PUBLISH_QUEUE_LOG_PERIOD.count() << "s";
+    return mNextQueueStatsLog;
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::publishDeadbandKeepalives(const std::chrono::steady_clock::time_point& pNow) {
+    std::chrono::steady_clock::time_point ret = std::chrono::steady_clock::time_point::max();
+    for(std::shared_ptr<MqttObject>& obj: mDeadbandObjects) {
+        if (!obj->isDeadbandSuppressed())
+            continue;
+
+        std::chrono::steady_clock::time_point keepalive = obj->getDeadbandKeepaliveTime();
+        if (keepalive <= pNow) {
+            obj->setDeadbandSuppressed(false);
+            if (canPublish())
+                publishState(*obj);
+        } else {
+            ret = std::min(ret, keepalive);
+        }
+    }
+    return ret;
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::publishAggregatedStates(const std::chrono::steady_clock::time_point& pNow) {
+    std::chrono::steady_clock::time_point ret = std::chrono::steady_clock::time_point::max();
+    for(std::shared_ptr<MqttObject>& obj: mAggregatedObjects) {
+        MqttAggregate& aggregate(obj->getAggregate());
+        if (aggregate.isWindowFinished(pNow)) {
+            if (canPublish() && obj->getAvailableFlag() == AvailableFlag::True && aggregate.hasSamples()) {
+                std::string messageData(MqttPayload::generateAggregate(*obj));
+                BOOST_LOG_SEV(log, Log::debug) << "Publish aggregated state on topic " << obj->getStateTopic() << ": " << messageData;
+                obj->setLastPublishedPayload(messageData);
+                publish(obj->getStateTopic(), std::move(messageData), obj->getRetain(), obj->getQos());
+            }
+            aggregate.finishWindow(pNow);
+        }
+        ret = std::min(ret, aggregate.getWindowEnd());
+    }
+    return ret;
 }
 
 void
@@ -245,25 +794,77 @@ MqttClient::publishAvailabilityChange(const MqttObject& obj) {
         return;
     char msg = obj.getAvailableFlag() == AvailableFlag::True ? '1' : '0';
     int msgId;
-    mMqttImpl->publish(obj.getAvailabilityTopic().c_str(), 1, &msg, true);
+    publish(obj.getAvailabilityTopic().c_str(), 1, &msg, true, obj.getQos());
 }
 
 void
-MqttClient::publishAll() {
-    std::set<std::shared_ptr<MqttObject>> published;
+MqttClient::startRepublish(int connection) {
+    std::set<std::shared_ptr<MqttObject>> queued;
+    std::vector<std::shared_ptr<MqttObject>> objects;
 
     for(MqttPollObjMap::iterator it = mObjects.begin(); it != mObjects.end(); it++)
     {
         for (std::vector<std::shared_ptr<MqttObject>>::iterator oit = it->second.begin(); oit != it->second.end(); oit++) {
-            const std::shared_ptr<MqttObject>& optr = *oit;
-            if (published.find(optr) == published.end()) {
-                if ((*oit)->getAvailableFlag() == AvailableFlag::True)
-                    publishState(**oit, true);
-                publishAvailabilityChange(**oit);
-                published.insert(*oit);
-            }
+            if (connection >= 0
+                && getConnection((*oit)->getStateTopic().c_str()) != connection
+                && getConnection((*oit)->getAvailabilityTopic().c_str()) != connection)
+                continue;
+            if (queued.insert(*oit).second)
+                objects.push_back(*oit);
+        }
+    }
+
+    std::stable_sort(objects.begin(), objects.end(),
+        [](const std::shared_ptr<MqttObject>& a, const std::shared_ptr<MqttObject>& b) -> bool { return a->getPriority() > b->getPriority(); }
+    );
+
+    std::unique_lock<std::mutex> lock(mRepublishMutex);
+    // republish after publish connection reconnect
+    // does not cancel republish of other objects
+    if (connection < 0) {
+        mRepublishQueue.assign(objects.begin(), objects.end());
+        mRepublishTotal = mRepublishQueue.size();
+    } else {
+        mRepublishQueue.insert(mRepublishQueue.end(), objects.begin(), objects.end());
+        mRepublishTotal += objects.size();
+    }
+    mRepublishStartTime = std::chrono::steady_clock::now();
+    lock.unlock();
+
+    BOOST_LOG_SEV(log, Log::info) << "Republishing " << objects.size() << " objects";
+    // wake up main loop to start republish
+    modmqttd::notifyQueues();
+}
+
+std::chrono::steady_clock::time_point
+MqttClient::republishNext(const std::chrono::steady_clock::time_point& pNow) {
+    // buffered messages are older than current state
+    if (!isConnected() || (mPublishBuffer != nullptr && !mPublishBuffer->empty()))
+        return std::chrono::steady_clock::time_point::max();
+
+    std::unique_lock<std::mutex> lock(mRepublishMutex);
+    while(!mRepublishQueue.empty()) {
+        std::shared_ptr<MqttObject> obj(mRepublishQueue.front());
+        // nothing to publish until first modbus read
+        if (obj->getAvailableFlag() != AvailableFlag::NotSet) {
+            if (!mRepublishBucket->tryTake(pNow))
+                return mRepublishBucket->getNextTokenTime();
+            // skip state if it was already published after reconnect
+            if (obj->getLastPublishTime() < mRepublishStartTime)
+                publishState(*obj, true);
+            publishAvailabilityChange(*obj);
+        }
+        mRepublishQueue.pop_front();
+
+        if (mRepublishQueue.empty()) {
+            BOOST_LOG_SEV(log, Log::info) << "Republished " << mRepublishTotal << " objects in "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(pNow - mRepublishStartTime).count() << "ms";
+        } else if (mRepublishQueue.size() % 1000 == 0) {
+            BOOST_LOG_SEV(log, Log::debug) << "Republish progress: " << (mRepublishTotal - mRepublishQueue.size())
+                << "/" << mRepublishTotal << " objects";
         }
     }
+    return std::chrono::steady_clock::time_point::max();
 }
 
 MqttValue
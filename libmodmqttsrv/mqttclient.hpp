@@ -1,11 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <set>
+
 #include "config.hpp"
 #include "common.hpp"
 #include "mqttobject.hpp"
 #include "modbus_client.hpp"
 #include "imqttimpl.hpp"
 #include "default_command_converter.hpp"
+#include "publish_buffer.hpp"
+#include "publish_thread.hpp"
+#include "token_bucket.hpp"
+#include "topic_aliases.hpp"
+#include "mqttbulktopic.hpp"
 
 namespace modmqttd {
 
@@ -16,6 +26,10 @@ class MqttClient {
         typedef std::map<MqttObjectRegisterIdent, std::vector<std::shared_ptr<MqttObject>>, MqttObjectRegisterIdent::Compare> MqttPollObjMap;
         typedef std::map<int, std::vector<std::shared_ptr<MqttObject>>> MqttCmdObjMap;
 
+        static constexpr int DEFAULT_REPUBLISH_RATE = 1000;
+        static constexpr int DEFAULT_REPUBLISH_BURST = 100;
+        static constexpr std::chrono::seconds PUBLISH_QUEUE_LOG_PERIOD = std::chrono::seconds(60);
+
         enum State {
             DISCONNECTED,
             CONNECTING,
@@ -26,36 +40,107 @@ class MqttClient {
         MqttClient(ModMqtt& modmqttd);
         void setClientId(const std::string& clientId);
         void setBrokerConfig(const MqttBrokerConfig& config);
+        /**
+         * Store publishes in pBuffer while broker is not connected
+         * and replay them with pReplayRate messages per second after reconnect
+         */
+        void setPublishBuffer(const std::shared_ptr<PublishBuffer>& pBuffer, int pReplayRate);
+        /**
+         * Limit rate of republishing all objects after broker reconnect
+         * to pRate objects per second with bursts of up to pBurst objects
+         */
+        void setRepublishRate(int pRate, int pBurst) { mRepublishBucket.reset(new TokenBucket(pRate, pBurst)); }
+        /**
+         * Send messages to broker from a dedicated thread
+         * instead of the main loop
+         */
+        void enablePublishThread();
         void setModbusClients(const std::vector<std::shared_ptr<ModbusClient>>& clients) { mModbusClients = clients; }
         void start() ;//TODO throw(MosquittoException) - deprecated?;
-        bool isStarted() { return mIsStarted; }
+        // true until primary and all publish connections are stopped
+        bool isStarted() const;
         void shutdown();
         bool isConnected() const { return mConnectionState == State::CONNECTED; }
         void reconnect() { mMqttImpl->reconnect(); }
-        void setObjects(const MqttPollObjMap& pObjects) { mObjects = pObjects; };
+        void setObjects(const MqttPollObjMap& pObjects);
         void setCommandObjects(const MqttCmdObjMap& pCmdObjects) { mCommandObjects = pCmdObjects; }
+        /**
+         * Register state poll that should be suspended when
+         * availability registers of all pObjects report unavailable state
+        */
+        void addGatedPoll(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange, const std::vector<std::shared_ptr<MqttObject>>& pObjects);
+
+        /**
+         * Objects are assigned to bulk topics in setObjects(),
+         * so bulk topics must be added before
+        */
+        void addBulkTopic(const std::shared_ptr<MqttBulkTopic>& pBulkTopic) { mBulkTopics.push_back(pBulkTopic); }
+        const std::vector<std::shared_ptr<MqttBulkTopic>>& getBulkTopics() const { return mBulkTopics; }
 
         void addCommand(const MqttObjectCommand& pCommand);
         const std::map<std::string, MqttObjectCommand>& getCommands() const { return mCommands; }
 
-        //publish all data after broker is reconnected
-        void publishAll();
+        /**
+         * Queue all objects for publishing after broker is reconnected,
+         * or only objects with topics on connection if it is not negative.
+         * Objects are published by processTimers() in priority order
+         */
+        void startRepublish(int connection = -1);
         void publishState(MqttObject& obj, bool force=false);
         void publishAvailabilityChange(const MqttObject& obj);
+        /**
+         * Publish states delayed by aggregation windows, min publish
+         * interval or deadband keepalive. Returns time point of the next
+         * delayed publish or time_point::max() if there is nothing to wait for
+         */
+        std::chrono::steady_clock::time_point processTimers();
 
         void processRegisterValues(const std::string& modbusNetworkName, const MsgRegisterValues& values);
         void processRegistersOperationFailed(const std::string& modbusNetworkName, const ModbusSlaveAddressRange& values);
         void processModbusNetworkState(const std::string& modbusNetworkName, bool isUp);
 
         //mqtt communication callbacks
-        void onDisconnect();
-        void onConnect();
+        void onDisconnect(int connection = 0);
+        void onConnect(int connection = 0);
         void onMessage(const char* topic, const void* payload, int payload_len);
+        // QoS > 0 message is acknowledged by broker
+        void onPublish(int msgId, int connection = 0);
+
+        // number of QoS > 0 messages on connection waiting for broker acknowledgement
+        int getInflightCount(int connection) const;
 
         //for unit tests
         void setMqttImplementation(const std::shared_ptr<IMqttImpl>& impl) { mMqttImpl = impl; }
+        // implementation for the next additional connection, must be called before setBrokerConfig()
+        void addMqttImplementation(const std::shared_ptr<IMqttImpl>& impl);
     private:
         std::shared_ptr<IMqttImpl> mMqttImpl;
+        std::string mClientId;
+
+        /**
+         * Additional broker connection used only for publishing.
+         * Connection state is changed by mosquitto thread and read
+         * by publishing thread
+        */
+        struct PublishConnection {
+            std::shared_ptr<IMqttImpl> mImpl;
+            std::atomic<bool> mConnected{false};
+            // message loop is running and can call MqttClient
+            std::atomic<bool> mStarted{false};
+            TopicAliases mTopicAliases;
+        };
+        std::vector<std::unique_ptr<PublishConnection>> mPublishConnections;
+
+        void onPublishConnectionConnect(int connection);
+        void onPublishConnectionDisconnect(int connection);
+        /**
+         * Stable topic hash selects connection, so messages on the same
+         * topic are always sent in order, also when selected connection is down.
+        */
+        int getConnection(const char* topic) const;
+        bool isConnectionUp(int connection) const {
+            return connection == 0 ? isConnected() : bool(mPublishConnections[connection - 1]->mConnected);
+        }
 
         void subscribeToCommandTopic(const std::string& objectName, const MqttObjectCommand& cmd);
 
@@ -63,7 +148,52 @@ class MqttClient {
         ModMqtt& mOwner;
         MqttBrokerConfig mBrokerConfig;
 
+        struct GatedPoll {
+            GatedPoll(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange, const std::vector<std::shared_ptr<MqttObject>>& pObjects)
+                : mNetworkName(pNetworkName), mRange(pRange), mObjects(pObjects)
+            {}
+            std::string mNetworkName;
+            ModbusSlaveAddressRange mRange;
+            std::vector<std::shared_ptr<MqttObject>> mObjects;
+            bool mSuspended = false;
+        };
+
+        // publish or store in mPublishBuffer
+        void publish(const char* topic, int len, const void* data, bool retain, int qos);
+        void publish(const std::string& topic, std::string&& payload, bool retain, int qos);
+        // true if message must be appended to mPublishBuffer
+        bool needBuffer(const char* topic) const;
+        // pass message to mPublishThread or send it
+        void send(const char* topic, int len, const void* data, bool retain, int qos);
+        void send(const std::string& topic, std::string&& payload, bool retain, int qos);
+        void enqueue(PublishThread::Message&& msg);
+        /**
+         * Publish and track QoS > 0 message until it is acknowledged.
+         * queued is true for messages passed by mPublishThread
+         */
+        void sendNow(const char* topic, int len, const void* data, bool retain, int qos, bool queued = false);
+        // each connection has its own max_inflight limit in mosquitto
+        bool isInflightWindowFull(int connection) const { return getInflightCount(connection) >= mBrokerConfig.mMaxInflight; }
+        // mInflightMutex must be locked
+        int countInflight(int connection) const;
+        void clearInflightIfNoSession(int connection, const IMqttImpl& impl);
+        // true if published data will be not dropped
+        bool canPublish() const { return isConnected() || mPublishBuffer != nullptr; }
+        std::chrono::steady_clock::time_point replayBuffer(const std::chrono::steady_clock::time_point& pNow);
+
+        std::chrono::steady_clock::time_point publishAggregatedStates(const std::chrono::steady_clock::time_point& pNow);
+        std::chrono::steady_clock::time_point publishThrottledStates(const std::chrono::steady_clock::time_point& pNow);
+        // log publish thread queue depth every PUBLISH_QUEUE_LOG_PERIOD
+        std::chrono::steady_clock::time_point logPublishQueueStats(const std::chrono::steady_clock::time_point& pNow);
+        // publish changes suppressed by deadband of converted values after keepalive
+        std::chrono::steady_clock::time_point publishDeadbandKeepalives(const std::chrono::steady_clock::time_point& pNow);
+        std::chrono::steady_clock::time_point publishDeferredStates(const std::chrono::steady_clock::time_point& pNow);
+        std::chrono::steady_clock::time_point rankTopicAliases(const std::chrono::steady_clock::time_point& pNow);
+        std::chrono::steady_clock::time_point publishBulkTopics(const std::chrono::steady_clock::time_point& pNow);
+        std::chrono::steady_clock::time_point republishNext(const std::chrono::steady_clock::time_point& pNow);
+
         void checkAvailabilityChange(MqttObject& object, const MqttObjectRegisterIdent& ident, uint16_t value);
+        void updateGatedPolls(const std::string& pNetworkName);
         const MqttObjectCommand& findCommand(const char* topic) const;
 
         std::vector<std::shared_ptr<ModbusClient>> mModbusClients;
@@ -80,15 +210,60 @@ class MqttClient {
         */
         MqttPollObjMap mObjects;
 
+        // objects from mObjects with aggregated state
+        std::vector<std::shared_ptr<MqttObject>> mAggregatedObjects;
+        // objects from mObjects with min publish interval
+        std::vector<std::shared_ptr<MqttObject>> mThrottledObjects;
+        std::vector<std::shared_ptr<MqttBulkTopic>> mBulkTopics;
+
+        // objects from mObjects published with QoS > 0
+        std::vector<std::shared_ptr<MqttObject>> mQosObjects;
+        // objects from mObjects with deadband keepalive of converted values
+        std::vector<std::shared_ptr<MqttObject>> mDeadbandObjects;
+
+        /**
+         * Connection and message ids of QoS > 0 publishes not acknowledged yet.
+         * When in flight window is full state publishes
+         * are deferred and only the latest state is sent after ack
+        */
+        std::set<std::pair<int, int>> mInflightIds;
+        // QoS > 0 messages waiting in mPublishThread per connection,
+        // they will be in flight soon
+        std::vector<int> mQueuedQosCounts;
+        mutable std::mutex mInflightMutex;
+
         /**
          * Direct relation between command and objects that poll the
          * same registers
         */
         MqttCmdObjMap mCommandObjects;
 
+        /**
+         * State polls suspended while objects are not available
+        */
+        std::vector<GatedPoll> mGatedPolls;
+
         std::map<std::string, MqttObjectCommand> mCommands;
 
         DefaultCommandConverter mDefaultConverter;
+
+        // objects left to publish after reconnect, modified by mosquitto and main thread
+        std::deque<std::shared_ptr<MqttObject>> mRepublishQueue;
+        std::mutex mRepublishMutex;
+        int mRepublishTotal = 0;
+        std::chrono::steady_clock::time_point mRepublishStartTime;
+        std::shared_ptr<TokenBucket> mRepublishBucket;
+
+        // used for QoS 0 publishes only, resent QoS > 0 messages
+        // could refer to aliases from the previous connection
+        TopicAliases mTopicAliases;
+        std::chrono::steady_clock::time_point mNextAliasRanking;
+
+        std::shared_ptr<PublishBuffer> mPublishBuffer;
+        std::unique_ptr<PublishThread> mPublishThread;
+        std::chrono::steady_clock::duration mReplayPeriod;
+        std::chrono::steady_clock::time_point mNextReplayTime;
+        std::chrono::steady_clock::time_point mNextQueueStatsLog;
 };
 
 }
@@ -37,8 +37,16 @@ class MqttObjectCommand : public ModbusSlaveAddressRange {
         bool hasConverter() const { return mConverter != nullptr; }
         const DataConverter& getConverter() const { return *mConverter; }
         int getCommandId() const { return mCommandId; }
+
+        void setPriority(CommandPriority pPriority) { mPriority = pPriority; }
+        CommandPriority getPriority() const { return mPriority; }
+
+        void setQos(int pQos) { mQos = pQos; }
+        int getQos() const { return mQos; }
     private:
         int mCommandId;
+        CommandPriority mPriority = CommandPriority::NORMAL;
+        int mQos = 0;
         std::shared_ptr<DataConverter> mConverter;
 };
 
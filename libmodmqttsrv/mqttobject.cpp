@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include <rapidjson/stringbuffer.h>
@@ -9,6 +10,18 @@
 
 namespace modmqttd {
 
+boost::log::sources::severity_logger<Log::severity> MqttObject::log;
+
+bool
+MqttValueDeadband::isWithin(const MqttValue& pOld, const MqttValue& pNew) const {
+    // text values are published on every change
+    if (pOld.getSourceType() == MqttValue::SourceType::BINARY || pNew.getSourceType() == MqttValue::SourceType::BINARY)
+        return false;
+    double oldVal = pOld.getDouble();
+    double threshold = mPercent ? mThreshold * std::fabs(oldVal) / 100.0 : mThreshold;
+    return std::fabs(pNew.getDouble() - oldVal) <= threshold;
+}
+
 bool
 MqttObjectRegisterValue::setValue(uint16_t val) {
     bool hadValue = mHasValue;
@@ -73,6 +86,22 @@ MqttObjectDataNode::updateRegistersReadFailed(const std::string& pNetworkName, c
 }
 
 
+bool
+MqttObjectDataNode::clearRegisterValues(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange) {
+    bool ret = false;
+    if (!isScalar()) {
+        for(MqttObjectDataNode& node: mNodes) {
+            if (node.clearRegisterValues(pNetworkName, pRange))
+                ret = true;
+        }
+    } else if (mValue.hasValue() && hasRegisterIn(pNetworkName, pRange)) {
+        mValue.clearValue();
+        ret = true;
+    }
+    return ret;
+}
+
+
 bool
 MqttObjectDataNode::setModbusNetworkState(const std::string& pNetworkName, bool isUp) {
     bool ret = false;
@@ -193,6 +222,17 @@ MqttObjectDataNode::getRawValue() const {
 }
 
 
+void
+MqttObjectDataNode::appendRawValues(std::vector<uint16_t>& pValues) const {
+    if (isScalar()) {
+        pValues.push_back(mValue.getRawValue());
+        return;
+    }
+    for(const MqttObjectDataNode& node: mNodes)
+        node.appendRawValues(pValues);
+}
+
+
 void
 MqttObjectDataNode::addChildDataNode(const MqttObjectDataNode& pNode, bool forceList) {
     mNodes.push_back(pNode);
@@ -232,6 +272,17 @@ MqttObjectState::updateRegistersReadFailed(const std::string& pNetworkName, cons
 }
 
 
+bool
+MqttObjectState::clearRegisterValues(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange) {
+    bool ret = false;
+    for(std::vector<MqttObjectDataNode>::iterator it = mNodes.begin(); it != mNodes.end(); it++) {
+        if (it->clearRegisterValues(pNetworkName, pRange))
+            ret = true;
+    }
+    return ret;
+}
+
+
 bool
 MqttObjectState::setModbusNetworkState(const std::string& networkName, bool isUp) {
     bool ret = false;
@@ -292,6 +343,11 @@ MqttObject::updateRegisterValues(const std::string& pNetworkName, const MsgRegis
     if (stateChanged || availChanged || !mIsAvailable) {
         updateAvailablityFlag();
     }
+
+    // registers of aggregated state are polled in every_poll mode
+    // so every read is a sample, even without value change
+    if (mAggregate != nullptr && mIsAvailable == AvailableFlag::True)
+        addAggregateSample(pNetworkName, pSlaveData);
 }
 
 
@@ -305,6 +361,13 @@ MqttObject::updateRegistersReadFailed(const std::string& pNetworkName, const Mod
 }
 
 
+void
+MqttObject::clearStateValues(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange) {
+    if (mState.clearRegisterValues(pNetworkName, pRange))
+        updateAvailablityFlag();
+}
+
+
 bool
 MqttObject::setModbusNetworkState(const std::string& networkName, bool isUp) {
     bool stateChanged = mState.setModbusNetworkState(networkName, isUp);
@@ -353,6 +416,85 @@ MqttObject::needStateRepublish() const {
     return nextPublish <= std::chrono::steady_clock::now();
 }
 
+void
+MqttObject::saveDeadbandValues() {
+    const MqttObjectDataNodeList& nodes(mState.getNodes());
+    if (std::none_of(nodes.begin(), nodes.end(), [](const MqttObjectDataNode& node) -> bool { return node.getDeadband() != nullptr; }))
+        return;
+
+    mDeadbandValues.clear();
+    mPublishedRawValues.clear();
+    for(const MqttObjectDataNode& node: nodes) {
+        if (node.getDeadband() != nullptr)
+            mDeadbandValues.push_back(node.getConvertedValue());
+        else
+            node.appendRawValues(mPublishedRawValues);
+    }
+}
+
+bool
+MqttObject::isWithinDeadband(const std::chrono::steady_clock::time_point& pNow) const {
+    // nothing published yet
+    if (mDeadbandValues.empty())
+        return false;
+
+    std::vector<uint16_t> rawValues;
+    size_t idx = 0;
+    for(const MqttObjectDataNode& node: mState.getNodes()) {
+        const std::shared_ptr<MqttValueDeadband>& deadband(node.getDeadband());
+        if (deadband == nullptr) {
+            node.appendRawValues(rawValues);
+            continue;
+        }
+        if (deadband->mKeepalive != std::chrono::milliseconds::zero() && pNow - mLastPublishTime >= deadband->mKeepalive)
+            return false;
+        if (!deadband->isWithin(mDeadbandValues[idx++], node.getConvertedValue()))
+            return false;
+    }
+    return rawValues == mPublishedRawValues;
+}
+
+bool
+MqttObject::hasDeadbandKeepalive() const {
+    const MqttObjectDataNodeList& nodes(mState.getNodes());
+    return std::any_of(nodes.begin(), nodes.end(), [](const MqttObjectDataNode& node) -> bool {
+        return node.getDeadband() != nullptr && node.getDeadband()->mKeepalive != std::chrono::milliseconds::zero();
+    });
+}
+
+std::chrono::steady_clock::time_point
+MqttObject::getDeadbandKeepaliveTime() const {
+    std::chrono::steady_clock::time_point ret = std::chrono::steady_clock::time_point::max();
+    for(const MqttObjectDataNode& node: mState.getNodes()) {
+        const std::shared_ptr<MqttValueDeadband>& deadband(node.getDeadband());
+        if (deadband != nullptr && deadband->mKeepalive != std::chrono::milliseconds::zero())
+            ret = std::min(ret, mLastPublishTime + deadband->mKeepalive);
+    }
+    return ret;
+}
+
+void
+MqttObject::setAggregate(const std::shared_ptr<MqttAggregate>& pAggregate) {
+    mAggregate = pAggregate;
+    mAggregate->setValueCount(mState.getNodes().size());
+}
+
+void
+MqttObject::addAggregateSample(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const MqttObjectDataNodeList& nodes(mState.getNodes());
+    for(size_t i = 0; i < nodes.size(); i++) {
+        // nodes polled separately are sampled only when read
+        if (!nodes[i].hasRegisterIn(pNetworkName, pRange))
+            continue;
+        try {
+            mAggregate->addSample(i, nodes[i].getConvertedValue(), now);
+        } catch (const ConvException& ex) {
+            BOOST_LOG_SEV(log, Log::error) << "Cannot aggregate value for " << mStateTopic << ": " << ex.what();
+        }
+    }
+}
+
 void
 MqttObject::setPublishMode(const PublishMode& pMode, std::chrono::milliseconds pEveryPollRefresh) {
     mPublishMode = pMode;
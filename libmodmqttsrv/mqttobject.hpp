@@ -8,6 +8,7 @@
 
 #include "modbus_messages.hpp"
 #include "common.hpp"
+#include "mqttaggregate.hpp"
 #include "libmodmqttconv/converter.hpp"
 
 namespace modmqttd {
@@ -83,6 +84,26 @@ class MqttObjectRegisterValue {
         uint16_t mValue;
 };
 
+/**
+ * Changes of converted value not greater than mThreshold
+ * (or mThreshold percent of the last published value) are
+ * not published, unless mKeepalive passed since last publish.
+ */
+class MqttValueDeadband {
+    public:
+        MqttValueDeadband(double pThreshold, bool pPercent)
+            : mThreshold(pThreshold),
+              mPercent(pPercent)
+        {}
+
+        bool isWithin(const MqttValue& pOld, const MqttValue& pNew) const;
+
+        double mThreshold;
+        bool mPercent;
+        // zero disables keepalive
+        std::chrono::milliseconds mKeepalive = std::chrono::milliseconds::zero();
+};
+
 class MqttObjectDataNode;
 
 /**
@@ -104,6 +125,7 @@ class MqttObjectDataNode {
     public:
         bool updateRegisterValues(const std::string& pNetworkName, const MsgRegisterValues& pSlaveData);
         bool updateRegistersReadFailed(const std::string& pNetworkName, const ModbusSlaveAddressRange& pSlaveData);
+        bool clearRegisterValues(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange);
         bool setModbusNetworkState(const std::string& networkName, bool isUp);
 
         bool hasRegisterIn(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange) const;
@@ -117,12 +139,17 @@ class MqttObjectDataNode {
         void setConverter(std::shared_ptr<DataConverter> conv) { mConverter = conv; }
         bool hasConverter() const { return mConverter != nullptr; }
 
+        void setDeadband(const std::shared_ptr<MqttValueDeadband>& pDeadband) { mDeadband = pDeadband; }
+        const std::shared_ptr<MqttValueDeadband>& getDeadband() const { return mDeadband; }
+
         bool isScalar() const { return mNodes.size() == 0; }
         void addChildDataNode(const MqttObjectDataNode& pNode, bool forceList = false);
         void setScalarNode(const MqttObjectRegisterIdent& ident);
         const MqttObjectDataNodeList& getChildNodes() const { return mNodes; }
         MqttValue getConvertedValue() const;
         uint16_t getRawValue() const;
+        // append raw values of all registers used by this node
+        void appendRawValues(std::vector<uint16_t>& pValues) const;
     private:
         // if not empty then json value is published as json object
         //
@@ -152,6 +179,11 @@ class MqttObjectDataNode {
          * A converter used to convert mValue or list of scalars on mNodes list
         */
         std::shared_ptr<DataConverter> mConverter;
+
+        /**
+         * Deadband applied to converted value
+        */
+        std::shared_ptr<MqttValueDeadband> mDeadband;
 };
 
 class MqttObjectState {
@@ -161,6 +193,7 @@ class MqttObjectState {
         bool usesModbusNetwork(const std::string& networkName) const;
         bool updateRegisterValues(const std::string& pNetworkName, const MsgRegisterValues& pSlaveData);
         bool updateRegistersReadFailed(const std::string& pNetworkName, const ModbusSlaveAddressRange& pSlaveData);
+        bool clearRegisterValues(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange);
         bool setModbusNetworkState(const std::string& networkName, bool isUp);
         bool hasAllValues() const;
         bool isPolling() const;
@@ -182,6 +215,8 @@ class MqttObjectAvailability : public MqttObjectState {
 
 class MqttObject {
     public:
+        static boost::log::sources::severity_logger<Log::severity> log;
+
         MqttObject(const std::string& pTopic);
         const std::string& getTopic() const { return mTopic; };
         const std::string& getStateTopic() const { return mStateTopic; };
@@ -194,22 +229,82 @@ class MqttObject {
         void addAvailabilityDataNode(const MqttObjectDataNode& pNode) { mAvailability.addDataNode(pNode); }
         void setAvailableValue(const MqttValue& pValue) { mAvailability.setAvailableValue(pValue); }
         AvailableFlag getAvailableFlag() const { return mIsAvailable; }
+        // availability computed from availability registers only
+        AvailableFlag getAvailabilityRegistersFlag() const { return mAvailability.getAvailableFlag(); }
+        bool hasAvailabilityRegisterIn(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange) const {
+            return mAvailability.hasRegisterIn(pNetworkName, pRange);
+        }
+
+        // stop polling state registers when availability registers report unavailable state
+        void setSkipStatePoll(bool pFlag) { mSkipStatePoll = pFlag; }
+        bool getSkipStatePoll() const { return mSkipStatePoll; }
+        // forget state values when state registers are not polled
+        void clearStateValues(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange);
 
         void setLastPublishedPayload(const std::string& pVal) {
             mLastPublishedPayload = pVal;
             mLastPublishTime = std::chrono::steady_clock::now();
+            mDeadbandSuppressed = false;
+            saveDeadbandValues();
         }
         const std::string& getLastPublishedPayload() const { return mLastPublishedPayload; }
+        const std::chrono::steady_clock::time_point& getLastPublishTime() const { return mLastPublishTime; }
+
+        /**
+         * State changes inside interval after last publish
+         * are coalesced and the latest state is published
+         * when interval expires, see MqttClient::publishThrottledStates()
+         */
+        void setMinPublishInterval(const std::chrono::milliseconds& pInterval) { mMinPublishInterval = pInterval; }
+        const std::chrono::milliseconds& getMinPublishInterval() const { return mMinPublishInterval; }
+        bool isThrottled() const { return mMinPublishInterval != std::chrono::milliseconds::zero(); }
+        std::chrono::steady_clock::time_point getNextPublishTime() const { return mLastPublishTime + mMinPublishInterval; }
+
+        void setPendingPublish(bool pFlag, bool pForce = false) { mPendingPublish = pFlag; mPendingForce = pForce; }
+        bool hasPendingPublish() const { return mPendingPublish; }
+        bool isPendingPublishForced() const { return mPendingForce; }
 
         void setPublishMode(const PublishMode& pMode, std::chrono::milliseconds pEveryPollRefresh);
 
         const PublishMode& getPublishMode() const { return mPublishMode; }
 
+        // objects with higher priority are republished first after broker reconnect
+        void setPriority(CommandPriority pPriority) { mPriority = pPriority; }
+        CommandPriority getPriority() const { return mPriority; }
+
         void setRetain(bool pFlag) { mRetain = pFlag; }
         bool getRetain() const { return mRetain; }
 
+        // format of state payload that is not a single scalar value for JSON
+        void setPayloadFormat(PayloadFormat pFormat) { mPayloadFormat = pFormat; }
+        PayloadFormat getPayloadFormat() const { return mPayloadFormat; }
+
+        void setQos(int pQos) { mQos = pQos; }
+        int getQos() const { return mQos; }
+
         bool needStateRepublish() const;
 
+        /**
+         * True if only converted state values with deadband changed
+         * since the last publish and their changes are within deadband
+         */
+        bool isWithinDeadband(const std::chrono::steady_clock::time_point& pNow) const;
+        bool hasDeadbandKeepalive() const;
+        // time point when the earliest deadband keepalive expires
+        std::chrono::steady_clock::time_point getDeadbandKeepaliveTime() const;
+        // state change was not published because of deadband
+        void setDeadbandSuppressed(bool pFlag) { mDeadbandSuppressed = pFlag; }
+        bool isDeadbandSuppressed() const { return mDeadbandSuppressed; }
+
+        /**
+         * Publish state aggregated over time window
+         * instead of every state change
+         */
+        void setAggregate(const std::shared_ptr<MqttAggregate>& pAggregate);
+        bool isAggregated() const { return mAggregate != nullptr; }
+        MqttAggregate& getAggregate() { return *mAggregate; }
+        const MqttAggregate& getAggregate() const { return *mAggregate; }
+
         MqttObjectState mState;
 
         void dump() const;
@@ -223,12 +318,31 @@ class MqttObject {
         AvailableFlag mIsAvailable = AvailableFlag::NotSet;
 
         bool mRetain = true;
+        int mQos = 0;
+        PayloadFormat mPayloadFormat = PayloadFormat::JSON;
+        bool mSkipStatePoll = false;
+        CommandPriority mPriority = CommandPriority::NORMAL;
         PublishMode mPublishMode;
         std::string mLastPublishedPayload;
         std::chrono::steady_clock::time_point mLastPublishTime = std::chrono::steady_clock::time_point::min();
         std::chrono::milliseconds mEveryPollPeriod;
 
+        std::shared_ptr<MqttAggregate> mAggregate;
+
+        std::chrono::milliseconds mMinPublishInterval = std::chrono::milliseconds::zero();
+        bool mPendingPublish = false;
+        bool mPendingForce = false;
+
+        // state values of the last publish, converted values
+        // of nodes with deadband and raw values of other nodes
+        std::vector<MqttValue> mDeadbandValues;
+        std::vector<uint16_t> mPublishedRawValues;
+        bool mDeadbandSuppressed = false;
+
         void updateAvailablityFlag();
+        void saveDeadbandValues();
+        // add sample for every state node with register in pRange
+        void addAggregateSample(const std::string& pNetworkName, const ModbusSlaveAddressRange& pRange);
 };
 
 
@@ -1,8 +1,12 @@
 #include "mqttpayload.hpp"
 
+#include <cmath>
+
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+#include "payload_encoders.hpp"
+
 
 namespace modmqttd {
 
@@ -17,8 +21,8 @@ createConvertedValue(
             break;
         case MqttValue::SourceType::DOUBLE: {
             int prec = value.getDoublePrecision();
-            if (prec != MqttValue::NO_PRECISION)
-                writer.SetMaxDecimalPlaces(prec);
+            // writer can be reused for many values
+            writer.SetMaxDecimalPlaces(prec != MqttValue::NO_PRECISION ? prec : rapidjson::Writer<rapidjson::StringBuffer>::kDefaultMaxDecimalPlaces);
             writer.Double(value.getDouble());
             break;
         }
@@ -77,10 +81,146 @@ generateJson(rapidjson::Writer<rapidjson::StringBuffer>& pWriter, const MqttObje
 }
 
 
+void
+generateAggregateJson(rapidjson::Writer<rapidjson::StringBuffer>& pWriter, const MqttAggregate& pAggregate, int pIdx) {
+    const MqttAggregate::Accumulator& acc(pAggregate.getAccumulator(pIdx));
+    pWriter.StartObject();
+    for(MqttAggregate::Function func: pAggregate.getFunctions()) {
+        pWriter.Key(MqttAggregate::getFunctionName(func));
+        if (acc.mCount == 0) {
+            pWriter.Null();
+            continue;
+        }
+        double val;
+        switch(func) {
+            case MqttAggregate::Function::MIN: val = acc.mMin; break;
+            case MqttAggregate::Function::MAX: val = acc.mMax; break;
+            case MqttAggregate::Function::AVG: val = acc.mSum / acc.mCount; break;
+            case MqttAggregate::Function::LAST: val = acc.mLast; break;
+        }
+        if (acc.mIsInteger && func != MqttAggregate::Function::AVG) {
+            pWriter.Int64(int64_t(val));
+        } else {
+            // writer is reused for all nodes
+            pWriter.SetMaxDecimalPlaces(acc.mPrecision != MqttValue::NO_PRECISION ? acc.mPrecision : rapidjson::Writer<rapidjson::StringBuffer>::kDefaultMaxDecimalPlaces);
+            pWriter.Double(val);
+        }
+    }
+    pWriter.EndObject();
+}
+
+
+std::string
+MqttPayload::generateAggregate(const MqttObject& pObj) {
+    const MqttObjectDataNodeList& nodes(pObj.mState.getNodes());
+    const MqttAggregate& aggregate(pObj.getAggregate());
+
+    rapidjson::StringBuffer ret;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(ret);
+    if (isMap(nodes)) {
+        writer.StartObject();
+        for(size_t i = 0; i < nodes.size(); i++) {
+            writer.Key(nodes[i].getName().c_str());
+            generateAggregateJson(writer, aggregate, i);
+        }
+        writer.EndObject();
+    } else if (nodes.outputAsList()) {
+        writer.StartArray();
+        for(size_t i = 0; i < nodes.size(); i++)
+            generateAggregateJson(writer, aggregate, i);
+        writer.EndArray();
+    } else {
+        generateAggregateJson(writer, aggregate, 0);
+    }
+    return ret.GetString();
+}
+
+
+void
+MqttPayload::generateState(rapidjson::Writer<rapidjson::StringBuffer>& pWriter, const MqttObject& pObj) {
+    if (pObj.getAvailableFlag() != AvailableFlag::True || pObj.mState.getNodes().size() == 0)
+        pWriter.Null();
+    else
+        generateJson(pWriter, pObj.mState.getNodes());
+}
+
+
+template <typename Encoder>
+void
+encodeValue(Encoder& pEncoder, const MqttValue& pValue) {
+    switch(pValue.getSourceType()) {
+        case MqttValue::SourceType::INT:
+            pEncoder.integer(pValue.getInt());
+            break;
+        case MqttValue::SourceType::INT64:
+            pEncoder.integer(pValue.getInt64());
+            break;
+        case MqttValue::SourceType::DOUBLE: {
+            double val = pValue.getDouble();
+            // the same value as in JSON, and a chance for shorter float encoding
+            int prec = pValue.getDoublePrecision();
+            if (prec != MqttValue::NO_PRECISION) {
+                double scale = std::pow(10, prec);
+                val = std::round(val * scale) / scale;
+            }
+            pEncoder.real(val);
+            break;
+        }
+        case MqttValue::SourceType::BINARY:
+            pEncoder.string(static_cast<const char*>(pValue.getBinaryPtr()), pValue.getBinarySize());
+            break;
+    }
+}
+
+
+template <typename Encoder>
+void
+generateBinary(Encoder& pEncoder, const MqttObjectDataNodeList& pNodes) {
+    if (isMap(pNodes)) {
+        pEncoder.startMap(pNodes.size());
+        for(const MqttObjectDataNode& node: pNodes) {
+            pEncoder.key(node.getName());
+            if (node.isScalar() || node.hasConverter())
+                encodeValue(pEncoder, node.getConvertedValue());
+            else
+                generateBinary(pEncoder, node.getChildNodes());
+        }
+    } else if (isList(pNodes)) {
+        pEncoder.startArray(pNodes.size());
+        for(const MqttObjectDataNode& node: pNodes) {
+            if (node.isScalar() || node.hasConverter())
+                encodeValue(pEncoder, node.getConvertedValue());
+            else
+                generateBinary(pEncoder, node.getChildNodes());
+        }
+    } else {
+        //single scalar
+        encodeValue(pEncoder, pNodes.front().getConvertedValue());
+    }
+}
+
+
 std::string
 MqttPayload::generate(const MqttObject& pObj) {
     const MqttObjectDataNodeList& nodes(pObj.mState.getNodes());
 
+    switch(pObj.getPayloadFormat()) {
+        case PayloadFormat::CBOR: {
+            std::string ret;
+            CborEncoder encoder(ret);
+            generateBinary(encoder, nodes);
+            return ret;
+        }
+        case PayloadFormat::MSGPACK: {
+            std::string ret;
+            MsgPackEncoder encoder(ret);
+            generateBinary(encoder, nodes);
+            return ret;
+        }
+        default:
+            break;
+    }
+
 
     if (!nodes.outputAsList()) {
         const MqttObjectDataNode& single(nodes[0]);
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
 #include "mqttobject.hpp"
 
 namespace modmqttd {
@@ -7,6 +10,10 @@ namespace modmqttd {
 class MqttPayload {
     public:
         static std::string generate(const MqttObject& pObj);
+        // JSON object with aggregate function results for every state value
+        static std::string generateAggregate(const MqttObject& pObj);
+        // JSON value of object state, null if object is not available
+        static void generateState(rapidjson::Writer<rapidjson::StringBuffer>& pWriter, const MqttObject& pObj);
 
 };
 
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace modmqttd {
+
+/**
+ * Minimal streaming encoders for binary payload formats.
+ * Container sizes must be known before elements are written.
+ */
+
+class PayloadEncoder {
+    public:
+        PayloadEncoder(std::string& pOut) : mOut(pOut) {}
+    protected:
+        std::string& mOut;
+
+        void putByte(uint8_t pByte) { mOut.push_back(static_cast<char>(pByte)); }
+        // big endian, as required by both formats
+        void putBigEndian(uint64_t pValue, int pBytes) {
+            for(int i = pBytes - 1; i >= 0; i--)
+                putByte(uint8_t(pValue >> (i * 8)));
+        }
+        static uint32_t floatBits(float pValue) {
+            uint32_t ret;
+            memcpy(&ret, &pValue, sizeof(ret));
+            return ret;
+        }
+        static uint64_t doubleBits(double pValue) {
+            uint64_t ret;
+            memcpy(&ret, &pValue, sizeof(ret));
+            return ret;
+        }
+};
+
+
+// RFC 8949
+class CborEncoder : public PayloadEncoder {
+    public:
+        CborEncoder(std::string& pOut) : PayloadEncoder(pOut) {}
+
+        void startMap(size_t pSize) { putHead(5, pSize); }
+        void startArray(size_t pSize) { putHead(4, pSize); }
+        void key(const std::string& pKey) { string(pKey.c_str(), pKey.length()); }
+        void string(const char* pData, size_t pLength) {
+            putHead(3, pLength);
+            mOut.append(pData, pLength);
+        }
+        void integer(int64_t pValue) {
+            if (pValue >= 0)
+                putHead(0, pValue);
+            else
+                putHead(1, uint64_t(-1 - pValue));
+        }
+        void real(double pValue) {
+            // single precision if it does not lose anything
+            float f = static_cast<float>(pValue);
+            if (double(f) == pValue) {
+                putByte(0xfa);
+                putBigEndian(floatBits(f), 4);
+            } else {
+                putByte(0xfb);
+                putBigEndian(doubleBits(pValue), 8);
+            }
+        }
+        void null() { putByte(0xf6); }
+    private:
+        void putHead(uint8_t pMajor, uint64_t pValue) {
+            uint8_t major = pMajor << 5;
+            if (pValue < 24) {
+                putByte(major | pValue);
+            } else if (pValue <= 0xff) {
+                putByte(major | 24);
+                putBigEndian(pValue, 1);
+            } else if (pValue <= 0xffff) {
+                putByte(major | 25);
+                putBigEndian(pValue, 2);
+            } else if (pValue <= 0xffffffff) {
+                putByte(major | 26);
+                putBigEndian(pValue, 4);
+            } else {
+                putByte(major | 27);
+                putBigEndian(pValue, 8);
+            }
+        }
+};
+
+
+// https://github.com/msgpack/msgpack/blob/master/spec.md
+class MsgPackEncoder : public PayloadEncoder {
+    public:
+        MsgPackEncoder(std::string& pOut) : PayloadEncoder(pOut) {}
+
+        void startMap(size_t pSize) { putContainer(0x80, 15, 0xde, pSize); }
+        void startArray(size_t pSize) { putContainer(0x90, 15, 0xdc, pSize); }
+        void key(const std::string& pKey) { string(pKey.c_str(), pKey.length()); }
+        void string(const char* pData, size_t pLength) {
+            if (pLength < 32) {
+                putByte(0xa0 | pLength);
+            } else if (pLength <= 0xff) {
+                putByte(0xd9);
+                putBigEndian(pLength, 1);
+            } else if (pLength <= 0xffff) {
+                putByte(0xda);
+                putBigEndian(pLength, 2);
+            } else {
+                putByte(0xdb);
+                putBigEndian(pLength, 4);
+            }
+            mOut.append(pData, pLength);
+        }
+        void integer(int64_t pValue) {
+            if (pValue >= 0) {
+                if (pValue < 128) {
+                    putByte(pValue);
+                } else if (pValue <= 0xff) {
+                    putByte(0xcc);
+                    putBigEndian(pValue, 1);
+                } else if (pValue <= 0xffff) {
+                    putByte(0xcd);
+                    putBigEndian(pValue, 2);
+                } else if (pValue <= 0xffffffff) {
+                    putByte(0xce);
+                    putBigEndian(pValue, 4);
+                } else {
+                    putByte(0xcf);
+                    putBigEndian(pValue, 8);
+                }
+            } else if (pValue >= -32) {
+                putByte(uint8_t(int8_t(pValue)));
+            } else if (pValue >= INT8_MIN) {
+                putByte(0xd0);
+                putBigEndian(uint64_t(pValue), 1);
+            } else if (pValue >= INT16_MIN) {
+                putByte(0xd1);
+                putBigEndian(uint64_t(pValue), 2);
+            } else if (pValue >= INT32_MIN) {
+                putByte(0xd2);
+                putBigEndian(uint64_t(pValue), 4);
+            } else {
+                putByte(0xd3);
+                putBigEndian(uint64_t(pValue), 8);
+            }
+        }
+        void real(double pValue) {
+            float f = static_cast<float>(pValue);
+            if (double(f) == pValue) {
+                putByte(0xca);
+                putBigEndian(floatBits(f), 4);
+            } else {
+                putByte(0xcb);
+                putBigEndian(doubleBits(pValue), 8);
+            }
+        }
+        void null() { putByte(0xc0); }
+    private:
+        void putContainer(uint8_t pFixMarker, size_t pFixMax, uint8_t pMarker16, size_t pSize) {
+            if (pSize <= pFixMax) {
+                putByte(pFixMarker | pSize);
+            } else if (pSize <= 0xffff) {
+                putByte(pMarker16);
+                putBigEndian(pSize, 2);
+            } else {
+                // 32 bit marker follows 16 bit one
+                putByte(pMarker16 + 1);
+                putBigEndian(pSize, 4);
+            }
+        }
+};
+
+}
@@ -0,0 +1,282 @@
+#include "publish_buffer.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <boost/crc.hpp>
+
+#include "exceptions.hpp"
+
+namespace modmqttd {
+
+boost::log::sources::severity_logger<Log::severity> PublishBuffer::log;
+
+static constexpr uint32_t FILE_MAGIC = 0x424d514d; // MQMB
+static constexpr uint32_t FILE_VERSION = 1;
+static constexpr uint32_t RECORD_MAGIC = 0x5245434d;
+static constexpr uint32_t WRAP_MAGIC = 0x5052574d;
+static constexpr uint64_t RECORD_ALIGN = 8;
+
+PublishBuffer::PublishBuffer(const std::string& pPath, size_t pMaxSize)
+    : mPath(pPath)
+{
+    if (pMaxSize < sizeof(FileHeader) + sizeof(RecordHeader) * 4)
+        throw PublishBufferException(std::string("Buffer size ") + std::to_string(pMaxSize) + " is too small");
+
+    mCapacity = (pMaxSize - sizeof(FileHeader)) / RECORD_ALIGN * RECORD_ALIGN;
+    mMapSize = sizeof(FileHeader) + mCapacity;
+
+    mFd = open(mPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (mFd == -1)
+        throw PublishBufferException(std::string("Cannot open buffer file ") + mPath + ": " + strerror(errno));
+
+    struct stat st;
+    bool reinit = fstat(mFd, &st) != 0 || size_t(st.st_size) != mMapSize;
+    if (reinit && ftruncate(mFd, mMapSize) != 0) {
+        close(mFd);
+        throw PublishBufferException(std::string("Cannot resize buffer file ") + mPath + ": " + strerror(errno));
+    }
+
+    void* map = mmap(nullptr, mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (map == MAP_FAILED) {
+        close(mFd);
+        throw PublishBufferException(std::string("Cannot map buffer file ") + mPath + ": " + strerror(errno));
+    }
+    mMap = static_cast<uint8_t*>(map);
+    mHeader = reinterpret_cast<FileHeader*>(mMap);
+    mData = mMap + sizeof(FileHeader);
+
+    if (reinit || mHeader->mMagic != FILE_MAGIC || mHeader->mVersion != FILE_VERSION
+        || mHeader->mCapacity != mCapacity || mHeader->mReadPos >= mCapacity)
+    {
+        if (!reinit)
+            BOOST_LOG_SEV(log, Log::warn) << "Buffer file " << mPath << " has invalid header, discarding its content";
+        initHeader();
+    } else {
+        recover();
+    }
+}
+
+
+PublishBuffer::~PublishBuffer() {
+    if (mMap != nullptr) {
+        msync(mMap, mMapSize, MS_SYNC);
+        munmap(mMap, mMapSize);
+    }
+    if (mFd != -1)
+        close(mFd);
+}
+
+
+void
+PublishBuffer::initHeader() {
+    mHeader->mMagic = FILE_MAGIC;
+    mHeader->mVersion = FILE_VERSION;
+    mHeader->mCapacity = mCapacity;
+    mHeader->mReadPos = 0;
+    mHeader->mReadSeq = 0;
+    // old records must not be recovered after restart
+    memset(mData, 0, mCapacity);
+    mWritePos = 0;
+    mNextSeq = 0;
+    mCount = 0;
+}
+
+
+void
+PublishBuffer::recover() {
+    uint64_t pos = normalizePos(mHeader->mReadPos);
+    uint64_t seq = mHeader->mReadSeq;
+    mHeader->mReadPos = pos;
+    mCount = 0;
+    // stops on the first record that was not written after
+    // the oldest one or on a record damaged by crash during write
+    while(true) {
+        const RecordHeader* rec = validRecordAt(pos, seq);
+        if (rec == nullptr)
+            break;
+        mWritePos = pos + recordSize(rec->mTopicLength, rec->mPayloadLength);
+        pos = normalizePos(mWritePos);
+        seq++;
+        mCount++;
+    }
+
+    if (mCount == 0) {
+        mHeader->mReadPos = 0;
+        mWritePos = 0;
+    }
+    mNextSeq = seq;
+
+    BOOST_LOG_SEV(log, Log::info) << "Recovered " << mCount << " buffered messages from " << mPath;
+}
+
+
+uint64_t
+PublishBuffer::normalizePos(uint64_t pPos) const {
+    if (pPos >= mCapacity || mCapacity - pPos < sizeof(RecordHeader))
+        return 0;
+    const RecordHeader* rec = reinterpret_cast<const RecordHeader*>(mData + pPos);
+    if (rec->mMagic == WRAP_MAGIC)
+        return 0;
+    return pPos;
+}
+
+
+uint64_t
+PublishBuffer::recordSize(uint32_t pTopicLength, uint32_t pPayloadLength) {
+    uint64_t size = sizeof(RecordHeader) + pTopicLength + pPayloadLength;
+    return (size + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN;
+}
+
+
+uint32_t
+PublishBuffer::checksum(const RecordHeader& pHeader) {
+    boost::crc_32_type crc;
+    const uint8_t* start = reinterpret_cast<const uint8_t*>(&pHeader.mSeq);
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(&pHeader) + sizeof(RecordHeader) + pHeader.mTopicLength + pHeader.mPayloadLength;
+    crc.process_block(start, end);
+    return crc.checksum();
+}
+
+
+const PublishBuffer::RecordHeader*
+PublishBuffer::validRecordAt(uint64_t pPos, uint64_t pSeq) const {
+    const RecordHeader* rec = reinterpret_cast<const RecordHeader*>(mData + pPos);
+    if (rec->mMagic != RECORD_MAGIC || rec->mSeq != pSeq)
+        return nullptr;
+    if (uint64_t(rec->mTopicLength) + rec->mPayloadLength > mCapacity - pPos - sizeof(RecordHeader))
+        return nullptr;
+    if (checksum(*rec) != rec->mCrc)
+        return nullptr;
+    return rec;
+}
+
+
+uint64_t
+PublishBuffer::freeSpace() const {
+    if (mCount == 0)
+        return mCapacity;
+    if (mHeader->mReadPos == mWritePos)
+        return 0;
+    return (mHeader->mReadPos + mCapacity - mWritePos) % mCapacity;
+}
+
+
+void
+PublishBuffer::dropOldest() {
+    const RecordHeader* rec = reinterpret_cast<const RecordHeader*>(mData + mHeader->mReadPos);
+    uint64_t next = mHeader->mReadPos + recordSize(rec->mTopicLength, rec->mPayloadLength);
+    mCount--;
+    mHeader->mReadSeq++;
+    if (mCount == 0) {
+        mHeader->mReadPos = 0;
+        mWritePos = 0;
+    } else {
+        mHeader->mReadPos = normalizePos(next);
+    }
+}
+
+
+void
+PublishBuffer::append(const std::string& pTopic, const void* pData, int pLen, bool pRetain, int pQos) {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    uint64_t size = recordSize(pTopic.length(), pLen);
+    if (size > mCapacity) {
+        BOOST_LOG_SEV(log, Log::error) << "Message for " << pTopic << " is bigger than buffer size, dropping";
+        mDroppedCount++;
+        return;
+    }
+
+    // do not leave a record split at the end of data
+    bool wrap = mWritePos + size > mCapacity;
+    uint64_t required = wrap ? (mCapacity - mWritePos) + size : size;
+    while(mCount != 0 && freeSpace() < required) {
+        dropOldest();
+        mDroppedCount++;
+        wrap = mWritePos + size > mCapacity;
+        required = wrap ? (mCapacity - mWritePos) + size : size;
+    }
+
+    if (wrap) {
+        if (mCapacity - mWritePos >= sizeof(RecordHeader))
+            reinterpret_cast<RecordHeader*>(mData + mWritePos)->mMagic = WRAP_MAGIC;
+        mWritePos = 0;
+    }
+
+    RecordHeader* rec = reinterpret_cast<RecordHeader*>(mData + mWritePos);
+    // invalidate record before writing its content
+    rec->mMagic = 0;
+    rec->mSeq = mNextSeq;
+    rec->mTopicLength = pTopic.length();
+    rec->mPayloadLength = pLen;
+    rec->mRetain = pRetain ? 1 : 0;
+    rec->mQos = pQos;
+    memset(rec->mReserved, 0, sizeof(rec->mReserved));
+    uint8_t* data = mData + mWritePos + sizeof(RecordHeader);
+    memcpy(data, pTopic.c_str(), pTopic.length());
+    if (pLen != 0)
+        memcpy(data + pTopic.length(), pData, pLen);
+    rec->mCrc = checksum(*rec);
+    rec->mMagic = RECORD_MAGIC;
+
+    if (mCount == 0) {
+        mHeader->mReadPos = mWritePos;
+        mHeader->mReadSeq = mNextSeq;
+    }
+    mWritePos += size;
+    mNextSeq++;
+    mCount++;
+
+    msync(mMap, mMapSize, MS_ASYNC);
+}
+
+
+bool
+PublishBuffer::front(Entry& pOut) const {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mCount == 0)
+        return false;
+
+    const RecordHeader* rec = reinterpret_cast<const RecordHeader*>(mData + mHeader->mReadPos);
+    const char* data = reinterpret_cast<const char*>(rec) + sizeof(RecordHeader);
+    pOut.mTopic.assign(data, rec->mTopicLength);
+    pOut.mPayload.assign(data + rec->mTopicLength, rec->mPayloadLength);
+    pOut.mRetain = rec->mRetain != 0;
+    pOut.mQos = rec->mQos;
+    return true;
+}
+
+
+void
+PublishBuffer::pop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mCount != 0)
+        dropOldest();
+}
+
+
+bool
+PublishBuffer::empty() const {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mCount == 0;
+}
+
+
+size_t
+PublishBuffer::getCount() const {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mCount;
+}
+
+
+uint64_t
+PublishBuffer::getDroppedCount() const {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mDroppedCount;
+}
+
+}
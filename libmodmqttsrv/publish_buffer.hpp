@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <cstdint>
+
+#include "logging.hpp"
+
+namespace modmqttd {
+
+/**
+ * Append-only ring of mqtt publishes stored in a memory mapped file.
+ * Used to keep state changes while mqtt broker is not available.
+ *
+ * Every record has a sequence number and a CRC32 checksum. Only
+ * position and sequence number of the oldest record are stored
+ * in file header. After restart the write position is recovered
+ * by scanning records from the oldest one until sequence number
+ * or checksum does not match.
+ *
+ * When file is full the oldest records are dropped.
+ */
+class PublishBuffer {
+    public:
+        static boost::log::sources::severity_logger<Log::severity> log;
+
+        struct Entry {
+            std::string mTopic;
+            std::string mPayload;
+            bool mRetain = false;
+            int mQos = 0;
+        };
+
+        PublishBuffer(const std::string& pPath, size_t pMaxSize);
+        ~PublishBuffer();
+
+        void append(const std::string& pTopic, const void* pData, int pLen, bool pRetain, int pQos = 0);
+
+        // read the oldest record without removing it
+        bool front(Entry& pOut) const;
+        void pop();
+
+        bool empty() const;
+        size_t getCount() const;
+        uint64_t getDroppedCount() const;
+    private:
+        struct FileHeader {
+            uint32_t mMagic;
+            uint32_t mVersion;
+            uint64_t mCapacity;
+            uint64_t mReadPos;
+            uint64_t mReadSeq;
+        };
+
+        struct RecordHeader {
+            uint32_t mMagic;
+            // checksum of all bytes after this field
+            uint32_t mCrc;
+            uint64_t mSeq;
+            uint32_t mTopicLength;
+            uint32_t mPayloadLength;
+            uint8_t mRetain;
+            uint8_t mQos;
+            uint8_t mReserved[6];
+        };
+
+        std::string mPath;
+        int mFd = -1;
+        uint8_t* mMap = nullptr;
+        size_t mMapSize = 0;
+
+        FileHeader* mHeader = nullptr;
+        uint8_t* mData = nullptr;
+        uint64_t mCapacity = 0;
+
+        uint64_t mWritePos = 0;
+        uint64_t mNextSeq = 0;
+        size_t mCount = 0;
+        uint64_t mDroppedCount = 0;
+
+        mutable std::mutex mMutex;
+
+        void initHeader();
+        void recover();
+        // skip to the beginning of data if there is a wrap marker or no space for record at pPos
+        uint64_t normalizePos(uint64_t pPos) const;
+        const RecordHeader* validRecordAt(uint64_t pPos, uint64_t pSeq) const;
+        static uint64_t recordSize(uint32_t pTopicLength, uint32_t pPayloadLength);
+        static uint32_t checksum(const RecordHeader& pHeader);
+        uint64_t freeSpace() const;
+        void dropOldest();
+};
+
+}
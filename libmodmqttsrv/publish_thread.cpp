@@ -0,0 +1,60 @@
+#include "publish_thread.hpp"
+
+#include <vector>
+
+namespace modmqttd {
+
+boost::log::sources::severity_logger<Log::severity> PublishThread::log;
+
+PublishThread::PublishThread(const Sender& pSender)
+    : mSender(pSender), mDepth(0), mMaxDepth(0)
+{
+    mThread.reset(new std::thread(&PublishThread::run, this));
+}
+
+
+void
+PublishThread::enqueue(Message&& pMsg) {
+    // the only writer, no need for compare and swap
+    int depth = ++mDepth;
+    if (depth > mMaxDepth)
+        mMaxDepth = depth;
+    mQueue.enqueue(std::move(pMsg));
+}
+
+
+void
+PublishThread::stop() {
+    if (mThread == nullptr)
+        return;
+    mQueue.enqueue(Message());
+    mThread->join();
+    mThread.reset();
+    BOOST_LOG_SEV(log, Log::debug) << "Publish thread stopped";
+}
+
+
+void
+PublishThread::run() {
+    std::vector<Message> batch;
+    batch.reserve(MAX_BATCH_SIZE);
+    Message msg;
+    while(true) {
+        mQueue.wait_dequeue(msg);
+        batch.push_back(std::move(msg));
+        // drain what was queued while we were sending
+        // to wake up once per main loop iteration
+        while(batch.size() < MAX_BATCH_SIZE && mQueue.try_dequeue(msg))
+            batch.push_back(std::move(msg));
+
+        for(const Message& item: batch) {
+            if (item.mTopic.empty())
+                return;
+            mSender(item);
+            mDepth--;
+        }
+        batch.clear();
+    }
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "logging.hpp"
+#include "../readerwriterqueue/readerwriterqueue.h"
+
+namespace modmqttd {
+
+/**
+ * Sends rendered mqtt messages from a dedicated thread, so broker
+ * or network slowness does not delay processing of modbus queues
+ * in the main thread.
+ *
+ * Single producer: messages must be enqueued from the main thread only.
+ */
+class PublishThread {
+    public:
+        static boost::log::sources::severity_logger<Log::severity> log;
+
+        // max number of messages sent per single queue wakeup
+        static constexpr int MAX_BATCH_SIZE = 64;
+
+        struct Message {
+            Message() {}
+            Message(const std::string& pTopic, std::string&& pPayload, bool pRetain, int pQos)
+                : mTopic(pTopic), mPayload(std::move(pPayload)), mRetain(pRetain), mQos(pQos)
+            {}
+            // empty topic stops the thread
+            std::string mTopic;
+            std::string mPayload;
+            bool mRetain = false;
+            int mQos = 0;
+        };
+
+        typedef std::function<void(const Message&)> Sender;
+
+        PublishThread(const Sender& pSender);
+        ~PublishThread() { stop(); }
+
+        void enqueue(Message&& pMsg);
+        // send all queued messages and wait for thread exit
+        void stop();
+
+        // number of messages waiting in queue
+        int getQueueDepth() const { return mDepth; }
+        // max number of messages waiting in queue since the last call
+        int popMaxQueueDepth() { return mMaxDepth.exchange(mDepth); }
+    private:
+        void run();
+
+        Sender mSender;
+        moodycamel::BlockingReaderWriterQueue<Message> mQueue;
+        std::unique_ptr<std::thread> mThread;
+
+        std::atomic<int> mDepth;
+        std::atomic<int> mMaxDepth;
+};
+
+}
@@ -1,8 +1,12 @@
 #include "register_poll.hpp"
 
+#include <algorithm>
+
 namespace modmqttd {
 
 constexpr std::chrono::steady_clock::duration RegisterPoll::DurationBetweenLogError;
+constexpr int RegisterPoll::MaxCoalesceFailures;
+constexpr std::chrono::steady_clock::duration RegisterPoll::CoalesceRetryPeriod;
 
 void
 RegisterCommand::setMaxRetryCounts(short pMaxRead, short pMaxWrite, bool pForce) {
@@ -18,9 +22,121 @@ RegisterPoll::RegisterPoll(int pSlaveId, int pRegNum, RegisterType pRegType, int
       mLastRead(std::chrono::steady_clock::now() - std::chrono::hours(24)),
       mLastValues(pRegCount)
 {
-    mRefresh = pRefreshMsec;
+    mRefresh = mMinRefresh = mMaxRefresh = pRefreshMsec;
     mReadErrors = 0;
     mFirstErrorTime = std::chrono::steady_clock::now();
 };
 
+void
+RegisterPoll::setRefreshRange(const std::chrono::steady_clock::duration& pMin, const std::chrono::steady_clock::duration& pMax) {
+    mRefresh = mMinRefresh = pMin;
+    mMaxRefresh = pMax < pMin ? pMin : pMax;
+}
+
+void
+RegisterPoll::adaptRefresh(bool pValuesChanged) {
+    if (!isAdaptive())
+        return;
+
+    if (pValuesChanged) {
+        mRefresh = mMinRefresh;
+    } else if (mRefresh < mMaxRefresh) {
+        mRefresh *= 2;
+        if (mRefresh > mMaxRefresh)
+            mRefresh = mMaxRefresh;
+    }
+}
+
+void
+RegisterPoll::updateDeadlineStats(const std::chrono::steady_clock::time_point& pStart) {
+    if (isTriggeredOnly())
+        return;
+
+    mDeadlineStats.mPollCount++;
+    auto lateness = pStart - getDeadline();
+    if (lateness <= std::chrono::steady_clock::duration::zero())
+        return;
+
+    mDeadlineStats.mTotalLateness += lateness;
+    if (lateness > mDeadlineStats.mMaxLateness)
+        mDeadlineStats.mMaxLateness = lateness;
+    // the whole poll period is lost
+    if (lateness >= mRefresh)
+        mDeadlineStats.mMissedCount++;
+}
+
+void
+RegisterPoll::setCoalescedReadFailed(const std::chrono::steady_clock::time_point& pNow) {
+    // after retry period a single failure disables coalescing again
+    if (mCoalesceFailures < MaxCoalesceFailures)
+        mCoalesceFailures++;
+    if (mCoalesceFailures == MaxCoalesceFailures)
+        mCoalesceDisabledTime = pNow;
+}
+
+CommandPriority
+RegisterPoll::getEffectivePriority(const std::chrono::steady_clock::time_point& pNow) const {
+    // only low priority polls are aged, so normal and high
+    // priority commands keep their order
+    if (isTriggeredOnly() || mPriority != CommandPriority::LOW)
+        return mPriority;
+
+    auto lateness = pNow - getDeadline();
+    if (mRefresh <= std::chrono::steady_clock::duration::zero() || lateness < mRefresh)
+        return mPriority;
+
+    int level = int(mPriority) + lateness / mRefresh;
+    return level >= int(CommandPriority::HIGH) ? CommandPriority::HIGH : CommandPriority(level);
+}
+
+void
+RegisterPoll::addDependentPoll(const ModbusAddressRange& pTrigger, const std::shared_ptr<RegisterPoll>& pPoll) {
+    mDependentPolls.push_back(DependentPoll(pTrigger, pPoll));
+}
+
+std::vector<std::shared_ptr<RegisterPoll>>
+RegisterPoll::getTriggeredPolls(const std::vector<uint16_t>& pNewValues) const {
+    std::vector<std::shared_ptr<RegisterPoll>> ret;
+    for(const DependentPoll& dep: mDependentPolls) {
+        int first = dep.mTrigger.firstRegister() - mRegister;
+        int last = dep.mTrigger.lastRegister() - mRegister;
+        if (first < 0 || last >= (int)pNewValues.size() || last >= (int)mLastValues.size())
+            continue;
+
+        if (std::equal(pNewValues.begin() + first, pNewValues.begin() + last + 1, mLastValues.begin() + first))
+            continue;
+
+        std::shared_ptr<RegisterPoll> poll(dep.mPoll.lock());
+        if (poll != nullptr && std::find(ret.begin(), ret.end(), poll) == ret.end())
+            ret.push_back(poll);
+    }
+    return ret;
+}
+
+bool
+RegisterPoll::isWithinDeadband(const std::vector<uint16_t>& pNewValues, const std::chrono::steady_clock::time_point& pNow) const {
+    if (mDeadbands.empty() || pNewValues.size() != mLastValues.size())
+        return false;
+
+    for(size_t i = 0; i < pNewValues.size(); i++) {
+        if (pNewValues[i] == mLastValues[i])
+            continue;
+
+        int regNum = mRegister + i;
+        bool covered = false;
+        for(const RegisterDeadband& deadband: mDeadbands) {
+            if (regNum < deadband.firstRegister() || regNum > deadband.lastRegister())
+                continue;
+            if (!deadband.isWithin(mLastValues[i], pNewValues[i]))
+                return false;
+            if (deadband.mKeepalive != std::chrono::milliseconds::zero() && pNow - mLastSendTime >= deadband.mKeepalive)
+                return false;
+            covered = true;
+        }
+        if (!covered)
+            return false;
+    }
+    return true;
+}
+
 } // namespace
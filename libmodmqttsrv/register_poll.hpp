@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <vector>
+#include <memory>
 
 #include "libmodmqttconv/modbusregisters.hpp"
 
@@ -41,10 +42,19 @@ class RegisterCommand : public ModbusAddressRange {
 
         void setMaxRetryCounts(short pMaxRead, short pMaxWrite, bool pForce = false);
 
+        // priority used to order this command at pNow
+        virtual CommandPriority getEffectivePriority(const std::chrono::steady_clock::time_point& pNow) const { return mPriority; }
+
         int mSlaveId;
+        CommandPriority mPriority = CommandPriority::NORMAL;
+
+        short mMaxReadRetryCount = 0;
+        short mMaxWriteRetryCount = 0;
 
-        short mMaxReadRetryCount;
-        short mMaxWriteRetryCount;
+        // retries done after the last failed execution
+        short mRetryCount = 0;
+        // requeued command should not be retried before this time
+        std::chrono::steady_clock::time_point mRetryAfter;
     protected:
         std::chrono::steady_clock::duration mDelayBeforeFirstCommand = std::chrono::steady_clock::duration::zero();
         std::chrono::steady_clock::duration mDelayBeforeCommand = std::chrono::steady_clock::duration::zero();
@@ -56,6 +66,10 @@ class RegisterPoll : public RegisterCommand {
         static constexpr std::chrono::steady_clock::duration DurationBetweenLogError = std::chrono::minutes(5);
         // if we cannot read register in this time MsgRegisterReadFailed is sent
         static constexpr int DefaultReadErrorCount = 3;
+        // covering reads failed in a row before coalescing is disabled
+        static constexpr int MaxCoalesceFailures = 3;
+        // time after which disabled coalescing is tried again
+        static constexpr std::chrono::steady_clock::duration CoalesceRetryPeriod = std::chrono::minutes(10);
 
         RegisterPoll(int pSlaveId, int pRegNum, RegisterType pRegType, int pRegCount, std::chrono::milliseconds pRrefreshMsec, PublishMode pPublishMode);
 
@@ -67,17 +81,150 @@ class RegisterPoll : public RegisterCommand {
 
         void update(const std::vector<uint16_t> newValues) { mLastValues = newValues; mCount = newValues.size(); }
 
+        /*!
+            Enable adaptive refresh. Poll period starts at pMin,
+            is doubled after every read without change up to pMax
+            and is reset to pMin when read values change.
+        */
+        void setRefreshRange(const std::chrono::steady_clock::duration& pMin, const std::chrono::steady_clock::duration& pMax);
+        bool isAdaptive() const { return mMaxRefresh > mMinRefresh; }
+        void adaptRefresh(bool pValuesChanged);
+
+        const std::chrono::steady_clock::duration& getMinRefresh() const { return mMinRefresh; }
+        const std::chrono::steady_clock::duration& getMaxRefresh() const { return mMaxRefresh; }
+
+        /*!
+            Suspended poll is not scheduled. After resume
+            the next read result is always sent to main thread.
+        */
+        void setSuspended(bool pFlag) { if (mSuspended && !pFlag) mForceNextSend = true; mSuspended = pFlag; }
+        bool isSuspended() const { return mSuspended; }
+        bool popForceNextSend() { bool ret = mForceNextSend; mForceNextSend = false; return ret; }
+
+        // poll is not scheduled periodically, only when trigger register changes
+        void setTriggeredOnly() { mRefresh = std::chrono::steady_clock::duration::max(); }
+        bool isTriggeredOnly() const { return mRefresh == std::chrono::steady_clock::duration::max(); }
+
+        /*!
+            Register pPoll to be executed when value of pTrigger
+            registers contained in this poll changes
+        */
+        void addDependentPoll(const ModbusAddressRange& pTrigger, const std::shared_ptr<RegisterPoll>& pPoll);
+        bool hasDependentPolls() const { return !mDependentPolls.empty(); }
+
+        /*!
+            Returns polls that depend on trigger registers
+            with values different in pNewValues and last read values.
+            Must be called before update()
+        */
+        std::vector<std::shared_ptr<RegisterPoll>> getTriggeredPolls(const std::vector<uint16_t>& pNewValues) const;
+
+        /*!
+            Returns true if all registers that differ in pNewValues
+            and last sent values are covered by deadbands and
+            changes are not greater than deadband thresholds.
+            Deadband keepalive is checked against mLastSendTime.
+        */
+        void addDeadband(const RegisterDeadband& pDeadband) { mDeadbands.push_back(pDeadband); }
+        bool isWithinDeadband(const std::vector<uint16_t>& pNewValues, const std::chrono::steady_clock::time_point& pNow) const;
+
+        /*!
+            Delay of the first scheduled poll after initial poll,
+            used to spread polls with the same refresh over time
+        */
+        void setPhaseOffset(const std::chrono::steady_clock::duration& pOffset) { mPhaseOffset = pOffset; }
+        const std::chrono::steady_clock::duration& getPhaseOffset() const { return mPhaseOffset; }
+
+        /*!
+            Low priority raised by one level for every
+            full refresh period this poll is late at pNow
+        */
+        virtual CommandPriority getEffectivePriority(const std::chrono::steady_clock::time_point& pNow) const;
+
+        // time point when this register should be polled,
+        // triggered only polls are due when their trigger changed
+        // and are read after their triggers in initial poll
+        std::chrono::steady_clock::time_point getDeadline() const {
+            if (isTriggeredOnly())
+                return isTriggered() ? mTriggerTime : std::chrono::steady_clock::time_point::max();
+            return mLastRead + mRefresh;
+        }
+
+        // trigger register changed at pNow and this poll was not read since then
+        void setTriggered(const std::chrono::steady_clock::time_point& pNow) {
+            if (!isTriggered())
+                mTriggerTime = pNow;
+        }
+        bool isTriggered() const { return mTriggerTime > mLastRead; }
+
+        struct DeadlineStats {
+            int mPollCount = 0;
+            // polls executed after the next one should be started
+            int mMissedCount = 0;
+            std::chrono::steady_clock::duration mMaxLateness = std::chrono::steady_clock::duration::zero();
+            std::chrono::steady_clock::duration mTotalLateness = std::chrono::steady_clock::duration::zero();
+        };
+
+        /*!
+            Update deadline stats with poll started at pStart.
+            Must be called before mLastRead is updated.
+        */
+        void updateDeadlineStats(const std::chrono::steady_clock::time_point& pStart);
+        // return stats collected since last call and reset them
+        DeadlineStats popDeadlineStats() { DeadlineStats ret(mDeadlineStats); mDeadlineStats = DeadlineStats(); return ret; }
+
+        // current poll period, modified by adaptRefresh()
         std::chrono::steady_clock::duration mRefresh;
 
         bool mLastReadOk = false;
         std::chrono::steady_clock::time_point mLastRead;
 
+        /*!
+            False if range covering this and other polls failed MaxCoalesceFailures
+            times in a row while this poll alone could be read, and CoalesceRetryPeriod
+            has not passed yet, see ModbusRequestsQueues::popCoalescable()
+        */
+        bool canCoalesce(const std::chrono::steady_clock::time_point& pNow) const {
+            return mCoalesceFailures < MaxCoalesceFailures || pNow - mCoalesceDisabledTime >= CoalesceRetryPeriod;
+        }
+        void setCoalescedReadFailed(const std::chrono::steady_clock::time_point& pNow);
+        void setCoalescedReadOk() { mCoalesceFailures = 0; }
+
         int mReadErrors;
         std::chrono::steady_clock::time_point mFirstErrorTime;
 
+        // time of the last MsgRegisterValues sent to main thread
+        std::chrono::steady_clock::time_point mLastSendTime;
+
         PublishMode mPublishMode = PublishMode::ON_CHANGE;
     private:
         std::vector<uint16_t> mLastValues;
+
+        std::chrono::steady_clock::duration mMinRefresh;
+        std::chrono::steady_clock::duration mMaxRefresh;
+
+        bool mSuspended = false;
+        bool mForceNextSend = false;
+
+        std::chrono::steady_clock::time_point mTriggerTime = std::chrono::steady_clock::time_point::min();
+
+        int mCoalesceFailures = 0;
+        std::chrono::steady_clock::time_point mCoalesceDisabledTime;
+
+        std::chrono::steady_clock::duration mPhaseOffset = std::chrono::steady_clock::duration::zero();
+
+        DeadlineStats mDeadlineStats;
+
+        struct DependentPoll {
+            DependentPoll(const ModbusAddressRange& pTrigger, const std::shared_ptr<RegisterPoll>& pPoll)
+                : mTrigger(pTrigger), mPoll(pPoll)
+            {}
+            ModbusAddressRange mTrigger;
+            std::weak_ptr<RegisterPoll> mPoll;
+        };
+        std::vector<DependentPoll> mDependentPolls;
+
+        std::vector<RegisterDeadband> mDeadbands;
 };
 
 class RegisterWrite : public RegisterCommand {
@@ -86,7 +233,9 @@ class RegisterWrite : public RegisterCommand {
             : RegisterCommand(msg.mSlaveId, msg.mRegister, msg.mRegisterType, msg.mRegisters.getCount()),
               mCreationTime(msg.getCreationTime()),
               mValues(msg.mRegisters)
-        {}
+        {
+            mPriority = msg.mPriority;
+        }
         RegisterWrite(int pSlaveId, int pRegister, RegisterType pType, const ModbusRegisters& pValues)
             : RegisterCommand(pSlaveId, pRegister, pType, pValues.getCount()),
               mCreationTime(std::chrono::steady_clock::now()),
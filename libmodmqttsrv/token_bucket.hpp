@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+namespace modmqttd {
+
+/**
+ * Rate limiter that allows bursts of up to mBurst
+ * operations and mRate operations per second on average
+ */
+class TokenBucket {
+    public:
+        TokenBucket(double pRate, double pBurst)
+            : mRate(pRate), mBurst(pBurst), mTokens(pBurst)
+        {}
+
+        bool tryTake(const std::chrono::steady_clock::time_point& pNow) {
+            refill(pNow);
+            if (mTokens < 1)
+                return false;
+            mTokens -= 1;
+            return true;
+        }
+
+        // time point when the next token will be available
+        std::chrono::steady_clock::time_point getNextTokenTime() const {
+            if (mTokens >= 1)
+                return mLastRefill;
+            std::chrono::duration<double> wait((1 - mTokens) / mRate);
+            return mLastRefill + std::chrono::duration_cast<std::chrono::steady_clock::duration>(wait);
+        }
+    private:
+        double mRate;
+        double mBurst;
+        double mTokens;
+        std::chrono::steady_clock::time_point mLastRefill;
+
+        void refill(const std::chrono::steady_clock::time_point& pNow) {
+            if (mLastRefill != std::chrono::steady_clock::time_point()) {
+                std::chrono::duration<double> elapsed(pNow - mLastRefill);
+                mTokens = std::min(mBurst, mTokens + elapsed.count() * mRate);
+            }
+            mLastRefill = pNow;
+        }
+};
+
+}
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <vector>
+#include <set>
+
+#include "topic_aliases.hpp"
+
+namespace modmqttd {
+
+void
+TopicAliases::setMaximum(int pMaximum) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mMaximum = pMaximum;
+    // drop aliases above new limit
+    for(auto it = mAliases.begin(); it != mAliases.end();) {
+        if (it->second.mId > mMaximum)
+            it = mAliases.erase(it);
+        else
+            it++;
+    }
+}
+
+
+void
+TopicAliases::reset() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    for(auto& alias: mAliases)
+        alias.second.mSent = false;
+}
+
+
+int
+TopicAliases::get(const std::string& pTopic, bool& pSendTopic) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    pSendTopic = true;
+    if (mMaximum == 0)
+        return 0;
+
+    mPublishCounts[pTopic]++;
+
+    auto it = mAliases.find(pTopic);
+    if (it == mAliases.end())
+        return 0;
+
+    pSendTopic = !it->second.mSent;
+    return it->second.mId;
+}
+
+
+void
+TopicAliases::confirmSent(const std::string& pTopic, int pAlias) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto it = mAliases.find(pTopic);
+    // alias could be reassigned by rank() in the meantime
+    if (it != mAliases.end() && it->second.mId == pAlias)
+        it->second.mSent = true;
+}
+
+
+void
+TopicAliases::rank() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mMaximum == 0)
+        return;
+
+    std::vector<std::pair<std::string, uint64_t>> counts(mPublishCounts.begin(), mPublishCounts.end());
+    std::stable_sort(counts.begin(), counts.end(),
+        [](const std::pair<std::string, uint64_t>& a, const std::pair<std::string, uint64_t>& b) -> bool { return a.second > b.second; }
+    );
+    if (counts.size() > size_t(mMaximum))
+        counts.resize(mMaximum);
+
+    std::set<std::string> hottest;
+    for(const auto& count: counts)
+        hottest.insert(count.first);
+
+    // release aliases of topics that are not published often anymore
+    std::set<int> freeIds;
+    for(int i = 1; i <= mMaximum; i++)
+        freeIds.insert(i);
+    for(auto it = mAliases.begin(); it != mAliases.end();) {
+        if (hottest.find(it->first) == hottest.end()) {
+            it = mAliases.erase(it);
+        } else {
+            freeIds.erase(it->second.mId);
+            it++;
+        }
+    }
+
+    // broker replaces old topic for reused alias when topic name is sent
+    for(const std::string& topic: hottest) {
+        if (mAliases.find(topic) == mAliases.end()) {
+            mAliases[topic] = Alias(*freeIds.begin());
+            freeIds.erase(freeIds.begin());
+        }
+    }
+
+    // keep history, but prefer recent publish rate
+    for(auto it = mPublishCounts.begin(); it != mPublishCounts.end();) {
+        it->second /= 2;
+        if (it->second == 0)
+            it = mPublishCounts.erase(it);
+        else
+            it++;
+    }
+}
+
+
+int
+TopicAliases::getAliasCount() const {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mAliases.size();
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+namespace modmqttd {
+
+/**
+ * Assigns MQTT v5 topic aliases to the most frequently
+ * published topics.
+ *
+ * Publish counts are collected by get() and aliases are
+ * reassigned by rank(). Topic name is sent with its alias once
+ * per connection, later publishes contain alias only.
+ */
+class TopicAliases {
+    public:
+        // number of aliases accepted by broker, 0 disables aliases
+        void setMaximum(int pMaximum);
+        // aliases are not known by broker after reconnect
+        void reset();
+
+        /**
+         * Count publish on pTopic. Returns alias or 0 if topic has no alias.
+         * pSendTopic is set to false if broker already knows the alias
+         */
+        int get(const std::string& pTopic, bool& pSendTopic);
+        /**
+         * Publish with topic name and pAlias succeeded, broker knows
+         * the alias from now on. Must be called only after successful
+         * publish, otherwise alias only publishes are rejected by broker
+         */
+        void confirmSent(const std::string& pTopic, int pAlias);
+
+        // assign aliases to topics published most often since the last call
+        void rank();
+
+        int getAliasCount() const;
+    private:
+        struct Alias {
+            Alias() {}
+            Alias(int pId) : mId(pId) {}
+            int mId = 0;
+            bool mSent = false;
+        };
+
+        int mMaximum = 0;
+        std::map<std::string, uint64_t> mPublishCounts;
+        std::map<std::string, Alias> mAliases;
+        mutable std::mutex mMutex;
+};
+
+}
@@ -39,6 +39,23 @@ struct YAML::convert<modmqttd::ModbusNetworkConfig::RtuRtsMode> {
     }
 };
 
+template<>
+struct YAML::convert<modmqttd::ModbusNetworkConfig::BusOverloadAction> {
+    static bool decode(const YAML::Node& node, modmqttd::ModbusNetworkConfig::BusOverloadAction& rhs) {
+        auto str = node.as<std::string>();
+        if (str == "warn") {
+            rhs = modmqttd::ModbusNetworkConfig::BusOverloadAction::WARN;
+        } else if (str == "fail") {
+            rhs = modmqttd::ModbusNetworkConfig::BusOverloadAction::FAIL;
+        } else if (str == "stretch") {
+            rhs = modmqttd::ModbusNetworkConfig::BusOverloadAction::STRETCH;
+        } else {
+            return false;
+        }
+        return true;
+    }
+};
+
 template<>
 struct YAML::convert<std::chrono::milliseconds> {
     static bool decode(const YAML::Node& node, std::chrono::milliseconds& value) {
@@ -0,0 +1,89 @@
+#include "catch2/catch_all.hpp"
+#include <yaml-cpp/yaml.h>
+
+#include "libmodmqttsrv/bus_load.hpp"
+#include "mockedserver.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE("Bus load estimator") {
+
+static const std::string config = R"(
+name: rtutest
+device: /dev/ttyUSB0
+baud: 9600
+parity: E
+data_bit: 8
+stop_bit: 1
+)";
+
+    YAML::Node yNet(YAML::Load(config));
+    modmqttd::MsgRegisterPollSpecification spec("rtutest");
+    modmqttd::MsgRegisterPoll poll(1, 1, modmqttd::RegisterType::HOLDING, 1);
+    poll.mRefreshMsec = std::chrono::milliseconds(100);
+    spec.mRegisters.push_back(poll);
+
+    SECTION("should compute read time from frame sizes") {
+        modmqttd::BusLoadEstimator estimator((modmqttd::ModbusNetworkConfig(yNet)));
+        REQUIRE(estimator.canEstimate());
+        // 11 bits per char, 8 bytes request, 7 bytes response, 7 chars of silence
+        REQUIRE(estimator.getReadTime(poll).count() == Catch::Approx(22 * 11 / 9600.0));
+        REQUIRE(estimator.getUtilisation(spec) == Catch::Approx(22 * 11 / 9600.0 / 0.1));
+    }
+
+    SECTION("should include slave delays") {
+        YAML::Node ySlave(YAML::Load("delay_before_first_command: 50ms"));
+        modmqttd::BusLoadEstimator estimator((modmqttd::ModbusNetworkConfig(yNet)));
+        estimator.setSlaveConfig(modmqttd::ModbusSlaveConfig(1, ySlave));
+        REQUIRE(estimator.getReadTime(poll).count() == Catch::Approx(22 * 11 / 9600.0 + 0.05));
+    }
+
+    SECTION("should ignore registers polled on change only") {
+        modmqttd::BusLoadEstimator estimator((modmqttd::ModbusNetworkConfig(yNet)));
+        spec.mRegisters.front().mRefreshMsec = modmqttd::MsgRegisterPoll::INVALID_REFRESH;
+        REQUIRE(estimator.getUtilisation(spec) == 0);
+    }
+
+    SECTION("should not estimate TCP network load") {
+        YAML::Node yTcp(YAML::Load("{name: tcptest, address: localhost, port: 501}"));
+        modmqttd::BusLoadEstimator estimator((modmqttd::ModbusNetworkConfig(yTcp)));
+        REQUIRE(!estimator.canEstimate());
+    }
+}
+
+TEST_CASE("Overloaded RTU network") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: rtutest
+      device: /tmp/bus_load_test
+      baud: 9600
+      parity: E
+      data_bit: 8
+      stop_bit: 1
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor
+      state:
+        register: rtutest.1.1
+)");
+
+    SECTION("should fail to start if configured") {
+        config.mYAML["modbus"]["networks"][0]["bus_overload"] = "fail";
+        MockedModMqttServerThread server(config.toString(), false);
+        server.start();
+        server.stop();
+        REQUIRE(server.initOk() == false);
+    }
+
+    SECTION("should start with warning by default") {
+        MockedModMqttServerThread server(config.toString());
+        server.start();
+        server.waitForPublish("test_sensor/state");
+        server.stop();
+    }
+}
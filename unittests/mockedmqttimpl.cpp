@@ -2,23 +2,33 @@
 #include "libmodmqttsrv/mqttclient.hpp"
 
 void
-MockedMqttImpl::init(modmqttd::MqttClient* owner, const char* clientId) {
+MockedMqttImpl::init(modmqttd::MqttClient* owner, const char* clientId, int connection) {
     mOwner = owner;
+    mConnection = connection;
 }
 
 void
 MockedMqttImpl::connect(const modmqttd::MqttBrokerConfig& config) {
-    mOwner->onConnect();
+    clearTopicAliases();
+    mOwner->onConnect(mConnection);
 }
 
 void
 MockedMqttImpl::reconnect() {
-    mOwner->onConnect();
+    if (mBrokerUp) {
+        clearTopicAliases();
+        if (!mSessionPresent) {
+            //messages of lost session are never acknowledged
+            std::unique_lock<std::mutex> lck(mMutex);
+            mUnackedIds.clear();
+        }
+        mOwner->onConnect(mConnection);
+    }
 }
 
 void
 MockedMqttImpl::disconnect() {
-    mOwner->onDisconnect();
+    mOwner->onDisconnect(mConnection);
 }
 
 void
@@ -27,16 +37,47 @@ MockedMqttImpl::stop() {
 }
 
 void
-MockedMqttImpl::subscribe(const char* topic) {
+MockedMqttImpl::subscribe(const char* topic, int qos) {
     std::unique_lock<std::mutex> lck(mMutex);
     mSubscriptions.insert(topic);
     BOOST_LOG_SEV(log, modmqttd::Log::info) << "TEST: subscribe " << topic;
     mCondition.notify_all();
 }
 
-void
-MockedMqttImpl::publish(const char* topic, int len, const void* data, bool retain) {
+int
+MockedMqttImpl::publish(const char* pTopic, int len, const void* data, bool retain, int qos, int topicAlias) {
     std::unique_lock<std::mutex> lck(mMutex);
+    if (!mBrokerUp) {
+        BOOST_LOG_SEV(log, modmqttd::Log::info) << "TEST: broker down, dropping publish " << pTopic;
+        return -1;
+    }
+    if (mPublishErrors.find(pTopic) != mPublishErrors.end()) {
+        BOOST_LOG_SEV(log, modmqttd::Log::info) << "TEST: publish error on " << pTopic;
+        return -1;
+    }
+    std::string aliasTopic(pTopic);
+    if (topicAlias > 0) {
+        // real broker disconnects client with protocol error
+        if (topicAlias > mTopicAliasMaximum) {
+            BOOST_LOG_SEV(log, modmqttd::Log::error) << "TEST: topic alias " << topicAlias << " exceeds broker maximum, dropping publish";
+            return -1;
+        }
+        if (aliasTopic.empty()) {
+            auto ait = mTopicAliases.find(topicAlias);
+            if (ait == mTopicAliases.end()) {
+                BOOST_LOG_SEV(log, modmqttd::Log::error) << "TEST: unknown topic alias " << topicAlias << ", dropping publish";
+                return -1;
+            }
+            aliasTopic = ait->second;
+            mAliasOnlyPublishCounts[aliasTopic]++;
+        } else {
+            mTopicAliases[topicAlias] = aliasTopic;
+        }
+    }
+    const char* topic = aliasTopic.c_str();
+    int msgId = mNextMsgId++;
+    if (qos > 0)
+        mUnackedIds.push_back(msgId);
 
     int publishCount = 0;
     auto it = mTopics.find(topic);
@@ -48,6 +89,7 @@ MockedMqttImpl::publish(const char* topic, int len, const void* data, bool retai
 
     MqttValue v(data, len);
     v.publishCount = publishCount;
+    v.qos = qos;
     mTopics[topic] = v;
     std::set<std::string>::const_iterator sit = mSubscriptions.find(topic);
     if (sit != mSubscriptions.end()) {
@@ -56,6 +98,43 @@ MockedMqttImpl::publish(const char* topic, int len, const void* data, bool retai
     BOOST_LOG_SEV(log, modmqttd::Log::info) << "TEST: publish " << topic << ": <" << v.val << ">";
     mPublishedTopics.insert(std::make_pair(topic, mPublishedTopics.size() + 1));
     mCondition.notify_all();
+    return msgId;
+}
+
+void
+MockedMqttImpl::ackPublishes() {
+    std::vector<int> ids;
+    {
+        std::unique_lock<std::mutex> lck(mMutex);
+        ids.swap(mUnackedIds);
+    }
+    BOOST_LOG_SEV(log, modmqttd::Log::info) << "TEST: acknowledging " << ids.size() << " messages";
+    for(int msgId: ids)
+        mOwner->onPublish(msgId, mConnection);
+}
+
+int
+MockedMqttImpl::getAliasOnlyPublishCount(const char* topic) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    auto it = mAliasOnlyPublishCounts.find(topic);
+    if (it == mAliasOnlyPublishCounts.end())
+        return 0;
+    return it->second;
+}
+
+void
+MockedMqttImpl::clearTopicAliases() {
+    std::unique_lock<std::mutex> lck(mMutex);
+    mTopicAliases.clear();
+}
+
+int
+MockedMqttImpl::getQos(const char* topic) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    std::map<std::string, MqttValue>::const_iterator it = mTopics.find(topic);
+    if (it == mTopics.end())
+        throw MockedMqttException(std::string(topic) + " not found");
+    return it->second.qos;
 }
 
 void
@@ -207,6 +286,25 @@ MockedMqttImpl::resetBroker() {
     disconnect();
 }
 
+void
+MockedMqttImpl::setPublishError(const char* topic, bool pFlag) {
+    std::unique_lock<std::mutex> lck(mMutex);
+    if (pFlag)
+        mPublishErrors.insert(topic);
+    else
+        mPublishErrors.erase(topic);
+}
+
+void
+MockedMqttImpl::setBrokerUp(bool pFlag) {
+    BOOST_LOG_SEV(log, modmqttd::Log::info) << "TEST: MQTT Broker " << (pFlag ? "up" : "down");
+    mBrokerUp = pFlag;
+    if (pFlag)
+        reconnect();
+    else
+        disconnect();
+}
+
 std::string
 MockedMqttImpl::mqttValue(const char* topic) {
     std::unique_lock<std::mutex> lck(mMutex);
@@ -4,6 +4,8 @@
 #include <condition_variable>
 #include <map>
 #include <set>
+#include <atomic>
+#include <vector>
 
 #include "libmodmqttsrv/imqttimpl.hpp"
 #include "libmodmqttsrv/logging.hpp"
@@ -23,10 +25,12 @@ class MockedMqttImpl : public modmqttd::IMqttImpl {
             MqttValue(const MqttValue& from) {
                 copyData(from.val, from.len);
                 publishCount = from.publishCount;
+                qos = from.qos;
             }
             MqttValue& operator=(const MqttValue& other) {
                 copyData(other.val, other.len);
                 publishCount = other.publishCount;
+                qos = other.qos;
                 return *this;
             }
             ~MqttValue() {
@@ -36,6 +40,7 @@ class MockedMqttImpl : public modmqttd::IMqttImpl {
             char* val = NULL;
             int len = 0;
             int publishCount = 0;
+            int qos = 0;
         private:
             void copyData(const void* v, int l) {
                 if (val)
@@ -47,14 +52,16 @@ class MockedMqttImpl : public modmqttd::IMqttImpl {
             };
     };
     public:
-        virtual void init(modmqttd::MqttClient* owner, const char* clientId);
+        virtual void init(modmqttd::MqttClient* owner, const char* clientId, int connection);
         virtual void connect(const modmqttd::MqttBrokerConfig& config);
         virtual void reconnect();
         virtual void disconnect();
         virtual void stop();
 
-        virtual void subscribe(const char* topic);
-        virtual void publish(const char* topic, int len, const void* data, bool retain);
+        virtual void subscribe(const char* topic, int qos);
+        virtual int publish(const char* topic, int len, const void* data, bool retain, int qos, int topicAlias);
+        virtual int getTopicAliasMaximum() const { return mTopicAliasMaximum; }
+        virtual bool isSessionPresent() const { return mSessionPresent; }
 
         virtual void on_disconnect(int rc);
         virtual void on_connect(int rc);
@@ -67,17 +74,42 @@ class MockedMqttImpl : public modmqttd::IMqttImpl {
         int getPublishCount(const char* topic);
         bool hasTopic(const char* topic);
         std::string mqttValue(const char* topic);
+        int getQos(const char* topic);
+        //QoS > 0 messages are not acknowledged until this is called
+        void ackPublishes();
+        //number of topic aliases accepted by broker after next connect
+        void setTopicAliasMaximum(int pMaximum) { mTopicAliasMaximum = pMaximum; }
+        //broker keeps session and unacknowledged messages after reconnect
+        void setSessionPresent(bool pFlag) { mSessionPresent = pFlag; }
+        //number of publishes that contained topic alias without topic name
+        int getAliasOnlyPublishCount(const char* topic);
         bool mqttNullValue(const char* topic);
         //returns current value on timeout
         std::string waitForMqttValue(const char* topic, const char* expected, std::chrono::milliseconds timeout);
         //clear all topics and simulate broker disconnection
         void resetBroker();
+        //simulate broker outage, reconnect fails until broker is up again
+        void setBrokerUp(bool pFlag);
+        //publishes with topic name fail until flag is cleared
+        void setPublishError(const char* topic, bool pFlag = true);
     private:
+        void clearTopicAliases();
+
+        std::atomic<bool> mBrokerUp{true};
         modmqttd::MqttClient* mOwner;
+        int mConnection = 0;
         boost::log::sources::severity_logger<modmqttd::Log::severity> log;
 
         std::map<std::string, MqttValue> mTopics;
         std::set<std::string> mSubscriptions;
+        std::set<std::string> mPublishErrors;
+        std::vector<int> mUnackedIds;
+        std::atomic<int> mTopicAliasMaximum{0};
+        std::atomic<bool> mSessionPresent{false};
+        //topic aliases set on current connection
+        std::map<int, std::string> mTopicAliases;
+        std::map<std::string, int> mAliasOnlyPublishCounts;
+        int mNextMsgId = 1;
 
         //contains all topics published before waitForPublish/waitForFirstPublish
         //call. Map value contains mqtt publish count
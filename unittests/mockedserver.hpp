@@ -91,6 +91,13 @@ class MockedModMqttServerThread : public ModMqttServerThread {
             mServer.addConverterPath("../exprconv");
         };
 
+    // additional broker connection for mqtt.broker.connections
+    std::shared_ptr<MockedMqttImpl> addMqttConnection() {
+        std::shared_ptr<MockedMqttImpl> ret(new MockedMqttImpl());
+        mServer.addMqttImplementation(ret);
+        return ret;
+    }
+
     void waitForSubscription(const char* topic, std::chrono::milliseconds timeout = defaultWaitTime()) {
         INFO("Checking for subscription on " << topic);
         bool is_subscribed = mMqtt->waitForSubscription(topic, timeout);
@@ -132,7 +139,7 @@ class MockedModMqttServerThread : public ModMqttServerThread {
     }
 
     void publish(const char* topic, const std::string& value, bool retain = false) {
-        mMqtt->publish(topic, value.length(), value.c_str(), retain);
+        mMqtt->publish(topic, value.length(), value.c_str(), retain, 0, 0);
     }
 
     void waitForMqttValue(const char* topic, const char* expected, std::chrono::milliseconds timeout = defaultWaitTime()) {
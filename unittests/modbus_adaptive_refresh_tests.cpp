@@ -0,0 +1,62 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("Adaptive refresh") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh:
+    min: 10ms
+    max: 160ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor
+      state:
+        register: tcptest.1.2
+)");
+
+    SECTION("should poll less often when value is not changing") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForPublish("test_sensor/state");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        server.stop();
+
+        // 10+20+40+80+160 ms periods, fixed 10ms refresh would give ~30 reads
+        REQUIRE(server.getMockedModbusContext("tcptest").getReadCount(1) < 10);
+    }
+
+    SECTION("should publish value change") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForPublish("test_sensor/state");
+        REQUIRE(server.mqttValue("test_sensor/state") == "1");
+
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        server.waitForPublish("test_sensor/state");
+        REQUIRE(server.mqttValue("test_sensor/state") == "2");
+        server.stop();
+    }
+
+    SECTION("should not allow max lower than min") {
+        config.mYAML["mqtt"]["refresh"]["max"] = "5ms";
+        MockedModMqttServerThread server(config.toString(), false);
+        server.start();
+        server.stop();
+
+        REQUIRE_FALSE(server.initOk());
+    }
+}
@@ -0,0 +1,257 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+#include "libmodmqttsrv/register_poll.hpp"
+#include "libmodmqttsrv/mqttobject.hpp"
+
+TEST_CASE ("Register deadband") {
+    modmqttd::ModbusAddressRange range(1, modmqttd::RegisterType::HOLDING, 1);
+
+    SECTION("should compare absolute change with threshold") {
+        modmqttd::RegisterDeadband deadband(range, 5, false);
+        REQUIRE(deadband.isWithin(100, 105));
+        REQUIRE(deadband.isWithin(100, 95));
+        REQUIRE(!deadband.isWithin(100, 106));
+    }
+
+    SECTION("should compare percent of old value with threshold") {
+        modmqttd::RegisterDeadband deadband(range, 2, true);
+        REQUIRE(deadband.isWithin(1000, 1020));
+        REQUIRE(!deadband.isWithin(1000, 1021));
+        REQUIRE(!deadband.isWithin(0, 1));
+    }
+
+    SECTION("should compare unsigned values") {
+        modmqttd::RegisterDeadband deadband(range, 2, false);
+        REQUIRE(deadband.isWithin(0xFFFF, 0xFFFD));
+        REQUIRE(!deadband.isWithin(0xFFFF, 1));
+    }
+
+    SECTION("should not filter registers outside deadband") {
+        modmqttd::RegisterPoll poll(1, 1, modmqttd::RegisterType::HOLDING, 2, std::chrono::milliseconds(10), modmqttd::PublishMode::ON_CHANGE);
+        poll.update(std::vector<uint16_t>({10, 10}));
+        poll.addDeadband(modmqttd::RegisterDeadband(range, 5, false));
+
+        auto now = std::chrono::steady_clock::now();
+        REQUIRE(poll.isWithinDeadband(std::vector<uint16_t>({12, 10}), now));
+        REQUIRE(!poll.isWithinDeadband(std::vector<uint16_t>({12, 11}), now));
+    }
+
+    SECTION("should not filter changes after keepalive") {
+        modmqttd::RegisterPoll poll(1, 1, modmqttd::RegisterType::HOLDING, 1, std::chrono::milliseconds(10), modmqttd::PublishMode::ON_CHANGE);
+        poll.update(std::vector<uint16_t>({10}));
+        modmqttd::RegisterDeadband deadband(range, 5, false);
+        deadband.mKeepalive = std::chrono::seconds(1);
+        poll.addDeadband(deadband);
+
+        poll.mLastSendTime = std::chrono::steady_clock::now();
+        REQUIRE(poll.isWithinDeadband(std::vector<uint16_t>({12}), poll.mLastSendTime + std::chrono::milliseconds(500)));
+        REQUIRE(!poll.isWithinDeadband(std::vector<uint16_t>({12}), poll.mLastSendTime + std::chrono::seconds(1)));
+    }
+}
+
+TEST_CASE ("Converted value deadband") {
+    SECTION("should compare signed and fractional values") {
+        modmqttd::MqttValueDeadband deadband(0.5, false);
+        REQUIRE(deadband.isWithin(MqttValue::fromInt(-1), MqttValue::fromDouble(-0.5)));
+        REQUIRE(!deadband.isWithin(MqttValue::fromInt(-1), MqttValue::fromDouble(-0.4)));
+    }
+
+    SECTION("should compare percent of absolute old value") {
+        modmqttd::MqttValueDeadband deadband(10, true);
+        REQUIRE(deadband.isWithin(MqttValue::fromDouble(-20.0), MqttValue::fromDouble(-18.0)));
+        REQUIRE(!deadband.isWithin(MqttValue::fromDouble(-20.0), MqttValue::fromDouble(-17.9)));
+    }
+
+    SECTION("should not filter text values") {
+        modmqttd::MqttValueDeadband deadband(10, false);
+        REQUIRE(!deadband.isWithin(MqttValue::fromString("1"), MqttValue::fromString("2")));
+    }
+}
+
+TEST_CASE ("Deadband filtering") {
+
+TestConfig config(R"(
+modmqttd:
+  converter_search_path:
+    - build/stdconv
+  converter_plugins:
+    - stdconv.so
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor
+      state:
+        register: tcptest.1.2
+        deadband: 5
+)");
+
+    SECTION("should publish only changes greater than deadband") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 100);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "100");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 103);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(server.mqttValue("test_sensor/state") == "100");
+
+        // accumulated drift exceeds deadband
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 106);
+        server.waitForMqttValue("test_sensor/state", "106");
+        server.stop();
+        server.requirePublishCount("test_sensor/state", 2);
+    }
+
+    SECTION("should publish suppressed change after keepalive") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["deadband_keepalive"] = "50ms";
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 100);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "100");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 101);
+        server.waitForMqttValue("test_sensor/state", "101");
+        server.stop();
+    }
+
+    SECTION("should not be applied if register is used without deadband") {
+        config.mYAML["mqtt"]["objects"][1]["topic"] = "raw_sensor";
+        config.mYAML["mqtt"]["objects"][1]["state"]["register"] = "tcptest.1.2";
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 100);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "100");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 101);
+        server.waitForMqttValue("raw_sensor/state", "101");
+        server.waitForMqttValue("test_sensor/state", "101");
+        server.stop();
+    }
+
+    SECTION("should accept percent value") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["deadband"] = "10%";
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 100);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "100");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 109);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(server.mqttValue("test_sensor/state") == "100");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 111);
+        server.waitForMqttValue("test_sensor/state", "111");
+        server.stop();
+    }
+
+    SECTION("should fail to start with invalid value") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["deadband"] = "a lot";
+        MockedModMqttServerThread server(config.toString(), false);
+        server.start();
+        server.stop();
+        REQUIRE(server.initOk() == false);
+    }
+
+    SECTION("should fail to start if used for multiple registers") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["count"] = 2;
+        MockedModMqttServerThread server(config.toString(), false);
+        server.start();
+        server.stop();
+        REQUIRE(server.initOk() == false);
+    }
+
+    SECTION("should apply deadband to converted value") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["converter"] = "std.int16()";
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 0xFFFF);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "-1");
+        // raw value change is much greater than deadband
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 3);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(server.mqttValue("test_sensor/state") == "-1");
+
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 5);
+        server.waitForMqttValue("test_sensor/state", "5");
+        server.stop();
+        server.requirePublishCount("test_sensor/state", 2);
+    }
+
+    SECTION("should apply deadband to value converted from multiple registers") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["converter"] = "std.uint32()";
+        config.mYAML["mqtt"]["objects"][0]["state"]["count"] = 2;
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 0);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "65536");
+        server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 3);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(server.mqttValue("test_sensor/state") == "65536");
+
+        server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 10);
+        server.waitForMqttValue("test_sensor/state", "65546");
+        server.stop();
+    }
+
+    SECTION("should publish changes of values without deadband") {
+        config.mYAML["mqtt"]["objects"][0]["state"] = YAML::Load(R"(
+          - name: converted
+            register: tcptest.1.2
+            converter: std.int16()
+            deadband: 5
+          - name: raw
+            register: tcptest.1.3
+        )");
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 100);
+        server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", R"({"converted":100,"raw":1})");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 101);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 2);
+        server.waitForMqttValue("test_sensor/state", R"({"converted":101,"raw":2})");
+        server.stop();
+    }
+
+    SECTION("should publish suppressed converted value after keepalive") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["converter"] = "std.int16()";
+        config.mYAML["mqtt"]["objects"][0]["state"]["deadband_keepalive"] = "50ms";
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 100);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "100");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 101);
+        server.waitForMqttValue("test_sensor/state", "101");
+        server.stop();
+    }
+
+    SECTION("should fail to start if set on register of converted list") {
+        config.mYAML["mqtt"]["objects"][0]["state"] = YAML::Load(R"(
+          converter: std.int32()
+          registers:
+            - register: tcptest.1.2
+              deadband: 5
+            - register: tcptest.1.3
+        )");
+        MockedModMqttServerThread server(config.toString(), false);
+        server.start();
+        server.stop();
+        REQUIRE(server.initOk() == false);
+    }
+}
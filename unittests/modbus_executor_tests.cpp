@@ -258,6 +258,201 @@ TEST_CASE("ModbusExecutor") {
     }
 
 
+    SECTION("should switch from slow slave after its bus time quantum is used") {
+        // slow slave read takes more than a single quantum
+        MockedModbusContext& ctx(modbus_factory.getMockedModbusContext("test"));
+        executor.setSlaveQuantum(1, std::chrono::milliseconds(30));
+        executor.setSlaveQuantum(2, std::chrono::milliseconds(30));
+        ctx.getSlave(1).mReadTime = std::chrono::milliseconds(35);
+        ctx.getSlave(2).mReadTime = std::chrono::milliseconds(5);
+        for(int i = 1; i <= 3; i++)
+            registers.addPoll(1, i);
+        for(int i = 1; i <= 20; i++)
+            registers.addPoll(2, i);
+
+        executor.setupInitialPoll(registers);
+        executor.executeNext();
+        REQUIRE(std::get<0>(ctx.getLastReadRegisterAddress()) == 1);
+        executor.executeNext();
+        REQUIRE(std::get<0>(ctx.getLastReadRegisterAddress()) == 2);
+
+        SECTION("and execute a single slow command in every turn") {
+            while(std::get<0>(ctx.getLastReadRegisterAddress()) == 2)
+                executor.executeNext();
+            executor.executeNext();
+            REQUIRE(std::get<0>(ctx.getLastReadRegisterAddress()) == 2);
+        }
+
+        SECTION("and execute more slow commands in a turn if slave weight is set") {
+            executor.setSlaveWeight(1, 2);
+            while(std::get<0>(ctx.getLastReadRegisterAddress()) == 2)
+                executor.executeNext();
+            executor.executeNext();
+            REQUIRE(std::get<0>(ctx.getLastReadRegisterAddress()) == 1);
+        }
+    }
+
+    SECTION("should not add bus time quantum when write preempts waiting poll") {
+        MockedModbusContext& ctx(modbus_factory.getMockedModbusContext("test"));
+        executor.setSlaveQuantum(1, std::chrono::milliseconds(20));
+        ctx.getSlave(1).mReadTime = std::chrono::milliseconds(5);
+        registers.addPoll(1, 1);
+        registers.addPoll(1, 2);
+
+        executor.setupInitialPoll(registers);
+        executor.executeNext();
+        REQUIRE(executor.getSlaveQueues(1)->getCredit() < std::chrono::milliseconds(20));
+
+        executor.addWriteCommand(ModbusExecutorTestRegisters::createWrite(1, 1, 100));
+        REQUIRE(executor.getSlaveQueues(1)->getCredit() < std::chrono::milliseconds(20));
+    }
+
+    SECTION("should read due polls of the same slave with a single command if max read gap is set") {
+        MockedModbusContext& ctx(modbus_factory.getMockedModbusContext("test"));
+        modbus_factory.setModbusRegisterValue("test",1,1,modmqttd::RegisterType::HOLDING, 5);
+        modbus_factory.setModbusRegisterValue("test",1,3,modmqttd::RegisterType::HOLDING, 6);
+        modbus_factory.setModbusRegisterValue("test",1,20,modmqttd::RegisterType::HOLDING, 7);
+
+        auto reg1 = registers.addPoll(1, 1);
+        auto reg3 = registers.addPoll(1, 3);
+        auto reg20 = registers.addPoll(1, 20);
+        executor.setSlaveMaxReadGap(1, 2);
+
+        executor.setupInitialPoll(registers);
+        executor.executeNext();
+        REQUIRE(ctx.getReadCount(1) == 1);
+        REQUIRE(reg1->getValues()[0] == 5);
+        REQUIRE(reg3->getValues()[0] == 6);
+        REQUIRE(reg20->getValues()[0] == 0);
+
+        // register 20 is too far
+        executor.executeNext();
+        REQUIRE(ctx.getReadCount(1) == 2);
+        REQUIRE(reg20->getValues()[0] == 7);
+        REQUIRE(executor.allDone());
+    }
+
+    SECTION("should read polls alone if register in gap cannot be read") {
+        modbus_factory.setModbusRegisterValue("test",1,1,modmqttd::RegisterType::HOLDING, 5);
+        modbus_factory.setModbusRegisterValue("test",1,3,modmqttd::RegisterType::HOLDING, 6);
+        modbus_factory.setModbusRegisterReadError("test",1,2,modmqttd::RegisterType::HOLDING);
+
+        auto reg1 = registers.addPoll(1, 1);
+        auto reg3 = registers.addPoll(1, 3);
+        executor.setSlaveMaxReadGap(1, 2);
+
+        executor.setupInitialPoll(registers);
+        executor.executeNext();
+        REQUIRE(reg1->executedOk());
+        REQUIRE(reg1->getValues()[0] == 5);
+        // single failure can be transient
+        REQUIRE(reg1->canCoalesce(std::chrono::steady_clock::now()));
+        REQUIRE(!executor.allDone());
+
+        executor.executeNext();
+        REQUIRE(reg3->getValues()[0] == 6);
+        REQUIRE(executor.allDone());
+    }
+
+    SECTION("should disable coalescing after repeated failures of covering read") {
+        MockedModbusContext& ctx(modbus_factory.getMockedModbusContext("test"));
+        modbus_factory.setModbusRegisterValue("test",1,1,modmqttd::RegisterType::HOLDING, 5);
+        modbus_factory.setModbusRegisterValue("test",1,3,modmqttd::RegisterType::HOLDING, 6);
+        modbus_factory.setModbusRegisterReadError("test",1,2,modmqttd::RegisterType::HOLDING);
+
+        // always due
+        auto reg1 = registers.addPoll(1, 1, std::chrono::milliseconds::zero());
+        auto reg3 = registers.addPoll(1, 3, std::chrono::milliseconds::zero());
+        executor.setSlaveMaxReadGap(1, 2);
+
+        executor.setupInitialPoll(registers);
+        for (int i = 0; i < modmqttd::RegisterPoll::MaxCoalesceFailures; i++) {
+            REQUIRE(reg1->canCoalesce(std::chrono::steady_clock::now()));
+            if (i != 0)
+                executor.addPollList(registers);
+            executor.executeNext();
+            executor.executeNext();
+            REQUIRE(executor.allDone());
+        }
+        auto now = std::chrono::steady_clock::now();
+        REQUIRE(!reg1->canCoalesce(now));
+        REQUIRE(reg1->canCoalesce(now + modmqttd::RegisterPoll::CoalesceRetryPeriod));
+
+        // register in gap can be read again, but coalescing stays disabled
+        modbus_factory.clearModbusRegisterReadError("test",1,2,modmqttd::RegisterType::HOLDING);
+        int reads = ctx.getReadCount(1);
+        executor.addPollList(registers);
+        executor.executeNext();
+        executor.executeNext();
+        REQUIRE(executor.allDone());
+        REQUIRE(ctx.getReadCount(1) == reads + 2);
+    }
+
+    SECTION("should keep coalescing if covering read succeeds between failures") {
+        modbus_factory.setModbusRegisterValue("test",1,1,modmqttd::RegisterType::HOLDING, 5);
+        modbus_factory.setModbusRegisterValue("test",1,3,modmqttd::RegisterType::HOLDING, 6);
+
+        auto reg1 = registers.addPoll(1, 1, std::chrono::milliseconds::zero());
+        auto reg3 = registers.addPoll(1, 3, std::chrono::milliseconds::zero());
+        executor.setSlaveMaxReadGap(1, 2);
+
+        executor.setupInitialPoll(registers);
+        for (int i = 0; i < modmqttd::RegisterPoll::MaxCoalesceFailures * 2; i++) {
+            // every other covering read fails
+            modbus_factory.setModbusRegisterReadError("test",1,2,modmqttd::RegisterType::HOLDING, i % 2 == 0);
+            if (i != 0)
+                executor.addPollList(registers);
+            while(!executor.allDone())
+                executor.executeNext();
+        }
+        REQUIRE(reg1->canCoalesce(std::chrono::steady_clock::now()));
+    }
+
+    SECTION("should read triggered poll when bus is saturated with due polls") {
+        modbus_factory.setModbusRegisterValue("test",1,1,modmqttd::RegisterType::HOLDING, 1);
+        modbus_factory.setModbusRegisterValue("test",1,10,modmqttd::RegisterType::HOLDING, 10);
+
+        // always due
+        auto trigger = registers.addPoll(1, 1, std::chrono::milliseconds::zero());
+        registers.addPoll(1, 2, std::chrono::milliseconds::zero());
+        registers.addPoll(1, 3, std::chrono::milliseconds::zero());
+        std::shared_ptr<modmqttd::RegisterPoll> triggered(new modmqttd::RegisterPoll(1, 9, modmqttd::RegisterType::HOLDING, 1, std::chrono::milliseconds::zero(), modmqttd::PublishMode::ON_CHANGE));
+        triggered->setTriggeredOnly();
+        trigger->addDependentPoll(modmqttd::ModbusAddressRange(0, modmqttd::RegisterType::HOLDING, 1), triggered);
+
+        executor.setupInitialPoll(registers);
+        while(!executor.allDone())
+            executor.executeNext();
+        REQUIRE(!triggered->executedOk());
+
+        modbus_factory.setModbusRegisterValue("test",1,1,modmqttd::RegisterType::HOLDING, 2);
+        // scheduler adds all periodic polls again before every command
+        for (int i = 0; i < 10 && !triggered->executedOk(); i++) {
+            executor.addPollList(registers);
+            executor.executeNext();
+        }
+        REQUIRE(triggered->executedOk());
+        REQUIRE(triggered->getValues()[0] == 10);
+    }
+
+    SECTION("should not preempt aged low priority poll with normal priority write") {
+        modbus_factory.setModbusRegisterValue("test",1,1,modmqttd::RegisterType::HOLDING, 1);
+        auto reg = registers.addPoll(1, 1);
+        reg->mPriority = modmqttd::CommandPriority::LOW;
+        // late for 10 refresh periods
+        reg->mLastRead = std::chrono::steady_clock::now() - std::chrono::milliseconds(110);
+        executor.addPollList(registers);
+        REQUIRE(executor.getWaitingCommand() == reg);
+
+        executor.addWriteCommand(ModbusExecutorTestRegisters::createWrite(1, 1, 100));
+        REQUIRE(executor.getWaitingCommand() == reg);
+
+        executor.executeNext(); //poll 1,1
+        REQUIRE(fromModbusQueue.size_approx() == 1);
+        executor.executeNext(); //write 1,1
+        REQUIRE(modbus_factory.getModbusRegisterValue("test", 1, 1, modmqttd::RegisterType::HOLDING) == 100);
+    }
+
     SECTION("should switch slaves after WRITE_BATCH_SIZE writes in write only mode") {
         modbus_factory.setModbusRegisterValue("test",1,1,modmqttd::RegisterType::HOLDING, 1);
         modbus_factory.setModbusRegisterValue("test",2,2,modmqttd::RegisterType::HOLDING, 20);
@@ -351,6 +546,36 @@ TEST_CASE("ModbusExecutor") {
         REQUIRE(executor.getLastCommand()->executedOk() == false);
     }
 
+    SECTION("should execute commands of other slaves during retry backoff") {
+        MockedModbusContext& ctx(modbus_factory.getMockedModbusContext("test"));
+        modbus_factory.setModbusRegisterReadError("test", 1, 1, modmqttd::RegisterType::HOLDING);
+        auto failing = registers.addPoll(1, 1);
+        failing->setMaxRetryCounts(1, 0);
+        registers.addPoll(2, 1);
+        executor.setRetryBackoff(std::chrono::milliseconds(50));
+
+        executor.setupInitialPoll(registers);
+        executor.executeNext();
+        REQUIRE(ctx.getReadCount(1) == 1);
+        REQUIRE(executor.getWaitingCommand() == nullptr);
+
+        executor.executeNext();
+        REQUIRE(ctx.getReadCount(2) == 1);
+        REQUIRE(!executor.allDone());
+
+        // nothing to do until backoff ends
+        waitTime = executor.executeNext();
+        REQUIRE(waitTime > std::chrono::milliseconds::zero());
+        REQUIRE(waitTime <= std::chrono::milliseconds(50));
+        REQUIRE(ctx.getReadCount(1) == 1);
+
+        std::this_thread::sleep_for(waitTime);
+        executor.executeNext();
+        REQUIRE(ctx.getReadCount(1) == 2);
+        REQUIRE(failing->mRetryCount == 0);
+        REQUIRE(executor.allDone());
+    }
+
     SECTION("should delay retry of last write command") {
         modbus_factory.setModbusRegisterWriteError("test", 1, 1, modmqttd::RegisterType::HOLDING);
 
@@ -0,0 +1,93 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("State register with poll_on_change_of") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor
+      state:
+        register: tcptest.1.20
+        poll_on_change_of: tcptest.1.2
+)");
+
+    MockedModMqttServerThread server(config.toString());
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+    server.setModbusRegisterValue("tcptest", 1, 20, modmqttd::RegisterType::HOLDING, 5);
+    server.start();
+
+    server.waitForPublish("test_sensor/state");
+    REQUIRE(server.mqttValue("test_sensor/state") == "5");
+
+    SECTION("should not be polled periodically") {
+        server.setModbusRegisterValue("tcptest", 1, 20, modmqttd::RegisterType::HOLDING, 6);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(server.mqttValue("test_sensor/state") == "5");
+    }
+
+    SECTION("should be polled after trigger register change") {
+        server.setModbusRegisterValue("tcptest", 1, 20, modmqttd::RegisterType::HOLDING, 6);
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        server.waitForMqttValue("test_sensor/state", "6");
+    }
+
+    server.stop();
+}
+
+TEST_CASE ("Poll group with poll_on_change_of") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+      slaves:
+        - address: 1
+          poll_groups:
+            - register: 20
+              count: 2
+              poll_on_change_of:
+                register: 2
+                refresh: 10ms
+mqtt:
+  client_id: mqtt_test
+  refresh: 10min
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor
+      state:
+        - name: a
+          register: tcptest.1.20
+        - name: b
+          register: tcptest.1.21
+)");
+
+    MockedModMqttServerThread server(config.toString());
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+    server.setModbusRegisterValue("tcptest", 1, 20, modmqttd::RegisterType::HOLDING, 5);
+    server.setModbusRegisterValue("tcptest", 1, 21, modmqttd::RegisterType::HOLDING, 6);
+    server.start();
+
+    server.waitForPublish("test_sensor/state");
+    REQUIRE(server.mqttValue("test_sensor/state") == R"({"a":5,"b":6})");
+
+    server.setModbusRegisterValue("tcptest", 1, 21, modmqttd::RegisterType::HOLDING, 7);
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+    server.waitForMqttValue("test_sensor/state", R"({"a":5,"b":7})");
+
+    server.stop();
+}
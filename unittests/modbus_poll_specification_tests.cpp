@@ -128,3 +128,42 @@ TEST_CASE("MsgRegisterPollSpecification merge tests") {
     }
 
 }
+
+TEST_CASE("MsgRegisterPoll adaptive refresh merge tests") {
+    modmqttd::MsgRegisterPoll adaptive(createPoll(1,2,100));
+    adaptive.mMaxRefreshMsec = std::chrono::milliseconds(1000);
+
+    SECTION("Fixed refresh should limit max refresh") {
+        adaptive.merge(createPoll(2,3,500));
+
+        REQUIRE(adaptive.isAdaptive());
+        REQUIRE(adaptive.mRefreshMsec == std::chrono::milliseconds(100));
+        REQUIRE(adaptive.mMaxRefreshMsec == std::chrono::milliseconds(500));
+    }
+
+    SECTION("Fixed refresh shorter than min should disable adaptive refresh") {
+        adaptive.merge(createPoll(2,3,50));
+
+        REQUIRE_FALSE(adaptive.isAdaptive());
+        REQUIRE(adaptive.mRefreshMsec == std::chrono::milliseconds(50));
+    }
+
+    SECTION("Two adaptive ranges should use the shortest min and max") {
+        modmqttd::MsgRegisterPoll other(createPoll(2,3,200));
+        other.mMaxRefreshMsec = std::chrono::milliseconds(800);
+
+        adaptive.merge(other);
+
+        REQUIRE(adaptive.mRefreshMsec == std::chrono::milliseconds(100));
+        REQUIRE(adaptive.mMaxRefreshMsec == std::chrono::milliseconds(800));
+    }
+
+    SECTION("Poll group without refresh should keep adaptive refresh") {
+        modmqttd::MsgRegisterPoll group(1, 1, modmqttd::RegisterType::INPUT, 5);
+
+        group.merge(adaptive);
+
+        REQUIRE(group.mRefreshMsec == std::chrono::milliseconds(100));
+        REQUIRE(group.mMaxRefreshMsec == std::chrono::milliseconds(1000));
+    }
+}
@@ -0,0 +1,59 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("Objects and commands with priority") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+      slaves:
+        - address: 1
+          poll_groups:
+            - register: 10
+              count: 5
+              priority: low
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+  objects:
+    - topic: alarm
+      priority: high
+      commands:
+        - name: set
+          register: tcptest.1.2
+          register_type: holding
+      state:
+        register: tcptest.1.2
+    - topic: counter
+      state:
+        register: tcptest.1.11
+)");
+
+    SECTION("should poll and write registers") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 11, modmqttd::RegisterType::HOLDING, 5);
+        server.start();
+
+        server.waitForPublish("alarm/state");
+        server.waitForMqttValue("counter/state", "5");
+
+        server.publish("alarm/set", "7");
+        server.waitForMqttValue("alarm/state", "7");
+        server.stop();
+    }
+
+    SECTION("should not start with invalid priority") {
+        config.mYAML["mqtt"]["objects"][0]["priority"] = "urgent";
+        MockedModMqttServerThread server(config.toString(), false);
+        server.start();
+        server.stop();
+        REQUIRE(server.initOk() == false);
+    }
+}
@@ -1,4 +1,6 @@
 
+#include <algorithm>
+
 #include "catch2/catch_all.hpp"
 
 #include "libmodmqttsrv/modbus_request_queues.hpp"
@@ -65,5 +67,197 @@ TEST_CASE("ModbusRequestQueues") {
 
     }
 
+    SECTION("should order polls by deadline") {
+        auto now = std::chrono::steady_clock::now();
+        auto slow = registers.addPoll(1, 1, std::chrono::seconds(60));
+        auto fast = registers.addPoll(1, 2, std::chrono::milliseconds(100));
+        slow->mLastRead = now - std::chrono::seconds(61);
+        fast->mLastRead = now - std::chrono::milliseconds(100);
+
+        queue.addPollList(registers[1]);
+
+        REQUIRE(queue.getNextDeadline() == slow->getDeadline());
+        REQUIRE(queue.popNext() == slow);
+
+        // fast register became due before slow one
+        fast->mLastRead = now - std::chrono::seconds(2);
+        queue.addPollList(registers[1]);
+        REQUIRE(queue.popNext() == fast);
+    }
+
+    SECTION("should readd poll at its deadline position") {
+        auto now = std::chrono::steady_clock::now();
+        auto first = registers.addPoll(1, 1, std::chrono::milliseconds(100));
+        first->mLastRead = now - std::chrono::milliseconds(200);
+        queue.addPollList(registers[1]);
+        auto cmd = queue.popNext();
+        REQUIRE(cmd == first);
+
+        // poll with earlier deadline queued while first was executed
+        registers[1].clear();
+        auto earlier = registers.addPoll(1, 2, std::chrono::milliseconds(100));
+        earlier->mLastRead = now - std::chrono::milliseconds(300);
+        queue.addPollList(registers[1]);
+
+        queue.readdCommand(cmd);
+        REQUIRE(queue.popNext() == earlier);
+        REQUIRE(queue.popNext() == first);
+    }
+
+    SECTION("should pop polls with higher priority first") {
+        auto now = std::chrono::steady_clock::now();
+        auto bulk = registers.addPoll(1, 1, std::chrono::seconds(60));
+        auto alarm = registers.addPoll(1, 2, std::chrono::seconds(60));
+        bulk->mPriority = modmqttd::CommandPriority::LOW;
+        alarm->mPriority = modmqttd::CommandPriority::HIGH;
+        bulk->mLastRead = now - std::chrono::seconds(61);
+        alarm->mLastRead = now - std::chrono::seconds(60);
+
+        queue.addPollList(registers[1]);
+
+        REQUIRE(queue.getNextPriority(now) == modmqttd::CommandPriority::HIGH);
+        REQUIRE(queue.popNext() == alarm);
+        REQUIRE(queue.popNext() == bulk);
+    }
+
+    SECTION("should promote low priority poll waiting longer than its refresh") {
+        auto now = std::chrono::steady_clock::now();
+        auto bulk = registers.addPoll(1, 1, std::chrono::seconds(1));
+        auto normal = registers.addPoll(1, 2, std::chrono::seconds(60));
+        bulk->mPriority = modmqttd::CommandPriority::LOW;
+        bulk->mLastRead = now - std::chrono::seconds(3);
+        normal->mLastRead = now - std::chrono::seconds(60);
+
+        REQUIRE(bulk->getEffectivePriority(now) == modmqttd::CommandPriority::HIGH);
+        REQUIRE(bulk->getEffectivePriority(now - std::chrono::seconds(1)) == modmqttd::CommandPriority::NORMAL);
+        REQUIRE(normal->getEffectivePriority(now + std::chrono::seconds(120)) == modmqttd::CommandPriority::NORMAL);
+
+        queue.addPollList(registers[1]);
+        REQUIRE(queue.popNext() == bulk);
+    }
+
+    SECTION("should pop write with higher priority before polls") {
+        auto now = std::chrono::steady_clock::now();
+        auto poll = registers.addPoll(1, 1, std::chrono::seconds(60));
+        poll->mLastRead = now - std::chrono::seconds(60);
+        queue.addPollList(registers[1]);
+
+        auto write = ModbusExecutorTestRegisters::createWrite(1, 2, 10);
+        write->mPriority = modmqttd::CommandPriority::HIGH;
+        queue.addWriteCommand(write);
+        auto lowWrite = ModbusExecutorTestRegisters::createWrite(1, 3, 10);
+        lowWrite->mPriority = modmqttd::CommandPriority::LOW;
+        queue.addWriteCommand(lowWrite);
+
+        REQUIRE(queue.popNext() == write);
+        REQUIRE(queue.popNext() == poll);
+        REQUIRE(queue.popNext() == lowWrite);
+    }
+}
+
+TEST_CASE("ModbusRequestQueues bus time credit") {
+    modmqttd::ModbusRequestsQueues queue;
+    const auto quantum = modmqttd::ModbusRequestsQueues::FAIR_QUANTUM;
+
+    SECTION("should allow commands until quantum is used") {
+        queue.addQuantum();
+        REQUIRE(queue.getCredit() == quantum);
+
+        queue.chargeTransaction(quantum / 2);
+        REQUIRE(queue.hasCredit());
+        queue.chargeTransaction(quantum / 2);
+        REQUIRE(queue.getCredit() == std::chrono::steady_clock::duration::zero());
+        REQUIRE(!queue.hasCredit());
+    }
+
+    SECTION("should not collect more than one quantum") {
+        queue.addQuantum();
+        queue.addQuantum();
+        REQUIRE(queue.getCredit() == quantum);
+    }
+
+    SECTION("should collect credit for slow transactions over turns") {
+        queue.addQuantum();
+        queue.chargeTransaction(quantum * 3);
+        REQUIRE(!queue.canAffordTurn());
+        queue.addQuantum();
+        REQUIRE(!queue.canAffordTurn());
+        queue.addQuantum();
+        REQUIRE(queue.canAffordTurn());
+    }
+
+    SECTION("should scale quantum with weight") {
+        queue.setWeight(3);
+        queue.addQuantum();
+        REQUIRE(queue.getCredit() == quantum * 3);
+    }
+}
+
+TEST_CASE("ModbusRequestQueues read coalescing") {
+    modmqttd::ModbusRequestsQueues queue;
+    ModbusExecutorTestRegisters registers;
+    auto now = std::chrono::steady_clock::now();
 
+    auto first = registers.addPoll(1, 1);
+    auto near = registers.addPoll(1, 4);
+    auto chained = registers.addPoll(1, 7);
+    auto far = registers.addPoll(1, 20);
+    queue.addPollList(registers[1]);
+    queue.popNext();
+
+    SECTION("should not coalesce if max gap is not set") {
+        REQUIRE(queue.popCoalescable(*first, now).empty());
+        REQUIRE(queue.mPollQueue.size() == 3);
+    }
+
+    SECTION("should pop due polls within max gap") {
+        queue.setMaxReadGap(2);
+        auto polls = queue.popCoalescable(*first, now);
+        REQUIRE(polls.size() == 2);
+        REQUIRE(std::find(polls.begin(), polls.end(), near) != polls.end());
+        REQUIRE(std::find(polls.begin(), polls.end(), chained) != polls.end());
+        REQUIRE(queue.mPollQueue.size() == 1);
+        REQUIRE(queue.mPollQueue.front() == far);
+    }
+
+    SECTION("should not pop polls that are not due") {
+        queue.setMaxReadGap(2);
+        near->mLastRead = now;
+        REQUIRE(queue.popCoalescable(*first, now).empty());
+    }
+
+    SECTION("should respect modbus PDU limit") {
+        queue.setMaxReadGap(200);
+        auto big = std::make_shared<modmqttd::RegisterPoll>(1, 100, modmqttd::RegisterType::HOLDING, 30, std::chrono::milliseconds(10), modmqttd::PublishMode::ON_CHANGE);
+        queue.addPollList(std::vector<std::shared_ptr<modmqttd::RegisterPoll>>(1, big));
+        auto polls = queue.popCoalescable(*first, now);
+        REQUIRE(polls.size() == 3);
+        REQUIRE(std::find(polls.begin(), polls.end(), big) == polls.end());
+    }
+}
+
+TEST_CASE("RegisterPoll deadline stats") {
+    auto now = std::chrono::steady_clock::now();
+    modmqttd::RegisterPoll reg(1, 1, modmqttd::RegisterType::HOLDING, 1, std::chrono::milliseconds(100), modmqttd::PublishMode::ON_CHANGE);
+    reg.mLastRead = now - std::chrono::milliseconds(100);
+
+    SECTION("should not count poll on time as late") {
+        reg.updateDeadlineStats(now);
+        modmqttd::RegisterPoll::DeadlineStats stats(reg.popDeadlineStats());
+        REQUIRE(stats.mPollCount == 1);
+        REQUIRE(stats.mMissedCount == 0);
+        REQUIRE(stats.mMaxLateness == std::chrono::steady_clock::duration::zero());
+    }
+
+    SECTION("should count lateness and missed deadlines") {
+        reg.updateDeadlineStats(now + std::chrono::milliseconds(50));
+        reg.updateDeadlineStats(now + std::chrono::milliseconds(150));
+        modmqttd::RegisterPoll::DeadlineStats stats(reg.popDeadlineStats());
+        REQUIRE(stats.mPollCount == 2);
+        REQUIRE(stats.mMissedCount == 1);
+        REQUIRE(stats.mMaxLateness == std::chrono::milliseconds(150));
+        REQUIRE(stats.mTotalLateness == std::chrono::milliseconds(200));
+
+        REQUIRE(reg.popDeadlineStats().mPollCount == 0);
+    }
 }
@@ -86,3 +86,90 @@ SECTION ("should issue many write calls if write_retries is set on slave level")
 
 }
 
+TEST_CASE ("Write retry with backoff") {
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+      retry_backoff: 50ms
+mqtt:
+  client_id: mqtt_test
+  broker:
+    host: localhost
+  objects:
+    - topic: write_fail
+      commands:
+       - name: set
+         register: tcptest.1.2
+         register_type: holding
+)");
+
+SECTION ("should not retry before backoff period") {
+    MockedModMqttServerThread server(config.toString());
+    server.mModbusFactory->setModbusRegisterWriteError("tcptest", 1, 2, modmqttd::RegisterType::HOLDING);
+
+    server.start();
+
+    server.waitForSubscription("write_fail/set");
+    server.publish("write_fail/set", "7");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    REQUIRE(server.getMockedModbusContext("tcptest").getWriteCount(1) == 1);
+
+    // default is 2 + original call
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    server.stop();
+    REQUIRE(server.getMockedModbusContext("tcptest").getWriteCount(1) == 3);
+}
+
+}
+
+TEST_CASE ("Read retry with backoff") {
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+      retry_backoff: 5s
+mqtt:
+  client_id: mqtt_test
+  broker:
+    host: localhost
+  objects:
+    - topic: slow_sensor
+      state:
+        register: tcptest.1.1
+        register_type: holding
+        refresh: 200ms
+    - topic: fast_sensor
+      state:
+        register: tcptest.1.2
+        register_type: holding
+        refresh: 50ms
+)");
+
+SECTION ("should poll other registers while waiting for retry") {
+    MockedModMqttServerThread server(config.toString());
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+
+    server.start();
+
+    server.waitForPublish("slow_sensor/state");
+    server.waitForPublish("fast_sensor/state");
+    REQUIRE(server.mqttValue("fast_sensor/state") == "1");
+
+    // next read of slow_sensor fails and waits 5s for retry
+    server.mModbusFactory->setModbusRegisterReadError("tcptest", 1, 1, modmqttd::RegisterType::HOLDING);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+    server.waitForPublish("fast_sensor/state", std::chrono::milliseconds(1000));
+    REQUIRE(server.mqttValue("fast_sensor/state") == "2");
+
+    server.stop();
+}
+
+}
@@ -2,6 +2,7 @@
 
 #include "defaults.hpp"
 #include "mockedserver.hpp"
+#include "yaml_utils.hpp"
 
 TEST_CASE ("Modbus watchdog") {
 
@@ -115,3 +116,60 @@ mqtt:
 }
 
 } //CASE
+
+TEST_CASE ("Modbus reconnect") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+      watchdog:
+        watch_period: 300ms
+mqtt:
+  client_id: mqtt_test
+  refresh: 100ms
+  broker:
+    host: localhost
+  objects:
+    - topic: fast
+      state:
+        register: tcptest.1.1
+    - topic: slow
+      state:
+        register: tcptest.3.1
+        refresh: 10s
+)");
+
+    SECTION("should read all registers after reconnect by default") {
+        MockedModMqttServerThread server(config.toString());
+        server.start();
+        server.waitForPublish("slow/state");
+
+        server.disconnectModbusSlave("tcptest", 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(450));
+        server.connectModbusSlave("tcptest", 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        server.stop();
+
+        REQUIRE(server.getMockedModbusContext("tcptest").getConnectionCount() == 2);
+        REQUIRE(server.getMockedModbusContext("tcptest").getReadCount(3) == 2);
+    }
+
+    SECTION("should resume polling after short reconnect") {
+        config.mYAML["modbus"]["networks"][0]["reconnect_resume_period"] = "5s";
+        MockedModMqttServerThread server(config.toString());
+        server.start();
+        server.waitForPublish("slow/state");
+
+        server.disconnectModbusSlave("tcptest", 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(450));
+        server.connectModbusSlave("tcptest", 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        server.stop();
+
+        REQUIRE(server.getMockedModbusContext("tcptest").getConnectionCount() == 2);
+        REQUIRE(server.getMockedModbusContext("tcptest").getReadCount(3) == 1);
+    }
+}
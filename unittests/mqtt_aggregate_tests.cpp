@@ -0,0 +1,144 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+#include "libmodmqttsrv/mqttaggregate.hpp"
+#include "libmodmqttsrv/mqttobject.hpp"
+#include "libmodmqttsrv/mqttpayload.hpp"
+#include "libmodmqttsrv/modbus_messages.hpp"
+
+TEST_CASE ("Aggregate accumulator") {
+    modmqttd::MqttAggregate aggregate(std::chrono::milliseconds(100), { modmqttd::MqttAggregate::Function::MIN });
+    aggregate.setValueCount(1);
+    auto now = std::chrono::steady_clock::now();
+
+    SECTION("should compute min, max, sum and last value") {
+        aggregate.addSample(0, MqttValue(10), now);
+        aggregate.addSample(0, MqttValue(30), now);
+        aggregate.addSample(0, MqttValue(20), now);
+
+        const modmqttd::MqttAggregate::Accumulator& acc(aggregate.getAccumulator(0));
+        REQUIRE(acc.mCount == 3);
+        REQUIRE(acc.mMin == 10);
+        REQUIRE(acc.mMax == 30);
+        REQUIRE(acc.mSum == 60);
+        REQUIRE(acc.mLast == 20);
+        REQUIRE(acc.mIsInteger);
+    }
+
+    SECTION("should start window with the first sample") {
+        REQUIRE(!aggregate.isWindowFinished(now + std::chrono::hours(1)));
+        aggregate.addSample(0, MqttValue(1.5, 1), now);
+        REQUIRE(!aggregate.getAccumulator(0).mIsInteger);
+        REQUIRE(!aggregate.isWindowFinished(now + std::chrono::milliseconds(99)));
+        REQUIRE(aggregate.isWindowFinished(now + std::chrono::milliseconds(100)));
+
+        aggregate.finishWindow(now + std::chrono::milliseconds(110));
+        REQUIRE(!aggregate.hasSamples());
+        REQUIRE(aggregate.getWindowEnd() == now + std::chrono::milliseconds(200));
+
+        // empty window stops timer until next sample
+        aggregate.finishWindow(now + std::chrono::milliseconds(210));
+        REQUIRE(aggregate.getWindowEnd() == std::chrono::steady_clock::time_point::max());
+    }
+}
+
+TEST_CASE ("Aggregated object") {
+    modmqttd::MqttObject obj("test_sensor");
+    for(int reg: {1, 100}) {
+        modmqttd::MqttObjectDataNode node;
+        node.setName(std::to_string(reg));
+        node.setScalarNode(modmqttd::MqttObjectRegisterIdent("tcptest", 1, modmqttd::RegisterType::HOLDING, reg));
+        obj.mState.addDataNode(node);
+    }
+    obj.setAggregate(std::shared_ptr<modmqttd::MqttAggregate>(
+        new modmqttd::MqttAggregate(std::chrono::seconds(1), { modmqttd::MqttAggregate::Function::AVG })
+    ));
+    obj.setModbusNetworkState("tcptest", true);
+
+    SECTION("should add samples only for nodes with registers in message") {
+        obj.updateRegisterValues("tcptest", modmqttd::MsgRegisterValues(1, modmqttd::RegisterType::HOLDING, 1, std::vector<uint16_t>({10})));
+        obj.updateRegisterValues("tcptest", modmqttd::MsgRegisterValues(1, modmqttd::RegisterType::HOLDING, 100, std::vector<uint16_t>({20})));
+        REQUIRE(obj.getAggregate().getAccumulator(1).mCount == 1);
+        int count = obj.getAggregate().getAccumulator(0).mCount;
+
+        obj.updateRegisterValues("tcptest", modmqttd::MsgRegisterValues(1, modmqttd::RegisterType::HOLDING, 1, std::vector<uint16_t>({11})));
+        obj.updateRegisterValues("tcptest", modmqttd::MsgRegisterValues(1, modmqttd::RegisterType::HOLDING, 1, std::vector<uint16_t>({12})));
+        REQUIRE(obj.getAggregate().getAccumulator(0).mCount == count + 2);
+        REQUIRE(obj.getAggregate().getAccumulator(1).mCount == 1);
+    }
+
+    SECTION("should format every node with its own precision") {
+        auto now = std::chrono::steady_clock::now();
+        obj.getAggregate().addSample(0, MqttValue(1.5, 1), now);
+        obj.getAggregate().addSample(1, MqttValue(2.125), now);
+        REQUIRE(modmqttd::MqttPayload::generateAggregate(obj) == R"({"1":{"avg":1.5},"100":{"avg":2.125}})");
+    }
+}
+
+TEST_CASE ("Aggregated state") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor
+      state:
+        register: tcptest.1.2
+        aggregate:
+          window: 100ms
+          functions: [min, max, avg, last]
+)");
+
+    SECTION("should publish aggregated values once per window") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 7);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", R"({"min":7,"max":7,"avg":7.0,"last":7})", std::chrono::milliseconds(300));
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        server.stop();
+        // at least 10 polls in every window
+        REQUIRE(server.getPublishCount("test_sensor/state") <= 3);
+    }
+
+    SECTION("should publish named values as map") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["name"] = "power";
+        config.mYAML["mqtt"]["objects"][0]["state"]["aggregate"]["functions"] = YAML::Load("[max]");
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 7);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", R"({"power":{"max":7}})", std::chrono::milliseconds(300));
+        server.stop();
+    }
+
+    SECTION("should publish register list as array") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["count"] = 2;
+        config.mYAML["mqtt"]["objects"][0]["state"]["aggregate"]["functions"] = YAML::Load("[min]");
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 7);
+        server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 8);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", R"([{"min":7},{"min":8}])", std::chrono::milliseconds(300));
+        server.stop();
+    }
+
+    SECTION("should fail to start with unknown function") {
+        config.mYAML["mqtt"]["objects"][0]["state"]["aggregate"]["functions"] = YAML::Load("[median]");
+        MockedModMqttServerThread server(config.toString(), false);
+        server.start();
+        server.stop();
+        REQUIRE(server.initOk() == false);
+    }
+}
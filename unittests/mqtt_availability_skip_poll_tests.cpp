@@ -0,0 +1,97 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("State poll should be suspended when object is not available") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor
+      state:
+        register: tcptest.2.20
+      availability:
+        register: tcptest.1.2
+        available_value: 1
+        skip_state_poll: true
+)");
+
+    MockedModMqttServerThread server(config.toString());
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+    server.setModbusRegisterValue("tcptest", 2, 20, modmqttd::RegisterType::HOLDING, 5);
+    server.start();
+
+    server.waitForMqttValue("test_sensor/availability", "1");
+    server.waitForMqttValue("test_sensor/state", "5");
+
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 0);
+    server.waitForMqttValue("test_sensor/availability", "0");
+
+    SECTION("should not poll state registers") {
+        // suspend message may arrive after next scheduled poll
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        int readCount = server.getMockedModbusContext("tcptest").getReadCount(2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(server.getMockedModbusContext("tcptest").getReadCount(2) == readCount);
+    }
+
+    SECTION("should publish fresh state after availability is restored") {
+        server.setModbusRegisterValue("tcptest", 2, 20, modmqttd::RegisterType::HOLDING, 7);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.waitForMqttValue("test_sensor/availability", "1");
+        REQUIRE(server.mqttValue("test_sensor/state") == "7");
+    }
+
+    server.stop();
+}
+
+TEST_CASE ("State poll shared with always available object should not be suspended") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor
+      state:
+        register: tcptest.2.20
+      availability:
+        register: tcptest.1.2
+        available_value: 1
+        skip_state_poll: true
+    - topic: other_sensor
+      state:
+        register: tcptest.2.20
+)");
+
+    MockedModMqttServerThread server(config.toString());
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 0);
+    server.setModbusRegisterValue("tcptest", 2, 20, modmqttd::RegisterType::HOLDING, 5);
+    server.start();
+
+    server.waitForMqttValue("test_sensor/availability", "0");
+    server.waitForMqttValue("other_sensor/state", "5");
+
+    server.setModbusRegisterValue("tcptest", 2, 20, modmqttd::RegisterType::HOLDING, 6);
+    server.waitForMqttValue("other_sensor/state", "6");
+
+    server.stop();
+}
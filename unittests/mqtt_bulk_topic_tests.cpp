@@ -0,0 +1,59 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("Bulk topic") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+      bulk_topic: ${network}/bulk
+      bulk_period: 50ms
+      slaves:
+        - address: 1
+          bulk_topic: ${network}/${slave_address}/bulk
+          bulk_period: 50ms
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor1
+      state:
+        register: tcptest.1.1
+    - topic: test_sensor2
+      state:
+        - name: voltage
+          register: tcptest.2.1
+        - name: current
+          register: tcptest.2.2
+)");
+
+    SECTION("should publish snapshot of all network objects") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+        server.setModbusRegisterValue("tcptest", 2, 1, modmqttd::RegisterType::HOLDING, 230);
+        server.setModbusRegisterValue("tcptest", 2, 2, modmqttd::RegisterType::HOLDING, 3);
+        server.start();
+
+        server.waitForMqttValue("tcptest/bulk", R"({"test_sensor1":1,"test_sensor2":{"voltage":230,"current":3}})");
+        server.waitForMqttValue("tcptest/1/bulk", R"({"test_sensor1":1})");
+
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 7);
+        server.waitForMqttValue("tcptest/1/bulk", R"({"test_sensor1":7})");
+        server.stop();
+    }
+
+    SECTION("should fail if network bulk topic contains slave placeholder") {
+        config.mYAML["modbus"]["networks"][0]["bulk_topic"] = "${slave_address}/bulk";
+        MockedModMqttServerThread server(config.toString(), false);
+        server.start();
+        server.stop();
+        REQUIRE(server.initOk() == false);
+    }
+}
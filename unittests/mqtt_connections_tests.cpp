@@ -0,0 +1,230 @@
+#include <cstdio>
+
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+/*
+    Topics are assigned to connections by FNV-1a hash of topic name:
+    sensor1/state - primary connection
+    sensor2/state - connection 1
+    sensor5/state - connection 2
+*/
+TEST_CASE ("Multiple broker connections") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+    connections: 3
+  objects:
+    - topic: sensor1
+      commands:
+        - name: set
+          register: tcptest.1.1
+      state:
+        register: tcptest.1.1
+    - topic: sensor2
+      state:
+        register: tcptest.1.2
+    - topic: sensor5
+      state:
+        register: tcptest.1.5
+)");
+
+    MockedModMqttServerThread server(config.toString());
+    std::shared_ptr<MockedMqttImpl> conn1(server.addMqttConnection());
+    std::shared_ptr<MockedMqttImpl> conn2(server.addMqttConnection());
+    server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+    server.setModbusRegisterValue("tcptest", 1, 5, modmqttd::RegisterType::HOLDING, 5);
+    server.start();
+
+    server.waitForMqttValue("sensor1/state", "1");
+    REQUIRE(conn1->waitForPublish("sensor2/state", defaultWaitTime()));
+    REQUIRE(conn2->waitForPublish("sensor5/state", defaultWaitTime()));
+
+    SECTION("should publish every topic on a single connection") {
+        REQUIRE(conn1->mqttValue("sensor2/state") == "2");
+        REQUIRE(conn2->mqttValue("sensor5/state") == "5");
+        REQUIRE(!server.mMqtt->hasTopic("sensor2/state"));
+        REQUIRE(!server.mMqtt->hasTopic("sensor5/state"));
+        REQUIRE(!conn1->hasTopic("sensor1/state"));
+        REQUIRE(!conn2->hasTopic("sensor1/state"));
+        REQUIRE(!conn2->hasTopic("sensor2/state"));
+    }
+
+    SECTION("should subscribe commands on primary connection") {
+        server.waitForSubscription("sensor1/set");
+        server.publish("sensor1/set", "7");
+        server.waitForMqttValue("sensor1/state", "7");
+        REQUIRE(!conn1->waitForSubscription("sensor1/set", std::chrono::milliseconds(50)));
+    }
+
+    SECTION("should republish topics of additional connection after it is restored") {
+        conn1->setBrokerUp(false);
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 20);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(conn1->mqttValue("sensor2/state") == "2");
+
+        conn1->setBrokerUp(true);
+        REQUIRE(conn1->waitForMqttValue("sensor2/state", "20", defaultWaitTime()) == "20");
+        REQUIRE(!server.mMqtt->hasTopic("sensor2/state"));
+    }
+
+    server.stop();
+}
+
+TEST_CASE ("QoS publish on multiple broker connections") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+    connections: 3
+    max_inflight: 1
+  objects:
+    - topic: sensor1
+      qos: 1
+      state:
+        register: tcptest.1.1
+    - topic: sensor2
+      qos: 1
+      state:
+        register: tcptest.1.2
+)");
+
+    MockedModMqttServerThread server(config.toString());
+    std::shared_ptr<MockedMqttImpl> conn1(server.addMqttConnection());
+    std::shared_ptr<MockedMqttImpl> conn2(server.addMqttConnection());
+    server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+    server.start();
+
+    server.waitForMqttValue("sensor1/state", "1");
+    REQUIRE(conn1->waitForMqttValue("sensor2/state", "2", defaultWaitTime()) == "2");
+
+    SECTION("should limit messages in flight for every connection separately") {
+        // primary connection window is still full
+        conn1->ackPublishes();
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 20);
+        REQUIRE(conn1->waitForMqttValue("sensor2/state", "20", defaultWaitTime()) == "20");
+
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 10);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(server.mqttValue("sensor1/state") == "1");
+
+        server.mMqtt->ackPublishes();
+        server.waitForMqttValue("sensor1/state", "10");
+    }
+
+    SECTION("should hold back state until additional connection is restored") {
+        conn1->ackPublishes();
+        conn1->setBrokerUp(false);
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 20);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 21);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        conn1->setBrokerUp(true);
+        REQUIRE(conn1->waitForMqttValue("sensor2/state", "21", defaultWaitTime()) == "21");
+        REQUIRE(!server.mMqtt->hasTopic("sensor2/state"));
+    }
+
+    server.stop();
+}
+
+TEST_CASE ("Publish buffer on multiple broker connections") {
+    static const char* BUFFER_PATH = "/tmp/mqmgateway_connections_buffer_test";
+    std::remove(BUFFER_PATH);
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+    connections: 3
+  buffer:
+    path: /tmp/mqmgateway_connections_buffer_test
+  objects:
+    - topic: sensor1
+      state:
+        register: tcptest.1.1
+    - topic: sensor2
+      state:
+        register: tcptest.1.2
+)");
+
+    MockedModMqttServerThread server(config.toString());
+    std::shared_ptr<MockedMqttImpl> conn1(server.addMqttConnection());
+    std::shared_ptr<MockedMqttImpl> conn2(server.addMqttConnection());
+    server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+    server.start();
+
+    server.waitForMqttValue("sensor1/state", "1");
+    REQUIRE(conn1->waitForMqttValue("sensor2/state", "2", defaultWaitTime()) == "2");
+
+    SECTION("should buffer messages while additional connection is down") {
+        conn1->setBrokerUp(false);
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 20);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 21);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(conn1->getPublishCount("sensor2/state") == 1);
+
+        conn1->setBrokerUp(true);
+        REQUIRE(conn1->waitForMqttValue("sensor2/state", "21", defaultWaitTime()) == "21");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        // 20 and 21 from buffer and current state after reconnect
+        REQUIRE(conn1->getPublishCount("sensor2/state") == 4);
+        REQUIRE(!server.mMqtt->hasTopic("sensor2/state"));
+    }
+
+    server.stop();
+    std::remove(BUFFER_PATH);
+}
+
+TEST_CASE ("Invalid number of broker connections should be rejected") {
+    TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  broker:
+    host: localhost
+    connections: 0
+  objects:
+    - topic: sensor1
+      state:
+        register: tcptest.1.1
+)");
+    MockedModMqttServerThread server(config.toString(), false);
+    server.start();
+    server.stop();
+    REQUIRE(!server.initOk());
+}
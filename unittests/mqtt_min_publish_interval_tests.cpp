@@ -0,0 +1,55 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("Min publish interval") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 5ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor
+      min_publish_interval: 100ms
+      state:
+        register: tcptest.1.2
+)");
+
+    SECTION("should publish the latest value after interval") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "1");
+        for (int i = 2; i <= 5; i++) {
+            server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, i);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        server.waitForMqttValue("test_sensor/state", "5", std::chrono::milliseconds(200));
+        server.stop();
+        // initial value and the latest one, changes in between are coalesced
+        server.requirePublishCount("test_sensor/state", 2);
+    }
+
+    SECTION("should not publish if state is back to the last published one") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "1");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        server.stop();
+        server.requirePublishCount("test_sensor/state", 1);
+    }
+}
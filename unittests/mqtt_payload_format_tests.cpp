@@ -0,0 +1,111 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "jsonutils.hpp"
+#include "payload_decoder.hpp"
+#include "yaml_utils.hpp"
+
+static const std::string config = R"(
+modmqttd:
+  converter_search_path:
+    - build/stdconv
+  converter_plugins:
+    - stdconv.so
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 50ms
+  broker:
+    host: localhost
+  objects:
+    - topic: test_map
+      state:
+        - name: small
+          register: tcptest.1.1
+        - name: big
+          register: tcptest.1.2
+        - name: negative
+          register: tcptest.1.3
+          converter: std.int16()
+        - name: ratio
+          register: tcptest.1.4
+          converter: std.divide(3,3)
+        - name: half
+          register: tcptest.1.5
+          converter: std.divide(2,1)
+    - topic: test_list
+      state:
+        - register: tcptest.1.1
+        - register: tcptest.1.2
+    - topic: test_scalar
+      state:
+        register: tcptest.1.2
+)";
+
+static std::string
+readPayloads(const std::string& pConfig, const std::string& pTopic) {
+    MockedModMqttServerThread server(pConfig);
+    server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 7);
+    server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 40000);
+    server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 0xfff6);
+    server.setModbusRegisterValue("tcptest", 1, 4, modmqttd::RegisterType::HOLDING, 1000);
+    server.setModbusRegisterValue("tcptest", 1, 5, modmqttd::RegisterType::HOLDING, 25);
+    server.start();
+    server.waitForPublish(pTopic.c_str());
+    std::string ret = server.mqttValue(pTopic.c_str());
+    server.stop();
+    return ret;
+}
+
+TEST_CASE ("Binary payload formats should decode to the same value as JSON") {
+    TestConfig cfg(config);
+    const std::string topic = GENERATE(
+        std::string("test_map/state"),
+        std::string("test_list/state"),
+        std::string("test_scalar/state")
+    );
+
+    std::string json = readPayloads(cfg.toString(), topic);
+
+    SECTION("for CBOR") {
+        cfg.mYAML["mqtt"]["payload_format"] = "cbor";
+        std::string cbor = readPayloads(cfg.toString(), topic);
+        REQUIRE(cbor != json);
+        REQUIRE_JSON(cborToJson(cbor), json.c_str());
+    }
+
+    SECTION("for MessagePack") {
+        cfg.mYAML["mqtt"]["payload_format"] = "msgpack";
+        std::string msgpack = readPayloads(cfg.toString(), topic);
+        REQUIRE(msgpack != json);
+        REQUIRE_JSON(msgpackToJson(msgpack), json.c_str());
+    }
+}
+
+TEST_CASE ("Binary payload should use compact encoding") {
+    TestConfig cfg(config);
+
+    SECTION("for CBOR") {
+        cfg.mYAML["mqtt"]["objects"][2]["payload_format"] = "cbor";
+        // unsigned int with 16 bit argument
+        REQUIRE(readPayloads(cfg.toString(), "test_scalar/state") == std::string("\x19\x9c\x40", 3));
+    }
+
+    SECTION("for MessagePack") {
+        cfg.mYAML["mqtt"]["objects"][2]["payload_format"] = "msgpack";
+        // uint 16
+        REQUIRE(readPayloads(cfg.toString(), "test_scalar/state") == std::string("\xcd\x9c\x40", 3));
+    }
+}
+
+TEST_CASE ("Invalid payload format should be rejected") {
+    TestConfig cfg(config);
+    cfg.mYAML["mqtt"]["payload_format"] = "xml";
+    MockedModMqttServerThread server(cfg.toString(), false);
+    server.start();
+    server.stop();
+    REQUIRE(!server.initOk());
+}
@@ -0,0 +1,85 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "jsonutils.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("Publish thread") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  publish_thread: true
+  broker:
+    host: localhost
+    max_inflight: 2
+  objects:
+    - topic: test_sensor
+      state:
+        register: tcptest.1.2
+    - topic: test_map
+      state:
+        - name: a
+          register: tcptest.1.3
+        - name: b
+          register: tcptest.1.4
+)");
+
+    SECTION("should publish state changes") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 3);
+        server.setModbusRegisterValue("tcptest", 1, 4, modmqttd::RegisterType::HOLDING, 4);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "1");
+        server.waitForMqttValue("test_sensor/availability", "1");
+        server.waitForPublish("test_map/state");
+        REQUIRE_JSON(server.mqttValue("test_map/state"), "{\"a\": 3, \"b\": 4}");
+
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        server.waitForMqttValue("test_sensor/state", "2");
+        server.stop();
+    }
+
+    SECTION("should count queued QoS messages as in flight") {
+        config.mYAML["mqtt"]["objects"][0]["qos"] = 1;
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        // state and availability fill the in-flight window
+        server.waitForMqttValue("test_sensor/state", "1");
+        server.waitForMqttValue("test_sensor/availability", "1");
+        server.waitForMqttValue("test_map/state", R"({"a":0,"b":0})");
+
+        // QoS 0 test_map changes are published in order of register reads,
+        // so after two of them test_sensor register was read again
+        int mapValue = 0;
+        auto waitForNextRead = [&]() {
+            for (int j = 0; j < 2; j++) {
+                mapValue++;
+                server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, mapValue);
+                std::string expected(R"({"a":)" + std::to_string(mapValue) + R"(,"b":0})");
+                server.waitForMqttValue("test_map/state", expected.c_str());
+            }
+        };
+
+        for (int i = 2; i <= 4; i++) {
+            server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, i);
+            waitForNextRead();
+        }
+        REQUIRE(server.mqttValue("test_sensor/state") == "1");
+
+        server.mMqtt->ackPublishes();
+        server.waitForMqttValue("test_sensor/state", "4");
+        server.stop();
+        server.requirePublishCount("test_sensor/state", 2);
+    }
+}
@@ -0,0 +1,112 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("QoS publish") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+    max_inflight: 2
+  objects:
+    - topic: test_sensor
+      qos: 1
+      state:
+        register: tcptest.1.2
+)");
+
+    SECTION("should publish state and availability with configured qos") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "1");
+        server.waitForMqttValue("test_sensor/availability", "1");
+        REQUIRE(server.mMqtt->getQos("test_sensor/state") == 1);
+        REQUIRE(server.mMqtt->getQos("test_sensor/availability") == 1);
+        server.stop();
+    }
+
+    SECTION("should publish the latest state after in-flight messages are acknowledged") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        // state and availability fill the in-flight window
+        server.waitForMqttValue("test_sensor/state", "1");
+        server.waitForMqttValue("test_sensor/availability", "1");
+        for (int i = 2; i <= 4; i++) {
+            server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, i);
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        }
+        REQUIRE(server.mqttValue("test_sensor/state") == "1");
+
+        server.mMqtt->ackPublishes();
+        server.waitForMqttValue("test_sensor/state", "4");
+        server.stop();
+        // changes made while window was full are coalesced
+        server.requirePublishCount("test_sensor/state", 2);
+    }
+
+    SECTION("should keep messages resent after reconnect in flight") {
+        config.mYAML["mqtt"]["broker"]["max_inflight"] = 3;
+        MockedModMqttServerThread server(config.toString());
+        server.mMqtt->setSessionPresent(true);
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "1");
+        server.waitForMqttValue("test_sensor/availability", "1");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        server.waitForMqttValue("test_sensor/state", "2");
+
+        // unacknowledged messages are resent with the same ids
+        server.mMqtt->setBrokerUp(false);
+        server.mMqtt->setBrokerUp(true);
+
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 3);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(server.mqttValue("test_sensor/state") == "2");
+
+        server.mMqtt->ackPublishes();
+        server.waitForMqttValue("test_sensor/state", "3");
+        server.stop();
+    }
+
+    SECTION("should drop in-flight messages after reconnect without session") {
+        config.mYAML["mqtt"]["broker"]["max_inflight"] = 3;
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "1");
+        server.waitForMqttValue("test_sensor/availability", "1");
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        server.waitForMqttValue("test_sensor/state", "2");
+
+        // broker without session never acknowledges them
+        server.mMqtt->setBrokerUp(false);
+        server.mMqtt->setBrokerUp(true);
+
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 3);
+        server.waitForMqttValue("test_sensor/state", "3");
+        server.stop();
+    }
+
+    SECTION("should fail to start with invalid qos") {
+        config.mYAML["mqtt"]["objects"][0]["qos"] = 3;
+        MockedModMqttServerThread server(config.toString(), false);
+        server.start();
+        server.stop();
+        REQUIRE(server.initOk() == false);
+    }
+}
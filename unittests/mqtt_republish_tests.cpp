@@ -0,0 +1,84 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("Republish after broker reconnect") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  republish_rate: 5
+  republish_burst: 1
+  broker:
+    host: localhost
+  objects:
+    - topic: test_sensor1
+      state:
+        register: tcptest.1.1
+    - topic: test_sensor2
+      state:
+        register: tcptest.1.2
+    - topic: test_sensor3
+      priority: high
+      state:
+        register: tcptest.1.3
+)");
+
+    SECTION("should publish objects with higher priority first") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 3);
+        server.start();
+
+        server.waitForMqttValue("test_sensor1/state", "1");
+        server.waitForMqttValue("test_sensor2/state", "2");
+        server.waitForMqttValue("test_sensor3/state", "3");
+        // let the token bucket refill after initial connect
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+        server.mMqtt->resetBroker();
+
+        server.waitForPublish("test_sensor3/state");
+        REQUIRE(server.mqttValue("test_sensor3/state") == "3");
+        // next object is published after 200ms
+        REQUIRE(!server.mMqtt->hasTopic("test_sensor1/state"));
+        REQUIRE(!server.mMqtt->hasTopic("test_sensor2/state"));
+
+        server.waitForPublish("test_sensor1/state", std::chrono::seconds(1));
+        REQUIRE(server.mqttValue("test_sensor1/state") == "1");
+        server.waitForPublish("test_sensor2/state", std::chrono::seconds(1));
+        REQUIRE(server.mqttValue("test_sensor2/state") == "2");
+        server.stop();
+    }
+
+    SECTION("should not republish state changed after reconnect") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        server.setModbusRegisterValue("tcptest", 1, 3, modmqttd::RegisterType::HOLDING, 3);
+        server.start();
+
+        server.waitForMqttValue("test_sensor2/state", "2");
+        server.waitForMqttValue("test_sensor3/state", "3");
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+        server.mMqtt->resetBroker();
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 20);
+        server.waitForMqttValue("test_sensor2/state", "20");
+
+        server.waitForPublish("test_sensor1/state", std::chrono::seconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        server.stop();
+
+        // broker reset clears publish counters, only the changed value is expected
+        server.requirePublishCount("test_sensor2/state", 1);
+    }
+}
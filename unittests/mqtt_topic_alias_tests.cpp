@@ -0,0 +1,115 @@
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+TEST_CASE ("MQTT v5 topic aliases") {
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  publish_mode: every_poll
+  broker:
+    host: localhost
+    protocol_version: 5
+    topic_alias_maximum: 1
+    topic_alias_refresh: 100ms
+  objects:
+    - topic: hot_sensor
+      state:
+        register: tcptest.1.1
+    - topic: cold_sensor
+      state:
+        register: tcptest.1.2
+        refresh: 1s
+)");
+
+    SECTION("should use alias for the most frequently published topic") {
+        MockedModMqttServerThread server(config.toString());
+        server.mMqtt->setTopicAliasMaximum(10);
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        server.start();
+
+        server.waitForMqttValue("hot_sensor/state", "1");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 5);
+        server.waitForMqttValue("hot_sensor/state", "5");
+        server.stop();
+
+        REQUIRE(server.mMqtt->getAliasOnlyPublishCount("hot_sensor/state") > 0);
+        REQUIRE(server.mMqtt->getAliasOnlyPublishCount("cold_sensor/state") == 0);
+    }
+
+    SECTION("should send topic name again after reconnect") {
+        MockedModMqttServerThread server(config.toString());
+        server.mMqtt->setTopicAliasMaximum(10);
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("hot_sensor/state", "1");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        REQUIRE(server.mMqtt->getAliasOnlyPublishCount("hot_sensor/state") > 0);
+
+        server.mMqtt->resetBroker();
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 7);
+        // broker drops publishes with unknown alias
+        server.waitForMqttValue("hot_sensor/state", "7");
+        server.stop();
+    }
+
+    SECTION("should send topic name again if publish with alias failed") {
+        MockedModMqttServerThread server(config.toString());
+        server.mMqtt->setTopicAliasMaximum(10);
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("hot_sensor/state", "1");
+        // alias is assigned while publishes fail
+        server.mMqtt->setPublishError("hot_sensor/state");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        server.mMqtt->setPublishError("hot_sensor/state", false);
+
+        // broker drops publishes with unknown alias
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 5);
+        server.waitForMqttValue("hot_sensor/state", "5");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server.stop();
+
+        REQUIRE(server.mMqtt->getAliasOnlyPublishCount("hot_sensor/state") > 0);
+    }
+
+    SECTION("should not use aliases if broker does not accept them") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("hot_sensor/state", "1");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 5);
+        server.waitForMqttValue("hot_sensor/state", "5");
+        server.stop();
+
+        REQUIRE(server.mMqtt->getAliasOnlyPublishCount("hot_sensor/state") == 0);
+    }
+
+    SECTION("should not use aliases with MQTT 3.1.1") {
+        config.mYAML["mqtt"]["broker"]["protocol_version"] = "3.1.1";
+        MockedModMqttServerThread server(config.toString());
+        server.mMqtt->setTopicAliasMaximum(10);
+        server.setModbusRegisterValue("tcptest", 1, 1, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("hot_sensor/state", "1");
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        server.stop();
+
+        REQUIRE(server.mMqtt->getAliasOnlyPublishCount("hot_sensor/state") == 0);
+    }
+}
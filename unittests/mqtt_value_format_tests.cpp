@@ -0,0 +1,118 @@
+#include "catch2/catch_all.hpp"
+#include "libmodmqttconv/mqttvalue.hpp"
+
+#include <cfloat>
+#include <random>
+#include <vector>
+
+// stream based formatting used before MqttValue::toChars
+static std::string
+streamFormat(const MqttValue& pValue) {
+    switch(pValue.getSourceType()) {
+        case MqttValue::SourceType::INT:
+            return std::to_string(pValue.getInt());
+        case MqttValue::SourceType::INT64:
+            return std::to_string(pValue.getInt64());
+        default:
+            break;
+    }
+
+    double value = pValue.getDouble();
+    double intpart;
+    modf(value, &intpart);
+
+    if (intpart == value && pValue.getDoublePrecision() == MqttValue::NO_PRECISION)
+        return std::to_string(int64_t(intpart));
+
+    std::stringstream sstream;
+    sstream.setf(std::ios::fixed);
+
+    if (pValue.getDoublePrecision() != MqttValue::NO_PRECISION)
+        sstream.precision(pValue.getDoublePrecision());
+
+    sstream << value;
+    return sstream.str();
+}
+
+
+// values seen in publishes: raw registers, scaled readings and int32 counters
+static std::vector<MqttValue>
+createSampleValues(size_t pCount) {
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<int> reg(0, UINT16_MAX);
+    std::uniform_int_distribution<int32_t> counter(INT32_MIN, INT32_MAX);
+    std::uniform_int_distribution<int> precision(0, 3);
+    std::uniform_real_distribution<double> temperature(-40, 120);
+
+    std::vector<MqttValue> ret;
+    for(size_t i = 0; i < pCount; i++) {
+        switch(i % 5) {
+            case 0: ret.push_back(MqttValue::fromInt(reg(gen))); break;
+            case 1: ret.push_back(MqttValue::fromInt64(int64_t(counter(gen)) * 1000)); break;
+            case 2: ret.push_back(MqttValue::fromDouble(reg(gen) / 10.0, precision(gen))); break;
+            case 3: ret.push_back(MqttValue::fromDouble(temperature(gen))); break;
+            case 4: ret.push_back(MqttValue::fromDouble(reg(gen))); break;
+        }
+    }
+    return ret;
+}
+
+
+TEST_CASE("MqttValue::getString should match stream based formatting") {
+    for(const MqttValue& val: createSampleValues(10000)) {
+        CAPTURE(val.getDouble(), val.getDoublePrecision());
+        REQUIRE(val.getString() == streamFormat(val));
+    }
+}
+
+TEST_CASE("MqttValue::toChars should") {
+    SECTION("return nullptr if buffer is too small") {
+        MqttValue val(MqttValue::fromDouble(1.5, 3));
+        char buf[4];
+        REQUIRE(val.toChars(buf, buf + sizeof(buf)) == nullptr);
+    }
+
+    SECTION("return nullptr for binary value") {
+        MqttValue val(MqttValue::fromString("1"));
+        char buf[MqttValue::FORMAT_BUFFER_SIZE];
+        REQUIRE(val.toChars(buf, buf + sizeof(buf)) == nullptr);
+    }
+
+    SECTION("write value without terminating zero") {
+        MqttValue val(MqttValue::fromInt(-12));
+        char buf[MqttValue::FORMAT_BUFFER_SIZE];
+        char* end = val.toChars(buf, buf + sizeof(buf));
+        REQUIRE(std::string(buf, end) == "-12");
+    }
+}
+
+TEST_CASE("MqttValue::getString should format double that does not fit into buffer") {
+    MqttValue val(MqttValue::fromDouble(-DBL_MAX, 2));
+    REQUIRE(val.getString() == streamFormat(val));
+}
+
+TEST_CASE("MqttValue formatting benchmark", "[.][benchmark]") {
+    std::vector<MqttValue> values(createSampleValues(1000));
+
+    BENCHMARK("stream") {
+        size_t len = 0;
+        for(const MqttValue& val: values)
+            len += streamFormat(val).size();
+        return len;
+    };
+
+    BENCHMARK("getString") {
+        size_t len = 0;
+        for(const MqttValue& val: values)
+            len += val.getString().size();
+        return len;
+    };
+
+    BENCHMARK("toChars") {
+        char buf[MqttValue::FORMAT_BUFFER_SIZE];
+        size_t len = 0;
+        for(const MqttValue& val: values)
+            len += val.toChars(buf, buf + sizeof(buf)) - buf;
+        return len;
+    };
+}
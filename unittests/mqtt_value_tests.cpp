@@ -60,3 +60,53 @@ TEST_CASE("MqttValue::fromString should parse") {
         REQUIRE(8 == intval);
     }
 }
+
+static bool isInline(const MqttValue& val) {
+    const char* ptr = static_cast<const char*>(val.getBinaryPtr());
+    const char* obj = reinterpret_cast<const char*>(&val);
+    return ptr >= obj && ptr < obj + sizeof(val);
+}
+
+TEST_CASE("MqttValue binary value should be stored") {
+    SECTION("inline if it is short") {
+        MqttValue val(MqttValue::fromString("on"));
+
+        REQUIRE(isInline(val));
+        REQUIRE(val.getString() == "on");
+        REQUIRE(val.getBinarySize() == 2);
+    }
+
+    SECTION("on heap if it is longer than inline buffer") {
+        std::string text(MqttValue::INLINE_BINARY_SIZE + 1, 'x');
+        MqttValue val(MqttValue::fromString(text));
+
+        REQUIRE(!isInline(val));
+        REQUIRE(val.getString() == text);
+    }
+
+    SECTION("in copy independent from original") {
+        MqttValue val(MqttValue::fromString("on"));
+        MqttValue copy(val);
+        val.setString("off");
+
+        REQUIRE(isInline(copy));
+        REQUIRE(copy.getString() == "on");
+        REQUIRE(val.getString() == "off");
+    }
+
+    SECTION("when set from own data") {
+        std::string text(MqttValue::INLINE_BINARY_SIZE * 2, 'x');
+        MqttValue val(MqttValue::fromString(text));
+        val.setBinary(val.getBinaryPtr(), MqttValue::INLINE_BINARY_SIZE);
+
+        REQUIRE(isInline(val));
+        REQUIRE(val.getString() == std::string(MqttValue::INLINE_BINARY_SIZE, 'x'));
+    }
+
+    SECTION("with size when set by setBinary") {
+        MqttValue val;
+        val.setBinary("abc", 3);
+
+        REQUIRE(val.getString() == "abc");
+    }
+}
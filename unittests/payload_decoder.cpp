@@ -0,0 +1,183 @@
+#include "payload_decoder.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+typedef rapidjson::Writer<rapidjson::StringBuffer> JsonWriter;
+
+class Reader {
+    public:
+        Reader(const std::string& data) : mData(data) {}
+
+        uint8_t byte() {
+            if (mPos >= mData.size())
+                throw std::out_of_range("payload too short");
+            return uint8_t(mData[mPos++]);
+        }
+        uint64_t bigEndian(int bytes) {
+            uint64_t ret = 0;
+            for(int i = 0; i < bytes; i++)
+                ret = (ret << 8) | byte();
+            return ret;
+        }
+        void string(JsonWriter& writer, uint64_t len, bool isKey) {
+            if (mPos + len > mData.size())
+                throw std::out_of_range("payload too short");
+            if (isKey)
+                writer.Key(mData.c_str() + mPos, len);
+            else
+                writer.String(mData.c_str() + mPos, len);
+            mPos += len;
+        }
+        double float32() {
+            uint32_t bits = bigEndian(4);
+            float ret;
+            memcpy(&ret, &bits, sizeof(ret));
+            return ret;
+        }
+        double float64() {
+            uint64_t bits = bigEndian(8);
+            double ret;
+            memcpy(&ret, &bits, sizeof(ret));
+            return ret;
+        }
+        bool atEnd() const { return mPos == mData.size(); }
+    private:
+        const std::string& mData;
+        size_t mPos = 0;
+};
+
+
+static void
+decodeCbor(Reader& reader, JsonWriter& writer, bool isKey = false) {
+    uint8_t head = reader.byte();
+    uint8_t major = head >> 5;
+    uint8_t info = head & 0x1f;
+
+    if (major == 7) {
+        switch(info) {
+            case 22: writer.Null(); return;
+            case 26: writer.Double(reader.float32()); return;
+            case 27: writer.Double(reader.float64()); return;
+            default: throw std::invalid_argument("unsupported CBOR simple value");
+        }
+    }
+
+    uint64_t arg;
+    if (info < 24)
+        arg = info;
+    else if (info <= 27)
+        arg = reader.bigEndian(1 << (info - 24));
+    else
+        throw std::invalid_argument("unsupported CBOR length");
+
+    switch(major) {
+        case 0: writer.Uint64(arg); break;
+        case 1: writer.Int64(-1 - int64_t(arg)); break;
+        case 3: reader.string(writer, arg, isKey); break;
+        case 4:
+            writer.StartArray();
+            for(uint64_t i = 0; i < arg; i++)
+                decodeCbor(reader, writer);
+            writer.EndArray();
+            break;
+        case 5:
+            writer.StartObject();
+            for(uint64_t i = 0; i < arg; i++) {
+                decodeCbor(reader, writer, true);
+                decodeCbor(reader, writer);
+            }
+            writer.EndObject();
+            break;
+        default:
+            throw std::invalid_argument("unsupported CBOR major type");
+    }
+}
+
+
+static void
+decodeMsgPackMap(Reader& reader, JsonWriter& writer, uint64_t size);
+static void
+decodeMsgPackArray(Reader& reader, JsonWriter& writer, uint64_t size);
+
+static void
+decodeMsgPack(Reader& reader, JsonWriter& writer, bool isKey = false) {
+    uint8_t head = reader.byte();
+
+    if (head <= 0x7f) { writer.Int(head); return; }
+    if (head >= 0xe0) { writer.Int(int8_t(head)); return; }
+    if ((head & 0xf0) == 0x80) { decodeMsgPackMap(reader, writer, head & 0x0f); return; }
+    if ((head & 0xf0) == 0x90) { decodeMsgPackArray(reader, writer, head & 0x0f); return; }
+    if ((head & 0xe0) == 0xa0) { reader.string(writer, head & 0x1f, isKey); return; }
+
+    switch(head) {
+        case 0xc0: writer.Null(); break;
+        case 0xca: writer.Double(reader.float32()); break;
+        case 0xcb: writer.Double(reader.float64()); break;
+        case 0xcc: writer.Uint64(reader.bigEndian(1)); break;
+        case 0xcd: writer.Uint64(reader.bigEndian(2)); break;
+        case 0xce: writer.Uint64(reader.bigEndian(4)); break;
+        case 0xcf: writer.Uint64(reader.bigEndian(8)); break;
+        case 0xd0: writer.Int64(int8_t(reader.bigEndian(1))); break;
+        case 0xd1: writer.Int64(int16_t(reader.bigEndian(2))); break;
+        case 0xd2: writer.Int64(int32_t(reader.bigEndian(4))); break;
+        case 0xd3: writer.Int64(int64_t(reader.bigEndian(8))); break;
+        case 0xd9: reader.string(writer, reader.bigEndian(1), isKey); break;
+        case 0xda: reader.string(writer, reader.bigEndian(2), isKey); break;
+        case 0xdb: reader.string(writer, reader.bigEndian(4), isKey); break;
+        case 0xdc: decodeMsgPackArray(reader, writer, reader.bigEndian(2)); break;
+        case 0xdd: decodeMsgPackArray(reader, writer, reader.bigEndian(4)); break;
+        case 0xde: decodeMsgPackMap(reader, writer, reader.bigEndian(2)); break;
+        case 0xdf: decodeMsgPackMap(reader, writer, reader.bigEndian(4)); break;
+        default:
+            throw std::invalid_argument("unsupported MessagePack type");
+    }
+}
+
+
+static void
+decodeMsgPackMap(Reader& reader, JsonWriter& writer, uint64_t size) {
+    writer.StartObject();
+    for(uint64_t i = 0; i < size; i++) {
+        decodeMsgPack(reader, writer, true);
+        decodeMsgPack(reader, writer);
+    }
+    writer.EndObject();
+}
+
+
+static void
+decodeMsgPackArray(Reader& reader, JsonWriter& writer, uint64_t size) {
+    writer.StartArray();
+    for(uint64_t i = 0; i < size; i++)
+        decodeMsgPack(reader, writer);
+    writer.EndArray();
+}
+
+
+std::string
+cborToJson(const std::string& payload) {
+    Reader reader(payload);
+    rapidjson::StringBuffer ret;
+    JsonWriter writer(ret);
+    decodeCbor(reader, writer);
+    if (!reader.atEnd())
+        throw std::invalid_argument("trailing data after CBOR item");
+    return ret.GetString();
+}
+
+
+std::string
+msgpackToJson(const std::string& payload) {
+    Reader reader(payload);
+    rapidjson::StringBuffer ret;
+    JsonWriter writer(ret);
+    decodeMsgPack(reader, writer);
+    if (!reader.atEnd())
+        throw std::invalid_argument("trailing data after MessagePack item");
+    return ret.GetString();
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Convert binary payloads to JSON text for comparison
+ * with REQUIRE_JSON. Only types produced by modmqttd are supported.
+ */
+std::string cborToJson(const std::string& payload);
+std::string msgpackToJson(const std::string& payload);
@@ -0,0 +1,148 @@
+#include <cstdio>
+#include <fstream>
+
+#include "catch2/catch_all.hpp"
+#include "mockedserver.hpp"
+#include "defaults.hpp"
+#include "yaml_utils.hpp"
+
+#include "libmodmqttsrv/publish_buffer.hpp"
+
+static const char* BUFFER_PATH = "/tmp/mqmgateway_publish_buffer_test";
+
+static void
+appendStr(modmqttd::PublishBuffer& pBuffer, const std::string& pTopic, const std::string& pPayload) {
+    pBuffer.append(pTopic, pPayload.c_str(), pPayload.length(), true);
+}
+
+static std::string
+popPayload(modmqttd::PublishBuffer& pBuffer) {
+    modmqttd::PublishBuffer::Entry entry;
+    REQUIRE(pBuffer.front(entry));
+    pBuffer.pop();
+    return entry.mPayload;
+}
+
+TEST_CASE ("Publish buffer") {
+    std::remove(BUFFER_PATH);
+
+    SECTION("should return messages in order") {
+        modmqttd::PublishBuffer buffer(BUFFER_PATH, 4096);
+        appendStr(buffer, "topic/a", "1");
+        appendStr(buffer, "topic/b", "2");
+
+        modmqttd::PublishBuffer::Entry entry;
+        REQUIRE(buffer.front(entry));
+        REQUIRE(entry.mTopic == "topic/a");
+        REQUIRE(entry.mPayload == "1");
+        REQUIRE(entry.mRetain);
+        buffer.pop();
+        REQUIRE(popPayload(buffer) == "2");
+        REQUIRE(buffer.empty());
+    }
+
+    SECTION("should recover messages after reopen") {
+        {
+            modmqttd::PublishBuffer buffer(BUFFER_PATH, 4096);
+            appendStr(buffer, "topic", "1");
+            appendStr(buffer, "topic", "2");
+            appendStr(buffer, "topic", "3");
+            popPayload(buffer);
+        }
+        modmqttd::PublishBuffer buffer(BUFFER_PATH, 4096);
+        REQUIRE(buffer.getCount() == 2);
+        REQUIRE(popPayload(buffer) == "2");
+        REQUIRE(popPayload(buffer) == "3");
+        // replayed messages are not recovered again
+        appendStr(buffer, "topic", "4");
+        REQUIRE(popPayload(buffer) == "4");
+    }
+
+    SECTION("should drop the oldest messages when full") {
+        std::string payload(100, 'x');
+        size_t count;
+        {
+            modmqttd::PublishBuffer buffer(BUFFER_PATH, 1024);
+            for(int i = 0; i < 100; i++)
+                appendStr(buffer, "topic", payload + std::to_string(i));
+
+            count = buffer.getCount();
+            REQUIRE(count < 100);
+            REQUIRE(buffer.getDroppedCount() == uint64_t(100 - count));
+        }
+        // recovery after wrap
+        modmqttd::PublishBuffer buffer(BUFFER_PATH, 1024);
+        REQUIRE(buffer.getCount() == count);
+        for(size_t i = 100 - count; i < 100; i++)
+            REQUIRE(popPayload(buffer) == payload + std::to_string(i));
+    }
+
+    SECTION("should stop recovery on damaged record") {
+        {
+            modmqttd::PublishBuffer buffer(BUFFER_PATH, 4096);
+            appendStr(buffer, "topic", "1");
+            appendStr(buffer, "topic", "2");
+            appendStr(buffer, "topic", "3");
+        }
+        {
+            // damage payload of the second record
+            std::fstream file(BUFFER_PATH, std::ios::in | std::ios::out | std::ios::binary);
+            std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            size_t pos = content.find("topic2");
+            REQUIRE(pos != std::string::npos);
+            file.seekp(pos + 5);
+            file.put('X');
+        }
+        modmqttd::PublishBuffer buffer(BUFFER_PATH, 4096);
+        REQUIRE(buffer.getCount() == 1);
+        REQUIRE(popPayload(buffer) == "1");
+    }
+
+    std::remove(BUFFER_PATH);
+}
+
+TEST_CASE ("Publish buffer during broker outage") {
+    std::remove(BUFFER_PATH);
+
+TestConfig config(R"(
+modbus:
+  networks:
+    - name: tcptest
+      address: localhost
+      port: 501
+mqtt:
+  client_id: mqtt_test
+  refresh: 10ms
+  broker:
+    host: localhost
+  buffer:
+    path: /tmp/mqmgateway_publish_buffer_test
+  objects:
+    - topic: test_sensor
+      state:
+        register: tcptest.1.2
+)");
+
+    SECTION("should replay state changes after reconnect") {
+        MockedModMqttServerThread server(config.toString());
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 1);
+        server.start();
+
+        server.waitForMqttValue("test_sensor/state", "1");
+        server.mMqtt->setBrokerUp(false);
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server.setModbusRegisterValue("tcptest", 1, 2, modmqttd::RegisterType::HOLDING, 3);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server.requirePublishCount("test_sensor/state", 1);
+
+        server.mMqtt->setBrokerUp(true);
+        server.waitForMqttValue("test_sensor/state", "3");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server.stop();
+        // 2 and 3 from buffer and current state after reconnect
+        server.requirePublishCount("test_sensor/state", 4);
+    }
+
+    std::remove(BUFFER_PATH);
+}
@@ -1,6 +1,8 @@
 #include "catch2/catch_all.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <set>
 
 #include "libmodmqttsrv/modbus_scheduler.hpp"
 
@@ -55,3 +57,181 @@ TEST_CASE("Modbus scheduler") {
     }
 
 }
+
+TEST_CASE("Modbus scheduler with adaptive refresh") {
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+    RegisterSpec source;
+    std::shared_ptr<modmqttd::RegisterPoll> reg(new modmqttd::RegisterPoll(1, 1, modmqttd::RegisterType::BIT, 1, std::chrono::milliseconds(100), modmqttd::PublishMode::ON_CHANGE));
+    reg->setRefreshRange(std::chrono::milliseconds(100), std::chrono::milliseconds(1000));
+    source[reg->mSlaveId].push_back(reg);
+
+    std::chrono::nanoseconds duration = std::chrono::seconds(1000);
+
+    modmqttd::ModbusScheduler scheduler;
+    scheduler.setPollSpecification(source);
+
+    SECTION ("should double poll period while values are not changing") {
+        reg->adaptRefresh(false);
+        reg->adaptRefresh(false);
+        reg->mLastRead = now;
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now);
+
+        CHECK(duration == std::chrono::milliseconds(400));
+        REQUIRE(poll.size() == 0);
+    }
+
+    SECTION ("should not exceed max poll period") {
+        for (int i = 0; i < 10; i++)
+            reg->adaptRefresh(false);
+        reg->mLastRead = now - std::chrono::milliseconds(900);
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now);
+
+        CHECK(duration == std::chrono::milliseconds(100));
+        REQUIRE(poll.size() == 0);
+    }
+
+    SECTION ("should return to min poll period after value change") {
+        for (int i = 0; i < 10; i++)
+            reg->adaptRefresh(false);
+        reg->adaptRefresh(true);
+        reg->mLastRead = now - std::chrono::milliseconds(100);
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now);
+
+        REQUIRE(poll.size() == 1);
+    }
+}
+
+TEST_CASE("Modbus scheduler with slave affinity tolerance") {
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+    RegisterSpec source;
+    std::shared_ptr<modmqttd::RegisterPoll> due(new modmqttd::RegisterPoll(1, 1, modmqttd::RegisterType::HOLDING, 1, std::chrono::milliseconds(1000), modmqttd::PublishMode::ON_CHANGE));
+    std::shared_ptr<modmqttd::RegisterPoll> nearlyDue(new modmqttd::RegisterPoll(1, 10, modmqttd::RegisterType::HOLDING, 1, std::chrono::milliseconds(1000), modmqttd::PublishMode::ON_CHANGE));
+    std::shared_ptr<modmqttd::RegisterPoll> otherSlave(new modmqttd::RegisterPoll(2, 1, modmqttd::RegisterType::HOLDING, 1, std::chrono::milliseconds(1000), modmqttd::PublishMode::ON_CHANGE));
+    nearlyDue->setDelayBeforeFirstCommand(std::chrono::milliseconds(20));
+    source[due->mSlaveId].push_back(due);
+    source[nearlyDue->mSlaveId].push_back(nearlyDue);
+    source[otherSlave->mSlaveId].push_back(otherSlave);
+
+    due->mLastRead = now - std::chrono::milliseconds(1000);
+    nearlyDue->mLastRead = now - std::chrono::milliseconds(950);
+    otherSlave->mLastRead = now - std::chrono::milliseconds(950);
+
+    std::chrono::nanoseconds duration = std::chrono::seconds(1000);
+
+    modmqttd::ModbusScheduler scheduler;
+    scheduler.setPollSpecification(source);
+
+    SECTION ("should not pull registers forward by default") {
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now);
+
+        REQUIRE(poll.size() == 1);
+        REQUIRE(poll[1].size() == 1);
+        CHECK(duration == std::chrono::milliseconds(50));
+        CHECK(scheduler.getLastSilenceSaved() == std::chrono::steady_clock::duration::zero());
+    }
+
+    SECTION ("should poll nearly due registers of the same slave") {
+        scheduler.setSlaveAffinityTolerance(std::chrono::milliseconds(100));
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now);
+
+        REQUIRE(poll.size() == 1);
+        REQUIRE(poll[1].size() == 2);
+        // other slave is not due so it is not polled
+        CHECK(duration == std::chrono::milliseconds(50));
+        CHECK(scheduler.getLastSilenceSaved() == std::chrono::milliseconds(20));
+    }
+
+    SECTION ("should count saved silence once for every slave") {
+        std::shared_ptr<modmqttd::RegisterPoll> nearlyDue2(new modmqttd::RegisterPoll(1, 11, modmqttd::RegisterType::HOLDING, 1, std::chrono::milliseconds(1000), modmqttd::PublishMode::ON_CHANGE));
+        nearlyDue2->setDelayBeforeFirstCommand(std::chrono::milliseconds(20));
+        nearlyDue2->mLastRead = now - std::chrono::milliseconds(950);
+        source[nearlyDue2->mSlaveId].push_back(nearlyDue2);
+        scheduler.setPollSpecification(source);
+
+        scheduler.setSlaveAffinityTolerance(std::chrono::milliseconds(100));
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now);
+
+        REQUIRE(poll[1].size() == 3);
+        CHECK(scheduler.getLastSilenceSaved() == std::chrono::milliseconds(20));
+    }
+
+    SECTION ("should not pull registers outside tolerance") {
+        scheduler.setSlaveAffinityTolerance(std::chrono::milliseconds(10));
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now);
+
+        REQUIRE(poll[1].size() == 1);
+        CHECK(duration == std::chrono::milliseconds(50));
+    }
+}
+
+TEST_CASE("Modbus scheduler with phase spreading") {
+    std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+    RegisterSpec source;
+    for(int i = 1; i <= 4; i++) {
+        std::shared_ptr<modmqttd::RegisterPoll> reg(new modmqttd::RegisterPoll(i % 2 + 1, i, modmqttd::RegisterType::HOLDING, 1, std::chrono::milliseconds(1000), modmqttd::PublishMode::ON_CHANGE));
+        source[reg->mSlaveId].push_back(reg);
+    }
+    std::shared_ptr<modmqttd::RegisterPoll> other(new modmqttd::RegisterPoll(1, 10, modmqttd::RegisterType::HOLDING, 1, std::chrono::milliseconds(3000), modmqttd::PublishMode::ON_CHANGE));
+    source[other->mSlaveId].push_back(other);
+
+    std::chrono::nanoseconds duration = std::chrono::seconds(1000);
+
+    modmqttd::ModbusScheduler scheduler;
+    scheduler.setPollSpecification(source);
+
+    SECTION ("should spread offsets evenly for polls with the same refresh") {
+        std::set<std::chrono::steady_clock::duration> offsets;
+        for(const auto& slave: source)
+            for(const auto& reg: slave.second)
+                if (reg != other)
+                    offsets.insert(reg->getPhaseOffset());
+
+        REQUIRE(offsets.size() == 4);
+        CHECK(*offsets.begin() == std::chrono::milliseconds(250));
+        CHECK(*offsets.rbegin() == std::chrono::milliseconds(1000));
+        CHECK(other->getPhaseOffset() == std::chrono::milliseconds(3000));
+    }
+
+    SECTION ("should not change poll times when disabled") {
+        for(const auto& slave: source)
+            for(const auto& reg: slave.second)
+                reg->mLastRead = now;
+        scheduler.applyPhaseOffsets(now);
+
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now + std::chrono::milliseconds(1000));
+        REQUIRE(poll[1].size() + poll[2].size() == 4);
+    }
+
+    SECTION ("should poll one register from a group at a time") {
+        scheduler.setPhaseSpreading(true);
+        scheduler.applyPhaseOffsets(now);
+
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now + std::chrono::milliseconds(249));
+        REQUIRE(poll.empty());
+
+        poll = scheduler.getRegistersToPoll(duration, now + std::chrono::milliseconds(250));
+        REQUIRE(poll.size() == 1);
+        REQUIRE(poll.begin()->second.size() == 1);
+        CHECK(duration == std::chrono::milliseconds(250));
+    }
+
+    SECTION ("should not delay any poll past one refresh period after start") {
+        scheduler.setPhaseSpreading(true);
+        scheduler.applyPhaseOffsets(now);
+
+        RegisterSpec poll = scheduler.getRegistersToPoll(duration, now + std::chrono::milliseconds(1000));
+        REQUIRE(poll[1].size() + poll[2].size() == 4);
+        REQUIRE(std::find(poll[1].begin(), poll[1].end(), other) == poll[1].end());
+    }
+
+    SECTION ("should keep offsets after specification is set again") {
+        std::chrono::steady_clock::duration offset = other->getPhaseOffset();
+        std::chrono::steady_clock::duration last = source.rbegin()->second.front()->getPhaseOffset();
+        scheduler.setPollSpecification(source);
+        CHECK(other->getPhaseOffset() == offset);
+        CHECK(source.rbegin()->second.front()->getPhaseOffset() == last);
+    }
+}